@@ -0,0 +1,156 @@
+/**
+ * Solver Grid Layout Benchmark
+ *
+ * Compara o Dijkstra com as grades linha a linha e em blocos, com e sem
+ * páginas enormes, em imagens sintéticas largas (16384 x 4096 por
+ * padrão): ruído com uma linha escura serpenteando da esquerda para a
+ * direita. A medida é de pixels assentados por segundo; os caminhos dos
+ * layouts são conferidos entre si.
+ *
+ * Uso: pather_bench [largura [altura [repeticoes]]]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/* Project Headers */
+#include <pather/dijkstra.h>
+#include <pather/alloc.h>
+
+/**
+ * Benchmark Configuration
+ */
+typedef struct
+{
+  const char *nome;
+  PatherLayout layout;
+  int huge_pages;
+} Variante;
+
+static const Variante VARIANTES[] = {
+  { "rows", PATHER_LAYOUT_ROWS, 0 },
+  { "tiles", PATHER_LAYOUT_TILES, 0 },
+  { "rows+thp", PATHER_LAYOUT_ROWS, 1 },
+  { "tiles+thp", PATHER_LAYOUT_TILES, 1 },
+};
+
+#define N_VARIANTES (sizeof(VARIANTES) / sizeof(VARIANTES[0]))
+
+static double agora(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * Synthetic Cost Map
+ *
+ * Ruído claro (64 a 255) com uma linha de custo 0 e 3 pixels de
+ * espessura, que sobe e desce ao longo da imagem inteira.
+ */
+static Imagem1C *imagem_sintetica(unsigned long largura, unsigned long altura)
+{
+  Imagem1C *img = criaImagem1C((int)largura, (int)altura);
+  uint32_t semente = 12345;
+
+  if (!img)
+    return NULL;
+
+  for (unsigned long y = 0; y < altura; y++)
+    for (unsigned long x = 0; x < largura; x++)
+    {
+      semente = semente * 1103515245u + 12345u;
+      img->dados[y][x] = (unsigned char)(64 + (semente >> 16) % 192);
+    }
+
+  for (unsigned long x = 0; x < largura; x++)
+  {
+    double fase = 6.283185307179586 * (double)x / (double)largura;
+    long centro = (long)((altura - 1) * (0.5 + 0.4 * sin(3.0 * fase) * cos(fase)));
+    for (long y = centro - 1; y <= centro + 1; y++)
+      if (y >= 0 && (unsigned long)y < altura)
+        img->dados[y][x] = 0;
+  }
+
+  return img;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long largura = argc > 1 ? strtoul(argv[1], NULL, 10) : 16384;
+  unsigned long altura = argc > 2 ? strtoul(argv[2], NULL, 10) : 4096;
+  int repeticoes = argc > 3 ? atoi(argv[3]) : 3;
+  Coordenada *referencia = NULL;
+  int n_referencia = 0;
+  Imagem1C *img;
+
+  if (largura == 0 || altura == 0 || repeticoes <= 0)
+  {
+    fprintf(stderr, "Uso: %s [largura [altura [repeticoes]]]\n", argv[0]);
+    return 2;
+  }
+
+  img = imagem_sintetica(largura, altura);
+  if (!img)
+  {
+    fprintf(stderr, "Sem memoria para uma imagem %lux%lu\n", largura, altura);
+    return 1;
+  }
+
+  printf("%lux%lu, %d repeticoes\n", largura, altura, repeticoes);
+  printf("%-10s %12s %10s %14s\n", "layout", "assentados", "ms/busca", "assentados/s");
+
+  for (size_t v = 0; v < N_VARIANTES; v++)
+  {
+    TrabalhoDijkstra *t = dijkstra_workspace_grid((uint32_t)largura, (uint32_t)altura, 0,
+                                                  VARIANTES[v].layout, VARIANTES[v].huge_pages);
+    double melhor = 0.0;
+    uint64_t assentados = 0;
+    int n = -1;
+
+    if (!t)
+    {
+      printf("%-10s sem memoria\n", VARIANTES[v].nome);
+      continue;
+    }
+
+    /* O melhor tempo entre as repetições, como de costume */
+    for (int r = 0; r < repeticoes; r++)
+    {
+      Coordenada *caminho;
+      double inicio = agora(), tempo;
+
+      n = dijkstra_path_ws(t, img, NULL, &caminho, NULL);
+      tempo = agora() - inicio;
+      if (r == 0 || tempo < melhor)
+        melhor = tempo;
+      assentados = t->assentados;
+
+      if (!referencia)
+      {
+        referencia = caminho;
+        n_referencia = n;
+        caminho = NULL;
+      }
+      else if (n != n_referencia || memcmp(caminho, referencia, (size_t)n * sizeof(Coordenada)) != 0)
+        printf("%-10s caminho diferente do layout por linhas\n", VARIANTES[v].nome);
+      free(caminho);
+    }
+
+    printf("%-10s %12llu %10.1f %14.0f\n", VARIANTES[v].nome, (unsigned long long)assentados,
+           melhor * 1e3, (double)assentados / melhor);
+    dijkstra_workspace_destroy(t);
+  }
+
+  free(referencia);
+  destroiImagem1C(img);
+  return 0;
+}
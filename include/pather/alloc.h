@@ -0,0 +1,33 @@
+/**
+ * Tracking Allocator
+ *
+ * Todas as alocações de imagens e de memória de trabalho passam por
+ * aqui. Contamos os bytes em uso e o pico de cada job e, se houver um
+ * orçamento configurado, recusamos (retornando NULL) qualquer alocação
+ * que o ultrapasse. Cabe ao chamador cair para um modo com menos
+ * memória ou falhar de forma limpa.
+ *
+ * Os contadores são atualizados atomicamente, então as funções podem
+ * ser chamadas de várias threads.
+ */
+
+/* Guards */
+#ifndef _PATHER_ALLOC_H
+#define _PATHER_ALLOC_H
+
+/* Standard Libraries */
+#include <stddef.h>
+
+void *pather_malloc(size_t tamanho);
+void *pather_malloc_huge(size_t tamanho);
+void *pather_realloc(void *ptr, size_t tamanho);
+void pather_free(void *ptr);
+
+void mem_job_begin(size_t orcamento);
+size_t mem_budget_from_env(void);
+size_t mem_parse_size(const char *valor);
+size_t mem_current(void);
+size_t mem_peak(void);
+int mem_fits(size_t tamanho);
+
+#endif
@@ -0,0 +1,46 @@
+/**
+ * Path Scoring
+ *
+ * Transformada de distância (DT) usada para dar um score a um caminho
+ * sem conhecer a solução. Calcular a DT é caro, então ela é gravada uma
+ * vez em `<imagem>.dt`, ao lado da imagem, e reaproveitada via mmap nas
+ * execuções seguintes. O arquivo só é aceito se as dimensões e o hash
+ * dos pixels da imagem conferirem.
+ *
+ * `testaCaminhos` avalia vários caminhos da mesma imagem de uma vez,
+ * distribuindo-os entre threads.
+ */
+
+/* Guards */
+#ifndef _PATHER_AVALIACAO_H
+#define _PATHER_AVALIACAO_H
+
+/* Standard Libraries */
+#include <stddef.h>
+
+/* Project Headers */
+#include <pather/imagem.h>
+#include <pather/pather.h>
+
+/**
+ * Distance Transform
+ *
+ * Quando `mapa` não é NULL, as linhas de `img` apontam para o arquivo
+ * mapeado e são somente leitura.
+ */
+typedef struct
+{
+  Imagem1C *img;
+  void *mapa;
+  size_t tamanho;
+} MatrizDT;
+
+void criaMatrizDT (Imagem1C* img);
+void preencheMatrizDT (Imagem1C* img, int row, int col);
+long testaCaminho (Coordenada* caminho, int n, Imagem1C* dt);
+void testaCaminhos(Coordenada **caminhos, const int *n, int n_caminhos, Imagem1C *dt, long *scores, int n_threads);
+
+MatrizDT *abreMatrizDT(char *arquivo);
+void liberaMatrizDT(MatrizDT *dt);
+
+#endif
@@ -0,0 +1,41 @@
+/**
+ * Packed Binary Image
+ *
+ * Imagem de 1 bit por pixel, em palavras de 64 bits (o pixel x de uma
+ * linha é o bit x % 64 da palavra x / 64). Ocupa 8x menos memória que
+ * a imagem binarizada em um `Imagem1C` e permite fazer a morfologia de
+ * 64 pixels por vez com deslocamentos de palavras.
+ *
+ * Bit 1 é o primeiro plano: os pixels escuros (<= threshold), ou seja,
+ * as linhas. Um fechamento completa as falhas das linhas.
+ */
+
+/* Guards */
+#ifndef _PATHER_BINARIA_H
+#define _PATHER_BINARIA_H
+
+/* Standard Libraries */
+#include <stdint.h>
+
+/* Project Headers */
+#include <pather/imagem.h>
+
+typedef struct
+{
+  unsigned long largura;
+  unsigned long altura;
+  unsigned long palavras; /* Palavras de 64 bits por linha */
+  uint64_t *dados;        /* `altura` linhas de `palavras` palavras */
+} ImagemBinaria;
+
+ImagemBinaria *bin_create(unsigned long largura, unsigned long altura);
+void bin_destroy(ImagemBinaria *bin);
+ImagemBinaria *bin_from_gray(Imagem1C *img, uint8_t threshold);
+void bin_to_gray(ImagemBinaria *bin, Imagem1C *dest);
+
+int bin_dilate(ImagemBinaria *src, ImagemBinaria *dst, int raio_x, int raio_y);
+int bin_erode(ImagemBinaria *src, ImagemBinaria *dst, int raio_x, int raio_y);
+int bin_open(ImagemBinaria *src, ImagemBinaria *dst, int raio_x, int raio_y);
+int bin_close(ImagemBinaria *src, ImagemBinaria *dst, int raio_x, int raio_y);
+
+#endif
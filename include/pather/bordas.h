@@ -0,0 +1,30 @@
+/**
+ * Canny Edges
+ *
+ * Alternativa ao threshold para montar o mapa de custo: em vez de
+ * faixas grossas de pixels escuros, só as bordas de um pixel de largura
+ * ficam baratas, e o solver explora bem menos pixels.
+ *
+ * - Gradiente: Sobel X e Y (os kernels de `mascaras.h`), magnitude
+ *   |gx| + |gy| e direção quantizada em 4 setores.
+ * - Supressão de não-máximos: um pixel só sobrevive se é maior que o
+ *   vizinho de um lado e não menor que o do outro, na direção do
+ *   gradiente. Vetorizada com SSE2, 8 pixels por vez.
+ * - Histerese: os pixels fortes (>= alto) entram numa pilha explícita,
+ *   e cada um liga os fracos (>= baixo) vizinhos-8, sem recursão.
+ */
+
+/* Guards */
+#ifndef _PATHER_BORDAS_H
+#define _PATHER_BORDAS_H
+
+/* Project Headers */
+#include <pather/imagem.h>
+#include <pather/binaria.h>
+
+/* Maior magnitude possível (|gx| e |gy| até 4 * 255 cada) */
+#define CANNY_MAGNITUDE_MAX 2040
+
+ImagemBinaria *canny_edges(Imagem1C *img, int baixo, int alto, int n_threads);
+
+#endif
@@ -0,0 +1,28 @@
+/**
+ * Result Cache
+ *
+ * Cache em disco dos resultados do `encontraCaminho`, indexado pelo
+ * hash dos pixels da imagem e das opções do pipeline. Cada entrada é
+ * um arquivo no diretório do cache; o mtime marca o último uso e as
+ * entradas menos usadas são removidas quando o tamanho passa do limite.
+ *
+ * Vários processos podem usar o mesmo diretório: as entradas são
+ * publicadas com rename atômico e a remoção é serializada por flock.
+ */
+
+/* Guards */
+#ifndef _PATHER_CACHE_H
+#define _PATHER_CACHE_H
+
+/* Standard Libraries */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Project Headers */
+#include <pather/pather.h>
+
+uint64_t cache_key(Imagem1C *img, const PatherConfig *config);
+int cache_lookup(const char *dir, uint64_t chave, Coordenada **caminho, long *custo);
+int cache_store(const char *dir, size_t max_bytes, uint64_t chave, Coordenada *caminho, int n, long custo);
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * Delta Path Codec
+ *
+ * Os caminhos do solver são 4-conexos: cada coordenada difere da
+ * anterior por exatamente um passo (direita, baixo, esquerda, cima).
+ * Em vez de dois int32 por coordenada, guardamos o ponto de partida e
+ * 2 bits por passo, 4 passos por byte, o que dá mais de 20x menos
+ * bytes que o vetor de `Coordenada`.
+ *
+ * Formato (little endian, independente da máquina):
+ *
+ *   0   uint32  magico "PTHD"
+ *   4   uint32  flags (CODEC_CHECKSUM)
+ *   8   uint32  n, o número de coordenadas
+ *   12  int32   x0, y0
+ *   20  int64   custo
+ *   28  (n - 1 + 3) / 4 bytes de passos, o primeiro nos bits baixos
+ *   ..  uint32  checksum de tudo o que vem antes, com CODEC_CHECKSUM
+ *
+ * O decodificador monta o vetor de `Coordenada` de volta, pronto para
+ * o `testaCaminho`, com uma tabela que dá as 4 coordenadas de cada
+ * byte de passos de uma vez.
+ */
+
+/* Guards */
+#ifndef _PATHER_CODEC_H
+#define _PATHER_CODEC_H
+
+/* Standard Libraries */
+#include <stddef.h>
+
+/* Project Headers */
+#include <pather/pather.h>
+
+/* Acrescenta um checksum de 32 bits, conferido na decodificação */
+#define CODEC_CHECKSUM 1
+
+size_t path_encoded_size(int n, int flags);
+size_t path_encode(const Coordenada *caminho, int n, long custo, int flags, unsigned char *destino);
+int path_decode(const unsigned char *dados, size_t tamanho, Coordenada **caminho, long *custo);
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * Connected Components
+ *
+ * Rotulagem dos componentes conexos (vizinhança-4, a mesma do solver)
+ * do primeiro plano de uma imagem binária, com a caixa envolvente e o
+ * número de pixels de cada componente. Serve para descartar manchas de
+ * ruído e para restringir o solver aos componentes que atravessam a
+ * imagem da coluna da esquerda até a da direita.
+ */
+
+/* Guards */
+#ifndef _PATHER_COMPONENTES_H
+#define _PATHER_COMPONENTES_H
+
+/* Standard Libraries */
+#include <stdint.h>
+
+/* Project Headers */
+#include <pather/binaria.h>
+
+typedef struct
+{
+  unsigned long x0, y0;   /* Canto superior esquerdo da caixa */
+  unsigned long x1, y1;   /* Canto inferior direito (inclusive) */
+  unsigned long pixels;
+} Componente;
+
+/**
+ * Labeling
+ *
+ * `rotulos` tem um rótulo por pixel: 0 é fundo e o componente k (de 1
+ * a n) é descrito por `componentes[k - 1]`.
+ */
+typedef struct
+{
+  unsigned long largura;
+  unsigned long altura;
+  uint32_t *rotulos;
+  Componente *componentes;
+  uint32_t n;
+} Rotulagem;
+
+Rotulagem *ccl_label(ImagemBinaria *bin, int n_threads);
+void ccl_destroy(Rotulagem *rot);
+void ccl_remove_small(Rotulagem *rot, ImagemBinaria *bin, unsigned long min_pixels);
+ImagemBinaria *ccl_spanning_mask(Rotulagem *rot);
+
+#endif
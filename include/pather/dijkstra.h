@@ -0,0 +1,85 @@
+/**
+ * Shortest Path Solver
+ *
+ * Busca de menor custo (Dijkstra) sobre a grade de pixels da imagem,
+ * com vizinhança-4. O caminho parte de qualquer pixel da coluna da
+ * esquerda e termina no primeiro pixel da coluna da direita alcançado,
+ * ou entre conjuntos de origens e destinos dados pelo chamador.
+ */
+
+/* Guards */
+#ifndef _PATHER_DIJKSTRA_H
+#define _PATHER_DIJKSTRA_H
+
+/* Project Headers */
+#include <pather/imagem.h>
+#include <pather/pather.h>
+#include <pather/binaria.h>
+#include <pather/heap.h>
+
+/* Direção de onde veio o predecessor de cada pixel */
+#define PRED_NENHUM   0
+#define PRED_ESQUERDA 1
+#define PRED_DIREITA  2
+#define PRED_ACIMA    3
+#define PRED_ABAIXO   4
+
+/* Lado dos blocos do PATHER_LAYOUT_TILES (16 x 16 pixels) */
+#define BLOCO_LOG2 4
+#define LADO_BLOCO (1u << BLOCO_LOG2)
+
+/**
+ * Solver Workspace
+ *
+ * Memória de trabalho do solver, reaproveitável entre buscas em imagens
+ * do mesmo tamanho (como os frames de uma sequência).
+ *
+ * No layout em blocos, `dist`, `pred`, `epoca` e uma cópia do mapa de
+ * custo guardam cada bloco de LADO_BLOCO x LADO_BLOCO pixels contíguo,
+ * com a grade arredondada para blocos inteiros: o vizinho de cima ou de
+ * baixo costuma estar na mesma página, e não uma linha inteira adiante.
+ * A heap, os destinos e o caminho continuam usando o índice y * largura
+ * + x, então o layout não muda o resultado nem a ordem dos empates.
+ *
+ * A cópia em blocos do mapa de custo é feita na primeira busca e
+ * reaproveitada enquanto a imagem for a mesma. Quem muda os pixels da
+ * imagem no lugar entre duas buscas precisa chamar o
+ * `dijkstra_workspace_invalidate` antes da segunda.
+ */
+typedef struct
+{
+  uint32_t n_pixels;     /* Entradas alocadas em cada grade */
+  uint32_t largura;      /* Tamanho da grade; 0 quando só se sabe n_pixels */
+  uint32_t altura;
+  uint32_t blocos;       /* Blocos por linha; 0 no layout linha a linha */
+  uint32_t *dist;
+  uint8_t *pred;
+  uint32_t *epoca;       /* NULL: dist e pred são reiniciados a cada busca */
+  uint32_t epoca_atual;
+  int huge_pages;        /* As grades pedem páginas enormes */
+  const uint8_t *custo;  /* Mapa de custo em blocos das buscas, ou NULL */
+  uint8_t *custo_proprio;/* Cópia em blocos feita pelo espaço de trabalho */
+  const Imagem1C *custo_origem; /* Imagem copiada em `custo_proprio`; NULL a recopia */
+  uint64_t assentados;   /* Pixels assentados pela última busca */
+  Heap heap;
+} TrabalhoDijkstra;
+
+int dijkstra_path(Imagem1C *custo, Coordenada **caminho, long *total);
+int dijkstra_path_mask(Imagem1C *custo, ImagemBinaria *mascara, Coordenada **caminho, long *total);
+int dijkstra_path_config(Imagem1C *custo, ImagemBinaria *mascara, const PatherConfig *config,
+                         Coordenada **caminho, long *total);
+
+TrabalhoDijkstra *dijkstra_workspace(uint32_t n_pixels, int reutilizavel);
+TrabalhoDijkstra *dijkstra_workspace_grid(uint32_t largura, uint32_t altura, int reutilizavel,
+                                          PatherLayout layout, int huge_pages);
+void dijkstra_workspace_destroy(TrabalhoDijkstra *trabalho);
+void dijkstra_workspace_invalidate(TrabalhoDijkstra *trabalho);
+int dijkstra_path_ws(TrabalhoDijkstra *trabalho, Imagem1C *custo, ImagemBinaria *mascara,
+                     Coordenada **caminho, long *total);
+int dijkstra_query_ws(TrabalhoDijkstra *trabalho, Imagem1C *custo, ImagemBinaria *mascara,
+                      const Coordenada *origens, int n_origens, const Coordenada *destinos, int n_destinos,
+                      Coordenada **caminho, long *total);
+int dijkstra_queries(Imagem1C *custo, ImagemBinaria *mascara, ConsultaCaminho *consultas, int n_consultas,
+                     const PatherConfig *config);
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * Skeleton Graph
+ *
+ * Afinamento (Zhang–Suen) da imagem binária até linhas de um pixel de
+ * largura e extração do esqueleto como um grafo: os nós são as pontas,
+ * as junções e os pixels do esqueleto nas colunas da borda; os ramos
+ * são as cadeias de pixels entre dois nós, com o custo dos pixels como
+ * peso. Em imagens de traço fino, o grafo tem ordens de grandeza menos
+ * nós que a grade de pixels, e a busca nele é quase instantânea.
+ *
+ * O caminho encontrado no grafo é expandido de volta em coordenadas
+ * vizinhas-4: cada passo diagonal do esqueleto ganha o canto mais
+ * barato entre os dois possíveis.
+ */
+
+/* Guards */
+#ifndef _PATHER_ESQUELETO_H
+#define _PATHER_ESQUELETO_H
+
+/* Standard Libraries */
+#include <stdint.h>
+
+/* Project Headers */
+#include <pather/imagem.h>
+#include <pather/pather.h>
+#include <pather/binaria.h>
+
+typedef struct
+{
+  uint32_t destino;  /* Nó de chegada */
+  uint32_t peso;     /* Custo dos pixels depois da origem, com o nó de chegada */
+  uint32_t passos;   /* Coordenadas do ramo expandido, sem a origem */
+  uint8_t direcao;   /* Vizinho-8 da origem onde o ramo começa */
+} RamoEsqueleto;
+
+typedef struct
+{
+  unsigned long largura;
+  unsigned long altura;
+  uint32_t n_nos;
+  uint32_t n_ramos;
+  uint32_t *pixels;      /* Índice (y * largura + x) de cada nó, em ordem crescente */
+  uint32_t *primeiro;    /* Ramos do nó i: primeiro[i] até primeiro[i + 1] - 1 */
+  RamoEsqueleto *ramos;
+} GrafoEsqueleto;
+
+int bin_thin(ImagemBinaria *bin, int n_threads);
+
+GrafoEsqueleto *skeleton_graph(ImagemBinaria *esqueleto, Imagem1C *custo);
+void skeleton_graph_destroy(GrafoEsqueleto *grafo);
+int skeleton_path(GrafoEsqueleto *grafo, ImagemBinaria *esqueleto, Imagem1C *custo,
+                  Coordenada **caminho, long *total);
+
+#endif
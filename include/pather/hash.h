@@ -0,0 +1,22 @@
+/**
+ * Fast Content Hash
+ *
+ * Hash de 64 bits não criptográfico, usado para identificar imagens
+ * repetidas (cache de resultados, cache da DT).
+ */
+
+/* Guards */
+#ifndef _PATHER_HASH_H
+#define _PATHER_HASH_H
+
+/* Standard Libraries */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Project Headers */
+#include <pather/imagem.h>
+
+uint64_t hash_bytes(const void *dados, size_t n, uint64_t semente);
+uint64_t hash_imagem1C(Imagem1C *img);
+
+#endif
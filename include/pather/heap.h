@@ -0,0 +1,28 @@
+/**
+ * Binary Heap
+ *
+ * Fila de prioridade mínima usada pelas buscas de menor caminho. Cada
+ * entrada empacota a distância nos 32 bits altos e o índice do nó nos
+ * 32 bits baixos, então comparar entradas é comparar inteiros.
+ * Entradas obsoletas não são removidas: são descartadas ao sair.
+ */
+
+/* Guards */
+#ifndef _PATHER_HEAP_H
+#define _PATHER_HEAP_H
+
+/* Standard Libraries */
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+  uint64_t *itens;
+  size_t tamanho;
+  size_t capacidade;
+} Heap;
+
+int heap_push(Heap *heap, uint32_t dist, uint32_t no);
+uint64_t heap_pop(Heap *heap);
+
+#endif
@@ -13,6 +13,8 @@
 #ifndef __IMAGEM_H
 #define __IMAGEM_H
 
+#include <stdio.h>
+
 /*============================================================================*/
 /* Imagem em escala de cinza (1 canal). */
 
@@ -24,13 +26,29 @@ typedef struct
 } Imagem1C;
 
 /*----------------------------------------------------------------------------*/
-/* Por simplicidade e compatibilidade, as funes para ler e escrever imagens
- * de 1 canal na verdade convertem a imagem para 3 canais. Isto quer dizer que
- * s podemos ler imagens com 24bpp. */
+/* As funes para ler imagens aceitam arquivos de 8bpp (com paleta), 24bpp e
+ * 32bpp (BGRA), convertendo cada linha para cinza j na leitura. As imagens de
+ * 1 canal so salvas em 8bpp, com uma paleta de tons de cinza.
+ * As verses "Regiao" leem do arquivo s o retngulo dado (recortado aos
+ * limites da imagem), sem passar pelas outras linhas e colunas.
+ * A verso "Reduzida" diminui a imagem por um fator j na leitura, linha a
+ * linha, sem nunca montar a imagem em resoluo cheia: cada bloco de
+ * fator x fator pixels vira a sua mdia (REDUCAO_MEDIA) ou o seu pixel mais
+ * escuro (REDUCAO_MINIMO, que preserva as linhas finas e escuras).
+ * As verses "le" leem de um fluxo j aberto (a entrada padro ou um pipe, por
+ * exemplo), sem nunca voltar nele: leImagem1C l um BMP, e leImagem1CBruta l
+ * largura x altura bytes de cinza, de cima para baixo e sem padding. */
+
+#define REDUCAO_MEDIA  0
+#define REDUCAO_MINIMO 1
 
 Imagem1C* criaImagem1C (int largura, int altura);
 void destroiImagem1C (Imagem1C* img);
 Imagem1C* abreImagem1C (char* arquivo);
+Imagem1C* abreImagem1CRegiao (char* arquivo, unsigned long x0, unsigned long y0, unsigned long largura, unsigned long altura);
+Imagem1C* abreImagem1CReduzida (char* arquivo, int fator, int modo);
+Imagem1C* leImagem1C (FILE* stream);
+Imagem1C* leImagem1CBruta (FILE* stream, unsigned long largura, unsigned long altura);
 int salvaImagem1C (Imagem1C* img, char* arquivo);
 
 /*============================================================================*/
@@ -48,6 +66,7 @@ typedef struct
 Imagem3C* criaImagem3C (int largura, int altura);
 void destroiImagem3C (Imagem3C* img);
 Imagem3C* abreImagem3C (char* arquivo);
+Imagem3C* abreImagem3CRegiao (char* arquivo, unsigned long x0, unsigned long y0, unsigned long largura, unsigned long altura);
 int salvaImagem3C (Imagem3C* img, char* arquivo);
 
 /*============================================================================*/
@@ -0,0 +1,47 @@
+/**
+ * Adaptive Thresholding
+ *
+ * Binarização com threshold local, para imagens com iluminação
+ * irregular em que um threshold global (Otsu) falha. As médias e
+ * variâncias de cada janela saem de tabelas de somas acumuladas
+ * (imagens integrais), então o custo por pixel é constante para
+ * qualquer tamanho de janela.
+ *
+ * - Bradley: escuro se o pixel está `t` abaixo da média da janela.
+ * - Sauvola: escuro se está abaixo de m * (1 + k * (s / 128 - 1)).
+ */
+
+/* Guards */
+#ifndef _PATHER_LIMIAR_H
+#define _PATHER_LIMIAR_H
+
+/* Standard Libraries */
+#include <stdint.h>
+
+/* Project Headers */
+#include <pather/imagem.h>
+#include <pather/binaria.h>
+
+/**
+ * Summed-area Tables
+ *
+ * (largura + 1) x (altura + 1), com a linha e a coluna 0 zeradas. As
+ * somas são de 32 bits em aritmética modular: a soma de uma janela sai
+ * certa enquanto couber em 32 bits (janelas de até 16M pixels). Os
+ * quadrados, usados só pelo Sauvola, são de 64 bits.
+ */
+typedef struct
+{
+  unsigned long largura;
+  unsigned long altura;
+  uint32_t *soma;
+  uint64_t *quadrados; /* NULL se não foi pedida */
+} ImagemIntegral;
+
+ImagemIntegral *integral_create(Imagem1C *img, int quadrados, int n_threads);
+void integral_destroy(ImagemIntegral *integral);
+
+ImagemBinaria *threshold_bradley(Imagem1C *img, int janela, double t, int n_threads);
+ImagemBinaria *threshold_sauvola(Imagem1C *img, int janela, double k, int n_threads);
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * Fixed 3x3 Masks
+ *
+ * As máscaras conhecidas são listadas uma vez em `PATHER_MASCARAS`, e
+ * cada uma vira, por macro, um kernel desenrolado para uma linha (o
+ * do `filter`) e outro para um ponto (o do `convulution`). Como os
+ * coeficientes são constantes, os termos com zero somem na compilação
+ * e os ±1 viram somas e subtrações. O `convulution` compara a máscara
+ * recebida com a tabela e usa o kernel especializado quando ela é uma
+ * destas.
+ */
+
+/* Guards */
+#ifndef _PATHER_MASCARAS_H
+#define _PATHER_MASCARAS_H
+
+/* Standard Libraries */
+#include <stdint.h>
+
+/* Project Headers */
+#include <pather/pather.h>
+
+/* Nome, coeficientes por linha. |gradiente| <= 16 * 255 em todas, então
+   cabe em int16 */
+#define PATHER_MASCARAS(M)                                  \
+  M(SOBEL_X,   -1,   0,  1,  -2,  0,  2,  -1,   0,  1)      \
+  M(SOBEL_Y,   -1,  -2, -1,   0,  0,  0,   1,   2,  1)      \
+  M(SCHARR_X,  -3,   0,  3, -10,  0, 10,  -3,   0,  3)      \
+  M(SCHARR_Y,  -3, -10, -3,   0,  0,  0,   3,  10,  3)      \
+  M(PREWITT_X, -1,   0,  1,  -1,  0,  1,  -1,   0,  1)      \
+  M(PREWITT_Y, -1,  -1, -1,   0,  0,  0,   1,   1,  1)
+
+/* Gradiente dos pixels 1 .. largura - 2 da linha `r1` */
+typedef void (*LinhaMascara)(const unsigned char *r0, const unsigned char *r1, const unsigned char *r2,
+                             int16_t *g, unsigned long largura);
+
+/* Convolução na janela 3x3 `base` */
+typedef int (*PontoMascara)(unsigned char **base);
+
+LinhaMascara mask_row(PatherKernel kernel);
+PontoMascara mask_point(int mask[3][3]);
+int mask_from_name(const char *nome, PatherKernel *kernel);
+
+#endif
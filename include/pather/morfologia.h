@@ -0,0 +1,49 @@
+/**
+ * Grayscale Morphology
+ *
+ * Filtros de mínimo/máximo (erosão/dilatação) e suas composições
+ * (abertura/fechamento) em imagens de 1 canal, com o algoritmo de
+ * van Herk/Gil-Werman: o custo por pixel é constante, qualquer que
+ * seja o tamanho do elemento estruturante.
+ *
+ * Com linhas escuras sobre fundo claro, completar uma falha (um trecho
+ * claro no meio da linha) é uma abertura: o mínimo espalha a linha
+ * sobre a falha e o máximo devolve a espessura original.
+ */
+
+/* Guards */
+#ifndef _PATHER_MORFOLOGIA_H
+#define _PATHER_MORFOLOGIA_H
+
+/* Project Headers */
+#include <pather/imagem.h>
+
+/**
+ * Structuring Element
+ *
+ * Retângulo de `largura` x `altura` ou segmento de reta de `largura`
+ * pixels, centrado no pixel. Tamanhos pares são arredondados para o
+ * ímpar seguinte.
+ */
+typedef enum
+{
+  SE_RETANGULO,
+  SE_LINHA_0,   /* Horizontal */
+  SE_LINHA_45,  /* Subindo para a direita */
+  SE_LINHA_90,  /* Vertical */
+  SE_LINHA_135  /* Descendo para a direita */
+} FormaSE;
+
+typedef struct
+{
+  FormaSE forma;
+  int largura;
+  int altura;
+} ElementoEstruturante;
+
+int morph_erode(Imagem1C *src, Imagem1C *dst, const ElementoEstruturante *se);
+int morph_dilate(Imagem1C *src, Imagem1C *dst, const ElementoEstruturante *se);
+int morph_open(Imagem1C *src, Imagem1C *dst, const ElementoEstruturante *se);
+int morph_close(Imagem1C *src, Imagem1C *dst, const ElementoEstruturante *se);
+
+#endif
@@ -0,0 +1,18 @@
+/**
+ * In-place Path Overlay
+ *
+ * Gera a imagem de saída com o caminho pintado de vermelho sem decodificar
+ * a entrada: o arquivo original é copiado (reflink/copy_file_range quando
+ * possível) e só os pixels do caminho são sobrescritos na cópia.
+ */
+
+/* Guards */
+#ifndef _PATHER_OVERLAY_H
+#define _PATHER_OVERLAY_H
+
+/* Project Headers */
+#include <pather/pather.h>
+
+int salvaCaminhoSobreposto(char *origem, char *destino, Coordenada *caminho, int n);
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * Worker Threads
+ *
+ * Os estágios paralelos dividem o trabalho do mesmo jeito: o chamador
+ * monta uma tarefa por thread (uma faixa de linhas ou colunas, ou um
+ * lote compartilhado de onde as threads tiram itens), roda a primeira
+ * na thread atual e as outras em threads novas. Uma thread que não
+ * pôde ser criada não é erro: a tarefa dela roda na thread atual.
+ */
+
+/* Guards */
+#ifndef _PATHER_PARALELO_H
+#define _PATHER_PARALELO_H
+
+/* Standard Libraries */
+#include <stddef.h>
+
+/* Limite de threads de um estágio */
+#define PATHER_MAX_THREADS 64
+
+int parallel_threads(int n_threads, unsigned long total);
+void parallel_run(void *(*funcao)(void *), void *tarefas, size_t tamanho, int n);
+
+#endif
@@ -11,6 +11,7 @@
 /* Project Headers */
 #include <pather/imagem.h>
 #include <stdint.h>
+#include <stddef.h>
 
 /* Guards */
 #ifndef _PATHER_PATHER_H
@@ -28,17 +29,117 @@ typedef struct
     int y;
 } Coordenada;
 
+/* Retorno das buscas quando a memria de trabalho do solver no cabe
+   (no oramento do job ou no sistema); -1 fica para "sem caminho" */
+#define PATHER_SEM_MEMORIA (-2)
+
+/**
+ * Path Query
+ *
+ * Um par de conjuntos de origens e destinos para o `encontraCaminhos`.
+ * Sem origens, valem todos os pixels da coluna da esquerda; sem
+ * destinos, todos os da coluna da direita. `caminho`, `n` e `custo`
+ * so preenchidos pela busca (n = -1 se no h caminho, ou
+ * PATHER_SEM_MEMORIA se a busca no coube na memria).
+ */
+typedef struct
+{
+    const Coordenada *origens;
+    int n_origens;
+    const Coordenada *destinos;
+    int n_destinos;
+    Coordenada *caminho;    /* Liberar com free() */
+    int n;
+    long custo;
+} ConsultaCaminho;
+
+/**
+ * Pipeline Options
+ *
+ * Escolhas que mudam o resultado do `encontraCaminho` (e por isso
+ * fazem parte da chave do cache de resultados), mais a configurao
+ * do prprio cache.
+ */
+typedef enum
+{
+    PATHER_SOLVER_DIJKSTRA,   /* Dijkstra na grade de pixels */
+    PATHER_SOLVER_SKELETON    /* Dijkstra no grafo do esqueleto (Otsu se threshold NONE) */
+} PatherSolver;
+
+typedef enum
+{
+    PATHER_THRESHOLD_NONE,
+    PATHER_THRESHOLD_OTSU,    /* Binariza com o threshold global de Otsu */
+    PATHER_THRESHOLD_BRADLEY, /* Threshold local: mdia da janela */
+    PATHER_THRESHOLD_SAUVOLA, /* Threshold local: mdia e desvio da janela */
+    PATHER_THRESHOLD_CANNY    /* Bordas de Canny: s as bordas ficam baratas */
+} PatherThreshold;
+
+typedef enum
+{
+    PATHER_KERNEL_SOBEL_X,
+    PATHER_KERNEL_SOBEL_Y,
+    PATHER_KERNEL_SCHARR_X,
+    PATHER_KERNEL_SCHARR_Y,
+    PATHER_KERNEL_PREWITT_X,
+    PATHER_KERNEL_PREWITT_Y
+} PatherKernel;
+
+typedef enum
+{
+    PATHER_PREFILTER_NONE,
+    PATHER_PREFILTER_GAUSSIAN, /* Gaussiana recursiva (prefilter_sigma) */
+    PATHER_PREFILTER_MEDIAN    /* Mediana (prefilter_radius) */
+} PatherPrefilter;
+
+typedef enum
+{
+    PATHER_LAYOUT_ROWS,        /* Grades do solver linha a linha */
+    PATHER_LAYOUT_TILES        /* Em blocos quadrados: vizinhos verticais perto na memria */
+} PatherLayout;
+
+typedef struct
+{
+    PatherSolver solver;
+    PatherThreshold threshold;
+    PatherKernel kernel;    /* Mscara do dump de depurao; no muda o caminho */
+    PatherPrefilter prefilter;
+    double prefilter_sigma;
+    int prefilter_radius;
+    int threshold_window;   /* Janela dos thresholds locais (0 = largura / 8) */
+    double threshold_k;     /* t do Bradley ou k do Sauvola (0 = padro) */
+    int canny_low;          /* Histerese do Canny: magnitude dos fracos */
+    int canny_high;         /* e dos fortes (0 = Otsu das magnitudes) */
+    int close_radius;       /* Fechamento da imagem binria (0 desliga) */
+    int gap_length;         /* Abertura em cinza por uma linha horizontal (0 desliga) */
+    int min_component;      /* Componentes binrios menores viram fundo (0 desliga) */
+    int restrict_components;/* Solver s nos componentes que cruzam a imagem */
+    int n_threads;          /* Threads dos estgios paralelos (0 = uma por CPU) */
+    PatherLayout layout;    /* Disposio das grades do Dijkstra; no muda o caminho */
+    int huge_pages;         /* Pede pginas enormes (THP) para as grades do Dijkstra */
+
+    const char *cache_dir;  /* NULL desliga o cache de resultados */
+    const char *debug_dump; /* Arquivo do dump da imagem filtrada (NULL desliga) */
+    size_t cache_max_bytes; /* Tamanho mximo do cache em disco */
+} PatherConfig;
+
 /*============================================================================*/
 /* Funo central do trabalho. */
 
 int encontraCaminho (Imagem1C* img, Coordenada** caminho);
+int encontraCaminhoConfig (Imagem1C* img, Coordenada** caminho, long* custo, const PatherConfig* config);
+int encontraCaminhoRegiao (char* arquivo, unsigned long x0, unsigned long y0, unsigned long largura, unsigned long altura,
+                           Coordenada** caminho, long* custo, const PatherConfig* config);
+int encontraCaminhos (Imagem1C* img, ConsultaCaminho* consultas, int n_consultas, const PatherConfig* config);
+void pather_config_default(PatherConfig *config);
 void filter(Imagem1C *img, Imagem1C *dest);
+void filter_mask(Imagem1C *img, Imagem1C *dest, PatherKernel kernel);
 unsigned char ** get_neighbors(unsigned char **dados, uint32_t y, uint32_t x);
-float convulution(unsigned char **base, int mask[3][3], int degree);
-float normalize(float value, float base_min, float base_max, float destination_min, float destination_max);
+int convulution(unsigned char **base, int mask[3][3], int degree);
+int normalize(int value, int base_min, int base_max, int destination_min, int destination_max);
 void binarization(unsigned char **dados, uint32_t coordinate_y, uint32_t coordinate_x, uint8_t threshold);
-void generate_histogram(Imagem1C *img, uint8_t *histogram);
-uint8_t otsu_threshold(Imagem1C *img, uint8_t *histogram);
+void generate_histogram(Imagem1C *img, uint32_t *histogram);
+uint8_t otsu_threshold(Imagem1C *img, uint32_t *histogram);
 
 /*============================================================================*/
 
@@ -0,0 +1,46 @@
+/**
+ * Frame Sequences
+ *
+ * Rastreamento do caminho em uma sequência de frames da mesma cena,
+ * em que a linha se desloca devagar. Cada frame é resolvido só dentro
+ * de uma faixa em torno do caminho do frame anterior; se o custo salta
+ * (ou a faixa não liga as bordas), a faixa dobra de raio até virar uma
+ * busca na imagem inteira.
+ *
+ * Toda a memória de trabalho (máscara da faixa, distâncias com épocas
+ * e heap) é alocada uma vez e reaproveitada, de forma que o custo de
+ * cada frame acompanha o comprimento do caminho, não a área do frame.
+ */
+
+/* Guards */
+#ifndef _PATHER_SEQUENCIA_H
+#define _PATHER_SEQUENCIA_H
+
+/* Project Headers */
+#include <pather/imagem.h>
+#include <pather/pather.h>
+#include <pather/binaria.h>
+#include <pather/dijkstra.h>
+
+typedef struct
+{
+  unsigned long largura;
+  unsigned long altura;
+  int raio;                /* Raio inicial da faixa em torno do caminho anterior */
+  double salto;            /* Aumento relativo de custo que alarga a faixa */
+
+  Coordenada *caminho;     /* Caminho do frame anterior */
+  int n;
+  int capacidade;
+  long custo;
+
+  ImagemBinaria *faixa;
+  TrabalhoDijkstra *trabalho;
+} Sequencia;
+
+Sequencia *seq_create(unsigned long largura, unsigned long altura, int raio, double salto);
+void seq_destroy(Sequencia *seq);
+void seq_reset(Sequencia *seq);
+int seq_frame(Sequencia *seq, Imagem1C *frame, Coordenada **caminho, long *custo);
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * Incremental Path Sessions
+ *
+ * Um job que continua vivo depois da primeira solução, para retoques
+ * interativos: o chamador edita os pixels da imagem no lugar e informa
+ * o retângulo sujo. Só esse retângulo, mais a margem de influência de
+ * cada etapa, é recalculado no pré-filtro, na abertura e no threshold,
+ * e a árvore de menores caminhos é reparada só nos nós afetados (SSSP
+ * dinâmico), em vez de refazer o job inteiro.
+ *
+ * Só etapas locais entram numa sessão: mediana, abertura em cinza,
+ * thresholds (o nível de Otsu é o da imagem na criação) e fechamento.
+ * A gaussiana recursiva, a poda de componentes, a histerese do Canny e
+ * o solver do esqueleto dependem da imagem inteira, e com eles a sessão
+ * não é criada.
+ */
+
+/* Guards */
+#ifndef _PATHER_SESSAO_H
+#define _PATHER_SESSAO_H
+
+/* Standard Libraries */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Project Headers */
+#include <pather/imagem.h>
+#include <pather/pather.h>
+#include <pather/heap.h>
+
+typedef struct
+{
+  Imagem1C *img;          /* Imagem do chamador, editada no lugar */
+  PatherConfig config;
+  uint8_t nivel;          /* Threshold de Otsu fixado na criação */
+  int janela;             /* Janela dos thresholds locais, já resolvida */
+
+  Imagem1C *suavizada;    /* Saída da mediana, ou `img` */
+  Imagem1C *entrada;      /* Saída da abertura, ou `suavizada` */
+  Imagem1C *custo;        /* Mapa de custo do solver (cópia própria) */
+
+  uint32_t *dist;         /* Árvore de menores caminhos completa */
+  uint8_t *pred;
+  Heap heap;
+  uint32_t *pilha;        /* Nós afetados por um retoque */
+  size_t capacidade_pilha;
+} SessaoCaminho;
+
+SessaoCaminho *sessao_create(Imagem1C *img, const PatherConfig *config);
+void sessao_destroy(SessaoCaminho *sessao);
+long sessao_update(SessaoCaminho *sessao, unsigned long x0, unsigned long y0,
+                   unsigned long largura, unsigned long altura);
+int sessao_path(SessaoCaminho *sessao, Coordenada **caminho, long *custo);
+
+#endif
@@ -0,0 +1,31 @@
+/**
+ * Denoising Pre-filters
+ *
+ * Suavizações com custo por pixel independente do tamanho do kernel,
+ * para tirar o ruído antes do Sobel e do threshold:
+ *
+ * - Gaussiana recursiva (Young–van Vliet): um filtro IIR de 3ª ordem
+ *   para frente e para trás em cada eixo, qualquer que seja o sigma.
+ * - Mediana por histogramas deslizantes (Perreault–Hébert): um
+ *   histograma por coluna, atualizado uma vez por linha, e um
+ *   histograma do kernel atualizado uma vez por pixel.
+ *
+ * As duas dividem o trabalho entre threads por faixas de linhas (a
+ * passada vertical da gaussiana, por faixas de colunas). As bordas
+ * replicam os pixels da borda.
+ */
+
+/* Guards */
+#ifndef _PATHER_SUAVIZACAO_H
+#define _PATHER_SUAVIZACAO_H
+
+/* Project Headers */
+#include <pather/imagem.h>
+
+/* Maior raio aceito pela mediana (os histogramas são de 16 bits) */
+#define MEDIANA_RAIO_MAX 127
+
+int gaussian_iir(Imagem1C *src, Imagem1C *dst, double sigma, int n_threads);
+int median_filter(Imagem1C *src, Imagem1C *dst, int raio, int n_threads);
+
+#endif
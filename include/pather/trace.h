@@ -0,0 +1,77 @@
+/**
+ * Hot-path Instrumentation
+ *
+ * Camada de instrumentação de baixo custo para o `encontraCaminho`.
+ * Cada chamada registra, por etapa, o tempo de parede, ciclos, bytes
+ * e alocações, além dos contadores do solver. Os bytes de uma etapa do
+ * pipeline são o tamanho das imagens que ela lê e escreve (a memória
+ * de trabalho aparece nas alocações); no solver, os das grades e da
+ * heap tocados pelos nós. A saída é em JSON lines ou no formato Chrome
+ * trace (chrome://tracing).
+ *
+ * Por padrão tudo é removido na compilação: os macros `TRACE_*`
+ * só fazem algo quando `PATHER_TRACE` está definido (opção do CMake
+ * de mesmo nome). O arquivo de saída é escolhido pelas variáveis de
+ * ambiente `PATHER_TRACE_FILE` e `PATHER_TRACE_FORMAT` (json|chrome).
+ *
+ * O estado é global. Etapas (`TRACE_CALL_*`, `TRACE_STAGE_*`) só podem
+ * ser abertas e fechadas pela thread que chamou `encontraCaminho`; bytes,
+ * alocações e contadores são atômicos e podem ser registrados também
+ * pelas threads de trabalho de uma etapa, entre o início e o fim dela.
+ */
+
+/* Guards */
+#ifndef _PATHER_TRACE_H
+#define _PATHER_TRACE_H
+
+/* Standard Libraries */
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Solver Counters
+ *
+ * Contadores acumulados durante uma chamada.
+ */
+typedef enum
+{
+  TRACE_NODES_PUSHED,
+  TRACE_NODES_SETTLED,
+  TRACE_QUEUE_PEAK,
+  TRACE_N_COUNTERS
+} TraceCounter;
+
+#ifdef PATHER_TRACE
+
+void trace_call_begin(unsigned long largura, unsigned long altura);
+void trace_call_end(void);
+void trace_stage_begin(const char *nome);
+void trace_stage_end(void);
+void trace_bytes(uint64_t bytes);
+void trace_alloc(uint64_t bytes);
+void trace_add(TraceCounter counter, uint64_t value);
+void trace_max(TraceCounter counter, uint64_t value);
+
+#define TRACE_CALL_BEGIN(l, a)  trace_call_begin((l), (a))
+#define TRACE_CALL_END()        trace_call_end()
+#define TRACE_STAGE_BEGIN(nome) trace_stage_begin(nome)
+#define TRACE_STAGE_END()       trace_stage_end()
+#define TRACE_BYTES(n)          trace_bytes((uint64_t)(n))
+#define TRACE_ALLOC(n)          trace_alloc((uint64_t)(n))
+#define TRACE_ADD(c, n)         trace_add((c), (uint64_t)(n))
+#define TRACE_MAX(c, n)         trace_max((c), (uint64_t)(n))
+
+#else
+
+#define TRACE_CALL_BEGIN(l, a)  ((void)0)
+#define TRACE_CALL_END()        ((void)0)
+#define TRACE_STAGE_BEGIN(nome) ((void)0)
+#define TRACE_STAGE_END()       ((void)0)
+#define TRACE_BYTES(n)          ((void)0)
+#define TRACE_ALLOC(n)          ((void)0)
+#define TRACE_ADD(c, n)         ((void)0)
+#define TRACE_MAX(c, n)         ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,296 @@
+/**
+ * Tracking Allocator
+ *
+ * Cada bloco carrega um cabeçalho com o seu tamanho, para que o
+ * `pather_free` saiba quanto descontar sem precisar de uma tabela. O
+ * cabeçalho também diz se o bloco veio do `mmap` (páginas enormes) e
+ * quanto foi mapeado, já que esses não podem ir para o `free`.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+/* Standard Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* File Header */
+#include <pather/alloc.h>
+#include <pather/trace.h>
+
+/* Cabeçalho grande o bastante para manter o alinhamento do malloc:
+ * bytes cobrados do orçamento e bytes mapeados (0 se veio do malloc) */
+#define CABECALHO 16
+
+/* Tamanho de uma página enorme (THP) no x86-64 */
+#define PAGINA_ENORME ((size_t)2 << 20)
+
+/* Estado global do job atual */
+static size_t atual = 0;
+static size_t pico = 0;
+static size_t orcamento = 0;
+
+/**
+ * Reserve Bytes
+ *
+ * Soma `tamanho` ao uso atual se couber no orçamento, atualizando o
+ * pico. Retorna 0 se a reserva foi recusada.
+ */
+static int reserva(size_t tamanho)
+{
+  size_t novo = __sync_add_and_fetch(&atual, tamanho);
+  size_t anterior;
+
+  if (orcamento && novo > orcamento)
+  {
+    __sync_sub_and_fetch(&atual, tamanho);
+    return 0;
+  }
+
+  while ((anterior = __atomic_load_n(&pico, __ATOMIC_RELAXED)) < novo)
+    if (__sync_bool_compare_and_swap(&pico, anterior, novo))
+      break;
+
+  return 1;
+}
+
+/**
+ * Write a Block Header
+ *
+ * @param dados    início dos dados do bloco
+ * @param cobrado  bytes descontados do orçamento no `pather_free`
+ * @param mapeado  bytes a passar para o `munmap`, ou 0 para o `free`
+ */
+static void grava_cabecalho(unsigned char *dados, size_t cobrado, size_t mapeado)
+{
+  memcpy(dados - CABECALHO, &cobrado, sizeof(size_t));
+  memcpy(dados - CABECALHO + sizeof(size_t), &mapeado, sizeof(size_t));
+}
+
+/**
+ * Tracked malloc
+ *
+ * @param  tamanho número de bytes
+ * @return         bloco alocado, ou NULL se faltar memória ou orçamento
+ */
+void *pather_malloc(size_t tamanho)
+{
+  unsigned char *bloco;
+
+  if (!reserva(tamanho))
+    return NULL;
+
+  bloco = (unsigned char *)malloc(CABECALHO + tamanho);
+  if (!bloco)
+  {
+    __sync_sub_and_fetch(&atual, tamanho);
+    return NULL;
+  }
+
+  TRACE_ALLOC(tamanho);
+  grava_cabecalho(bloco + CABECALHO, tamanho, 0);
+  return bloco + CABECALHO;
+}
+
+/**
+ * Tracked malloc on Huge Pages
+ *
+ * Para as grades grandes do solver: os dados começam num endereço
+ * alinhado a 2 MB e são marcados com MADV_HUGEPAGE, de forma que o kernel
+ * possa usar páginas enormes transparentes e cada entrada da TLB cubra
+ * 2 MB em vez de 4 KB. O cabeçalho fica no fim de uma página comum logo
+ * antes dos dados, e o orçamento é cobrado por tudo o que fica mapeado
+ * (essa página mais os dados arredondados para 2 MB). Blocos menores que
+ * uma página enorme, ou sem suporte a THP, caem no `pather_malloc`.
+ * Liberado com `pather_free`.
+ *
+ * @param  tamanho número de bytes
+ * @return         bloco alocado, ou NULL se faltar memória ou orçamento
+ */
+void *pather_malloc_huge(size_t tamanho)
+{
+#ifdef MADV_HUGEPAGE
+  size_t pagina = (size_t)sysconf(_SC_PAGESIZE);
+  size_t total = pagina + ((tamanho + PAGINA_ENORME - 1) & ~(PAGINA_ENORME - 1));
+  unsigned char *mapa, *inicio, *fim;
+
+  if (tamanho < PAGINA_ENORME)
+    return pather_malloc(tamanho);
+
+  if (!reserva(total))
+    return NULL;
+
+  /* Mapeia uma página enorme a mais e devolve as sobras das pontas */
+  mapa = (unsigned char *)mmap(NULL, total + PAGINA_ENORME, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapa == MAP_FAILED)
+  {
+    __sync_sub_and_fetch(&atual, total);
+    return NULL;
+  }
+
+  inicio = (unsigned char *)(((uintptr_t)mapa + pagina + PAGINA_ENORME - 1) &
+                             ~(uintptr_t)(PAGINA_ENORME - 1)) - pagina;
+  fim = mapa + total + PAGINA_ENORME;
+  if (inicio > mapa)
+    munmap(mapa, (size_t)(inicio - mapa));
+  if (fim > inicio + total)
+    munmap(inicio + total, (size_t)(fim - inicio - total));
+
+  /* Só um pedido: sem THP no sistema, o bloco continua valendo */
+  madvise(inicio + pagina, total - pagina, MADV_HUGEPAGE);
+
+  TRACE_ALLOC(total);
+  grava_cabecalho(inicio + pagina, total, total);
+  return inicio + pagina;
+#else
+  return pather_malloc(tamanho);
+#endif
+}
+
+/**
+ * Tracked realloc
+ *
+ * Em caso de falha o bloco original continua válido, como no realloc.
+ */
+void *pather_realloc(void *ptr, size_t tamanho)
+{
+  unsigned char *bloco;
+  size_t antigo, mapeado;
+
+  if (!ptr)
+    return pather_malloc(tamanho);
+
+  bloco = (unsigned char *)ptr - CABECALHO;
+  memcpy(&antigo, bloco, sizeof(size_t));
+  memcpy(&mapeado, bloco + sizeof(size_t), sizeof(size_t));
+
+  /* Bloco mapeado não vai para o realloc: copia para um bloco comum */
+  if (mapeado)
+  {
+    size_t dados = mapeado - (size_t)sysconf(_SC_PAGESIZE);
+    void *novo = pather_malloc(tamanho);
+
+    if (!novo)
+      return NULL;
+    memcpy(novo, ptr, tamanho < dados ? tamanho : dados);
+    pather_free(ptr);
+    return novo;
+  }
+
+  if (tamanho > antigo && !reserva(tamanho - antigo))
+    return NULL;
+
+  bloco = (unsigned char *)realloc(bloco, CABECALHO + tamanho);
+  if (!bloco)
+  {
+    if (tamanho > antigo)
+      __sync_sub_and_fetch(&atual, tamanho - antigo);
+    return NULL;
+  }
+
+  if (tamanho < antigo)
+    __sync_sub_and_fetch(&atual, antigo - tamanho);
+
+  TRACE_ALLOC(tamanho);
+  grava_cabecalho(bloco + CABECALHO, tamanho, 0);
+  return bloco + CABECALHO;
+}
+
+/**
+ * Tracked free
+ */
+void pather_free(void *ptr)
+{
+  unsigned char *bloco;
+  size_t tamanho, mapeado;
+
+  if (!ptr)
+    return;
+
+  bloco = (unsigned char *)ptr - CABECALHO;
+  memcpy(&tamanho, bloco, sizeof(size_t));
+  memcpy(&mapeado, bloco + sizeof(size_t), sizeof(size_t));
+  __sync_sub_and_fetch(&atual, tamanho);
+
+  if (mapeado)
+    munmap((unsigned char *)ptr - (size_t)sysconf(_SC_PAGESIZE), mapeado);
+  else
+    free(bloco);
+}
+
+/**
+ * Start a Job
+ *
+ * Reinicia o pico (a partir do uso atual) e define o orçamento do
+ * job. Um orçamento 0 significa sem limite.
+ */
+void mem_job_begin(size_t limite)
+{
+  orcamento = limite;
+  pico = atual;
+}
+
+/**
+ * Budget from the Environment
+ *
+ * Lê `PATHER_MEM_BUDGET` com `mem_parse_size`.
+ *
+ * @return orçamento em bytes, ou 0 se não houver limite
+ */
+size_t mem_budget_from_env(void)
+{
+  return mem_parse_size(getenv("PATHER_MEM_BUDGET"));
+}
+
+/**
+ * Parse a Size
+ *
+ * Lê um tamanho em bytes, aceitando os sufixos K, M e G.
+ *
+ * @return tamanho em bytes, ou 0 se `valor` for NULL ou vazio
+ */
+size_t mem_parse_size(const char *valor)
+{
+  char *fim;
+  unsigned long long limite;
+
+  if (!valor || !*valor)
+    return 0;
+
+  limite = strtoull(valor, &fim, 10);
+  switch (*fim)
+  {
+    case 'G': case 'g': limite <<= 10; /* fall through */
+    case 'M': case 'm': limite <<= 10; /* fall through */
+    case 'K': case 'k': limite <<= 10; break;
+    default: break;
+  }
+
+  return (size_t)limite;
+}
+
+size_t mem_current(void)
+{
+  return atual;
+}
+
+size_t mem_peak(void)
+{
+  return pico;
+}
+
+/**
+ * Fits in Budget
+ *
+ * Indica se `tamanho` bytes a mais ainda cabem no orçamento. Serve para
+ * escolher um modo de baixa memória antes de começar uma etapa.
+ */
+int mem_fits(size_t tamanho)
+{
+  return !orcamento || atual + tamanho <= orcamento;
+}
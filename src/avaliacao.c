@@ -0,0 +1,482 @@
+/**
+ * Path Scoring
+ *
+ * O arquivo `.dt` tem um cabeçalho `CabecalhoDT` de 32 bytes seguido das
+ * linhas da DT, `largura` bytes cada, sem padding. Está na ordem de
+ * bytes do host, como o cache de resultados.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* File Header */
+#include <pather/avaliacao.h>
+#include <pather/alloc.h>
+#include <pather/hash.h>
+#include <pather/paralelo.h>
+
+#define DT_MAGICO 0x54445450u /* "PTDT" */
+#define DT_VERSAO 1u
+
+/**
+ * DT File Header
+ */
+typedef struct
+{
+  uint32_t magico;
+  uint32_t versao;
+  uint32_t largura;
+  uint32_t altura;
+  uint64_t hash;
+  uint64_t reservado;
+} CabecalhoDT;
+
+/*----------------------------------------------------------------------------*/
+/** Cria uma matriz com a transformada da distância de uma imagem. Para gerar
+ * um score automaticamente para fotografias sem entregar uma solução para o
+ * problema original, subverti o conceito da DT normal. Esta DT funciona mesmo
+ * se a imagem não tiver apenas bordas. Por outro lado, o algoritmo é pesado
+ * e consome bastante memória... Além disso, para manter tudo em uma imagem,
+ * a distância máxima é 255 (para esta aplicação, serve). Considerei aqui a
+ * distância L1 (Manhattan). */
+
+void criaMatrizDT (Imagem1C* img)
+{
+    int i, j, menor;
+
+    /* Acha o menor valor. */
+    menor = 255;
+    for (i = 0; i < img->altura; i++)
+        for (j = 0; j < img->largura; j++)
+            if (img->dados [i][j] < menor)
+                menor = img->dados [i][j];
+
+    /* "Puxa" todos os valores para baixo, de forma que o mínimo seja = 0. */
+    for (i = 0; i < img->altura; i++)
+        for (j = 0; j < img->largura; j++)
+            img->dados [i][j] -= menor;
+
+    /* Percorre a imagem inteira, procura pontos que mereçam atenção, e ajusta as distâncias recursivamente. */
+    for (i = 0; i < img->altura; i++)
+        for (j = 0; j < img->largura; j++)
+            preencheMatrizDT (img, i, j);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Sub-função recursiva para preencher a matriz. */
+
+void preencheMatrizDT (Imagem1C* img, int row, int col)
+{
+    if (img->dados [row][col] == 255)
+        return; /* Não tem como melhorar a partir deste ponto! */
+
+    /* Esquerda */
+    if (col > 0 && img->dados [row][col-1] > img->dados [row][col] + 1)
+    {
+        img->dados [row][col-1] = img->dados [row][col]+1;
+        preencheMatrizDT (img, row, col-1);
+    }
+
+    /* Direita */
+    if (col < img->largura-1 && img->dados [row][col+1] > img->dados [row][col] + 1)
+    {
+        img->dados [row][col+1] = img->dados [row][col]+1;
+        preencheMatrizDT (img, row, col+1);
+    }
+
+    /* Acima */
+    if (row > 0 && img->dados [row-1][col] > img->dados [row][col] + 1)
+    {
+        img->dados [row-1][col] = img->dados [row][col]+1;
+        preencheMatrizDT (img, row-1, col);
+    }
+
+    /* Abaixo */
+    if (row < img->altura-1 && img->dados [row+1][col] > img->dados [row][col] + 1)
+    {
+        img->dados [row+1][col] = img->dados [row][col]+1;
+        preencheMatrizDT (img, row+1, col);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* Testa um caminho. Computa um score para o mesmo. Um fracasso faz a função
+ * retornar -1. Os scores não fazem sentido isoladamente, eles serão
+ * posteriormente normalizados pelo desempenho dos programas testados. */
+
+long testaCaminho (Coordenada* caminho, int n, Imagem1C* dt)
+{
+    int c, vizinho_em_x, vizinho_em_y;
+    unsigned long score;
+
+    /* Verifica se o caminho é longo o suficiente, se começa na coluna da esquerda e termina na coluna da direita. */
+    if (n < dt->largura || caminho [0].x != 0 || caminho [n-1].x != dt->largura-1)
+        return (-1);
+
+    /* Verifica se todos os pontos são vizinhos. */
+    for (c = 1; c < n; c++)
+    {
+        vizinho_em_x = caminho [c].x == caminho [c-1].x-1 || caminho [c].x == caminho [c-1].x+1;
+        vizinho_em_y = caminho [c].y == caminho [c-1].y-1 || caminho [c].y == caminho [c-1].y+1;
+
+        if ((!vizinho_em_x && !vizinho_em_y) || (vizinho_em_x && vizinho_em_y))
+            return (-1);
+    }
+
+    /* Calcula o score para este caminho. */
+    score = 0;
+    for (c = 0; c < n; c++)
+        score += dt->dados [caminho [c].y][caminho [c].x];
+    return (score);
+}
+
+/*============================================================================*/
+
+/**
+ * Map a DT File
+ *
+ * Mapeia `arquivo` e confere se ele é a DT de uma imagem com as
+ * dimensões e o hash dados.
+ *
+ * @return a DT mapeada, ou NULL se o arquivo não existe ou não confere
+ */
+static MatrizDT *mapeiaMatrizDT(const char *arquivo, unsigned long largura, unsigned long altura, uint64_t hash)
+{
+  const CabecalhoDT *cabecalho;
+  unsigned char *mapa;
+  struct stat info;
+  MatrizDT *dt;
+  size_t tamanho;
+  int fd;
+
+  fd = open(arquivo, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  tamanho = sizeof(CabecalhoDT) + (size_t)largura * altura;
+  if (fstat(fd, &info) != 0 || (size_t)info.st_size != tamanho)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  mapa = (unsigned char *)mmap(NULL, tamanho, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapa == MAP_FAILED)
+    return NULL;
+
+  cabecalho = (const CabecalhoDT *)mapa;
+  if (cabecalho->magico != DT_MAGICO || cabecalho->versao != DT_VERSAO ||
+      cabecalho->largura != largura || cabecalho->altura != altura ||
+      cabecalho->hash != hash)
+    goto invalido;
+
+  dt = (MatrizDT *)pather_malloc(sizeof(MatrizDT));
+  if (!dt)
+    goto invalido;
+  dt->img = (Imagem1C *)pather_malloc(sizeof(Imagem1C));
+  if (!dt->img)
+  {
+    pather_free(dt);
+    goto invalido;
+  }
+  dt->img->dados = (unsigned char **)pather_malloc(sizeof(unsigned char *) * altura);
+  if (!dt->img->dados)
+  {
+    pather_free(dt->img);
+    pather_free(dt);
+    goto invalido;
+  }
+
+  /* As linhas da imagem apontam direto para as páginas do arquivo */
+  dt->img->largura = largura;
+  dt->img->altura = altura;
+  for (unsigned long y = 0; y < altura; y++)
+    dt->img->dados[y] = mapa + sizeof(CabecalhoDT) + y * largura;
+  dt->mapa = mapa;
+  dt->tamanho = tamanho;
+  return dt;
+
+invalido:
+  munmap(mapa, tamanho);
+  return NULL;
+}
+
+/**
+ * Write a DT File
+ *
+ * Grava em um arquivo temporário único (`mkstemp`) e publica com rename,
+ * para que outro processo ou thread nunca mapeie uma DT pela metade.
+ * Falhar aqui só custa recalcular a DT na próxima vez.
+ */
+static void gravaMatrizDT(const char *arquivo, Imagem1C *img, uint64_t hash)
+{
+  char temporario[4096];
+  CabecalhoDT cabecalho;
+  FILE *stream;
+  int fd, ok;
+
+  memset(&cabecalho, 0, sizeof(cabecalho));
+  cabecalho.magico = DT_MAGICO;
+  cabecalho.versao = DT_VERSAO;
+  cabecalho.largura = (uint32_t)img->largura;
+  cabecalho.altura = (uint32_t)img->altura;
+  cabecalho.hash = hash;
+
+  if (snprintf(temporario, sizeof(temporario), "%s.XXXXXX", arquivo) >= (int)sizeof(temporario))
+    return;
+
+  fd = mkstemp(temporario);
+  if (fd < 0)
+    return;
+
+  fchmod(fd, 0644);
+  stream = fdopen(fd, "wb");
+  if (!stream)
+  {
+    close(fd);
+    unlink(temporario);
+    return;
+  }
+
+  ok = fwrite(&cabecalho, sizeof(cabecalho), 1, stream) == 1;
+  for (unsigned long y = 0; ok && y < img->altura; y++)
+    ok = fwrite(img->dados[y], 1, img->largura, stream) == img->largura;
+  ok = fclose(stream) == 0 && ok;
+
+  if (!ok || rename(temporario, arquivo) != 0)
+    unlink(temporario);
+}
+
+/**
+ * Open the DT of an Image
+ *
+ * Reaproveita `<arquivo>.dt` se ele corresponder à imagem atual; senão
+ * calcula a DT com `criaMatrizDT` e grava o arquivo para as próximas
+ * execuções. A imagem ainda é decodificada para conferir o hash, mas
+ * isso é muito mais barato que a DT.
+ *
+ * @param  arquivo caminho do BMP
+ * @return         a DT, ou NULL se a imagem não pôde ser aberta
+ */
+MatrizDT *abreMatrizDT(char *arquivo)
+{
+  char nome[4096];
+  Imagem1C *img;
+  MatrizDT *dt;
+  uint64_t hash;
+  int com_arquivo;
+
+  img = abreImagem1C(arquivo);
+  if (!img)
+    return NULL;
+
+  hash = hash_imagem1C(img);
+  /* Caminho longo demais para o `.dt`: só calcula, sem arquivo */
+  com_arquivo = snprintf(nome, sizeof(nome), "%s.dt", arquivo) < (int)sizeof(nome);
+
+  dt = com_arquivo ? mapeiaMatrizDT(nome, img->largura, img->altura, hash) : NULL;
+  if (dt)
+  {
+    destroiImagem1C(img);
+    return dt;
+  }
+
+  dt = (MatrizDT *)pather_malloc(sizeof(MatrizDT));
+  if (!dt)
+  {
+    destroiImagem1C(img);
+    return NULL;
+  }
+
+  criaMatrizDT(img);
+  if (com_arquivo)
+    gravaMatrizDT(nome, img, hash);
+
+  dt->img = img;
+  dt->mapa = NULL;
+  dt->tamanho = 0;
+  return dt;
+}
+
+/**
+ * Release a DT
+ */
+void liberaMatrizDT(MatrizDT *dt)
+{
+  if (!dt)
+    return;
+
+  if (dt->mapa)
+  {
+    munmap(dt->mapa, dt->tamanho);
+    pather_free(dt->img->dados);
+    pather_free(dt->img);
+  }
+  else
+    destroiImagem1C(dt->img);
+
+  pather_free(dt);
+}
+
+/*============================================================================*/
+
+/**
+ * Batch Scoring Job
+ *
+ * Estado compartilhado pelas threads do `testaCaminhos`. Cada thread
+ * pega o próximo caminho com um incremento atômico, o que equilibra a
+ * carga mesmo com caminhos de tamanhos bem diferentes.
+ */
+typedef struct
+{
+  Coordenada **caminhos;
+  const int *n;
+  int n_caminhos;
+  Imagem1C *dt;
+  long *scores;
+  int proximo;
+} LoteAvaliacao;
+
+/**
+ * Check Steps
+ *
+ * Mesma regra do `testaCaminho`: em cada passo, exatamente um entre
+ * |dx| e |dy| vale 1. Além disso, todos os pontos precisam estar dentro
+ * da imagem, pois a DT é lida sem verificação depois. A versão SSE2
+ * testa dois passos por registrador; a comparação sem sinal com os
+ * limites é feita deslocando os valores por INT32_MIN.
+ *
+ * @return 1 se o caminho é válido
+ */
+static int verificaPassos(const Coordenada *caminho, int n, unsigned long largura, unsigned long altura)
+{
+  int c = 1;
+
+#ifdef __SSE2__
+  const __m128i um = _mm_set1_epi32(1);
+  const __m128i menos_um = _mm_set1_epi32(-1);
+  const __m128i sinal = _mm_set1_epi32(INT32_MIN);
+  const __m128i limite = _mm_xor_si128(_mm_set_epi32((int)altura, (int)largura, (int)altura, (int)largura), sinal);
+  __m128i ok = _mm_set1_epi32(-1);
+
+  if (largura > INT32_MAX || altura > INT32_MAX)
+    return 0;
+
+  for (; c + 2 <= n; c += 2)
+  {
+    __m128i atual = _mm_loadu_si128((const __m128i *)&caminho[c]);
+    __m128i anterior = _mm_loadu_si128((const __m128i *)&caminho[c - 1]);
+    __m128i d = _mm_sub_epi32(atual, anterior);
+    __m128i unitario = _mm_or_si128(_mm_cmpeq_epi32(d, um), _mm_cmpeq_epi32(d, menos_um));
+
+    /* Exatamente um dos dois eixos unitário: x ^ y precisa ser verdadeiro */
+    ok = _mm_and_si128(ok, _mm_xor_si128(unitario, _mm_shuffle_epi32(unitario, _MM_SHUFFLE(2, 3, 0, 1))));
+    ok = _mm_and_si128(ok, _mm_cmplt_epi32(_mm_xor_si128(atual, sinal), limite));
+  }
+
+  if (_mm_movemask_epi8(ok) != 0xFFFF)
+    return 0;
+#endif
+
+  for (; c < n; c++)
+  {
+    int dx = caminho[c].x - caminho[c - 1].x;
+    int dy = caminho[c].y - caminho[c - 1].y;
+
+    if (((dx == 1 || dx == -1) == (dy == 1 || dy == -1)) ||
+        (unsigned long)(unsigned)caminho[c].x >= largura || (unsigned long)(unsigned)caminho[c].y >= altura)
+      return 0;
+  }
+
+  /* O primeiro ponto só é checado aqui (x já foi conferido pelo chamador) */
+  return (unsigned long)(unsigned)caminho[0].y < altura;
+}
+
+/**
+ * Gather DT Values
+ *
+ * Soma a DT ao longo do caminho com quatro acumuladores independentes,
+ * sem desvios no laço.
+ */
+static long somaDT(const Coordenada *caminho, int n, unsigned char **dados)
+{
+  unsigned long s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int c = 0;
+
+  for (; c + 4 <= n; c += 4)
+  {
+    s0 += dados[caminho[c].y][caminho[c].x];
+    s1 += dados[caminho[c + 1].y][caminho[c + 1].x];
+    s2 += dados[caminho[c + 2].y][caminho[c + 2].x];
+    s3 += dados[caminho[c + 3].y][caminho[c + 3].x];
+  }
+  for (; c < n; c++)
+    s0 += dados[caminho[c].y][caminho[c].x];
+
+  return (long)(s0 + s1 + s2 + s3);
+}
+
+/**
+ * Batch Scoring Worker
+ */
+static void *avaliaLote(void *arg)
+{
+  LoteAvaliacao *lote = (LoteAvaliacao *)arg;
+  Imagem1C *dt = lote->dt;
+  int i;
+
+  while ((i = __sync_fetch_and_add(&lote->proximo, 1)) < lote->n_caminhos)
+  {
+    const Coordenada *caminho = lote->caminhos[i];
+    int n = lote->n[i];
+
+    if (!caminho || n < (long)dt->largura || caminho[0].x != 0 ||
+        caminho[n - 1].x != (long)dt->largura - 1 ||
+        !verificaPassos(caminho, n, dt->largura, dt->altura))
+      lote->scores[i] = -1;
+    else
+      lote->scores[i] = somaDT(caminho, n, dt->dados);
+  }
+
+  return NULL;
+}
+
+/**
+ * Score Many Paths
+ *
+ * Versão em lote do `testaCaminho` para vários caminhos da mesma
+ * imagem. Os scores são os mesmos do `testaCaminho`; caminhos com
+ * pontos fora da imagem também recebem -1.
+ *
+ * @param caminhos   os caminhos candidatos
+ * @param n          número de coordenadas de cada caminho
+ * @param n_caminhos número de caminhos
+ * @param dt         a transformada de distância da imagem
+ * @param scores     saída: o score de cada caminho, ou -1
+ * @param n_threads  threads a usar; 0 usa um por processador
+ */
+void testaCaminhos(Coordenada **caminhos, const int *n, int n_caminhos, Imagem1C *dt, long *scores, int n_threads)
+{
+  LoteAvaliacao lote = { caminhos, n, n_caminhos, dt, scores, 0 };
+
+  if (n_caminhos <= 0)
+    return;
+
+  /* Todas as threads tiram caminhos do mesmo lote */
+  parallel_run(avaliaLote, &lote, 0, parallel_threads(n_threads, (unsigned long)n_caminhos));
+}
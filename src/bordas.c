@@ -0,0 +1,417 @@
+/**
+ * Canny Edges
+ *
+ * Três passadas: gradiente e supressão dividem as linhas entre threads
+ * (cada faixa escreve só as suas linhas), e a histerese, que segue as
+ * bordas pela imagem toda, roda na thread atual. Memória de trabalho:
+ * magnitude (2 bytes), direção e classe (1 byte cada) por pixel; as
+ * duas primeiras são liberadas antes da histerese.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* File Header */
+#include <pather/bordas.h>
+#include <pather/alloc.h>
+#include <pather/paralelo.h>
+#include <pather/mascaras.h>
+
+/* Setores da direção do gradiente (a borda é perpendicular a ele) */
+#define DIRECAO_0   0 /* Gradiente horizontal: vizinhos da esquerda e da direita */
+#define DIRECAO_45  1 /* Diagonal descendo: (x - 1, y - 1) e (x + 1, y + 1) */
+#define DIRECAO_90  2 /* Gradiente vertical: vizinhos de cima e de baixo */
+#define DIRECAO_135 3 /* Diagonal subindo: (x + 1, y - 1) e (x - 1, y + 1) */
+
+/* Classes depois da supressão */
+#define CLASSE_NENHUMA 0
+#define CLASSE_FRACA   1
+#define CLASSE_FORTE   2
+#define CLASSE_LIGADA  3 /* Já entrou na pilha da histerese */
+
+/* tan(22.5°) ~ 13 / 32; com |g| <= 1020, 32 * |g| ainda cabe em int16 */
+#define TAN_NUM 13
+#define TAN_DEN 32
+
+typedef enum
+{
+  FASE_GRADIENTE,
+  FASE_SUPRESSAO
+} FaseCanny;
+
+/**
+ * Work Range
+ */
+typedef struct
+{
+  FaseCanny fase;
+  Imagem1C *img;
+  int16_t *magnitude;
+  uint8_t *direcao;
+  uint8_t *classe;
+  int16_t *linhas;         /* gx e gy da faixa, alocados pelo `paralelo` */
+  int baixo, alto;
+  int *falhou;
+  unsigned long inicio, fim;
+} TarefaCanny;
+
+static void *executa(void *arg);
+
+/**
+ * Run a Phase over Row Bands
+ *
+ * A thread atual fica com a primeira faixa e com as que não puderam
+ * ser criadas. Os `rascunho` bytes de `linhas` de cada faixa são
+ * alocados aqui, antes de criar as threads; se faltar memória, marca
+ * `falhou` e não roda nenhuma faixa.
+ */
+static void paralelo(TarefaCanny *modelo, unsigned long total, int n_threads, size_t rascunho)
+{
+  TarefaCanny tarefas[PATHER_MAX_THREADS];
+
+  n_threads = parallel_threads(n_threads, total);
+  for (int t = 0; t < n_threads; t++)
+  {
+    tarefas[t] = *modelo;
+    tarefas[t].inicio = total * t / n_threads;
+    tarefas[t].fim = total * (t + 1) / n_threads;
+    tarefas[t].linhas = rascunho ? (int16_t *)pather_malloc(rascunho) : NULL;
+    if (rascunho && !tarefas[t].linhas)
+      *modelo->falhou = 1;
+  }
+
+  if (*modelo->falhou)
+  {
+    for (int t = 0; t < n_threads; t++)
+      pather_free(tarefas[t].linhas);
+    return;
+  }
+
+  parallel_run(executa, tarefas, sizeof(TarefaCanny), n_threads);
+  for (int t = 0; t < n_threads; t++)
+    pather_free(tarefas[t].linhas);
+}
+
+/**
+ * Gradient Magnitude and Direction
+ *
+ * As linhas e colunas da borda da imagem ficam com magnitude 0.
+ */
+static void gradiente(TarefaCanny *tarefa)
+{
+  Imagem1C *img = tarefa->img;
+  const unsigned long largura = img->largura, altura = img->altura;
+  LinhaMascara sobel_x = mask_row(PATHER_KERNEL_SOBEL_X), sobel_y = mask_row(PATHER_KERNEL_SOBEL_Y);
+  int16_t *gx = tarefa->linhas, *gy = gx + largura;
+
+  for (unsigned long y = tarefa->inicio; y < tarefa->fim; y++)
+  {
+    int16_t *magnitude = tarefa->magnitude + y * largura;
+    uint8_t *direcao = tarefa->direcao + y * largura;
+
+    memset(magnitude, 0, largura * sizeof(int16_t));
+    memset(direcao, DIRECAO_0, largura);
+    if (y == 0 || y == altura - 1)
+      continue;
+
+    sobel_x(img->dados[y - 1], img->dados[y], img->dados[y + 1], gx, largura);
+    sobel_y(img->dados[y - 1], img->dados[y], img->dados[y + 1], gy, largura);
+
+    for (unsigned long x = 1; x + 1 < largura; x++)
+    {
+      int ax = abs(gx[x]), ay = abs(gy[x]);
+
+      magnitude[x] = (int16_t)(ax + ay);
+      if (ay * TAN_DEN <= ax * TAN_NUM)
+        direcao[x] = DIRECAO_0;
+      else if (ax * TAN_DEN <= ay * TAN_NUM)
+        direcao[x] = DIRECAO_90;
+      else
+        direcao[x] = (gx[x] < 0) == (gy[x] < 0) ? DIRECAO_45 : DIRECAO_135;
+    }
+  }
+}
+
+/**
+ * Non-maximum Suppression of One Pixel
+ */
+static uint8_t suprime(const int16_t *m, long largura, uint8_t direcao, int baixo, int alto)
+{
+  int a, b;
+
+  switch (direcao)
+  {
+    case DIRECAO_0:  a = m[-1];           b = m[1];            break;
+    case DIRECAO_45: a = m[-largura - 1]; b = m[largura + 1];  break;
+    case DIRECAO_90: a = m[-largura];     b = m[largura];      break;
+    default:         a = m[-largura + 1]; b = m[largura - 1];  break;
+  }
+
+  if (m[0] <= a || m[0] < b)
+    return CLASSE_NENHUMA;
+  return m[0] >= alto ? CLASSE_FORTE : m[0] >= baixo ? CLASSE_FRACA : CLASSE_NENHUMA;
+}
+
+/**
+ * Non-maximum Suppression and Classification
+ *
+ * A versão SSE2 carrega os três vizinhos de cima, os três de baixo e
+ * os dois do lado de 8 pixels, monta os vizinhos `a` e `b` de cada um
+ * com máscaras por setor e compara tudo de uma vez.
+ */
+static void supressao(TarefaCanny *tarefa)
+{
+  const unsigned long largura = tarefa->img->largura, altura = tarefa->img->altura;
+
+  for (unsigned long y = tarefa->inicio; y < tarefa->fim; y++)
+  {
+    const int16_t *m = tarefa->magnitude + y * largura;
+    const uint8_t *direcao = tarefa->direcao + y * largura;
+    uint8_t *classe = tarefa->classe + y * largura;
+    unsigned long x = 1;
+
+    memset(classe, CLASSE_NENHUMA, largura);
+    if (y == 0 || y == altura - 1 || largura < 3)
+      continue;
+
+#ifdef __SSE2__
+    {
+      const int16_t *c = m - largura, *b = m + largura;
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i um = _mm_set1_epi16(1);
+      const __m128i d45 = _mm_set1_epi16(DIRECAO_45);
+      const __m128i d90 = _mm_set1_epi16(DIRECAO_90);
+      const __m128i d135 = _mm_set1_epi16(DIRECAO_135);
+      const __m128i alto = _mm_set1_epi16((int16_t)tarefa->alto);
+      const __m128i baixo = _mm_set1_epi16((int16_t)tarefa->baixo);
+
+      for (; x + 8 < largura; x += 8)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i *)(m + x));
+        __m128i d = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(direcao + x)), zero);
+        __m128i s45 = _mm_cmpeq_epi16(d, d45), s90 = _mm_cmpeq_epi16(d, d90), s135 = _mm_cmpeq_epi16(d, d135);
+        __m128i s0 = _mm_cmpeq_epi16(d, zero);
+        __m128i a, n, manter, forte, fraco;
+
+        a = _mm_or_si128(_mm_or_si128(_mm_and_si128(s0, _mm_loadu_si128((const __m128i *)(m + x - 1))),
+                                      _mm_and_si128(s45, _mm_loadu_si128((const __m128i *)(c + x - 1)))),
+                         _mm_or_si128(_mm_and_si128(s90, _mm_loadu_si128((const __m128i *)(c + x))),
+                                      _mm_and_si128(s135, _mm_loadu_si128((const __m128i *)(c + x + 1)))));
+        n = _mm_or_si128(_mm_or_si128(_mm_and_si128(s0, _mm_loadu_si128((const __m128i *)(m + x + 1))),
+                                      _mm_and_si128(s45, _mm_loadu_si128((const __m128i *)(b + x + 1)))),
+                         _mm_or_si128(_mm_and_si128(s90, _mm_loadu_si128((const __m128i *)(b + x))),
+                                      _mm_and_si128(s135, _mm_loadu_si128((const __m128i *)(b + x - 1)))));
+
+        /* v > a e v >= n; depois, fraco se v >= baixo e forte se v >= alto */
+        manter = _mm_andnot_si128(_mm_cmpgt_epi16(n, v), _mm_cmpgt_epi16(v, a));
+        fraco = _mm_andnot_si128(_mm_cmpgt_epi16(baixo, v), manter);
+        forte = _mm_andnot_si128(_mm_cmpgt_epi16(alto, v), manter);
+        v = _mm_add_epi16(_mm_and_si128(fraco, um), _mm_and_si128(forte, um));
+        _mm_storel_epi64((__m128i *)(classe + x), _mm_packus_epi16(v, v));
+      }
+    }
+#endif
+
+    for (; x + 1 < largura; x++)
+      classe[x] = suprime(m + x, (long)largura, direcao[x], tarefa->baixo, tarefa->alto);
+  }
+}
+
+static void *executa(void *arg)
+{
+  TarefaCanny *tarefa = (TarefaCanny *)arg;
+
+  switch (tarefa->fase)
+  {
+    case FASE_GRADIENTE: gradiente(tarefa); break;
+    case FASE_SUPRESSAO: supressao(tarefa); break;
+  }
+
+  return NULL;
+}
+
+/**
+ * Automatic Thresholds
+ *
+ * `alto` é o threshold de Otsu das magnitudes não nulas, e `baixo` a
+ * metade dele.
+ */
+static void limiares_automaticos(const int16_t *magnitude, size_t n_pixels, int *baixo, int *alto)
+{
+  uint32_t *histograma = (uint32_t *)pather_malloc((CANNY_MAGNITUDE_MAX + 1) * sizeof(uint32_t));
+  uint64_t total = 0, soma_total = 0, omega = 0, myu = 0;
+  double melhor = -1.0;
+  int limiar = 1;
+
+  /* Sem memória para o histograma, um valor fixo razoável */
+  *alto = 200;
+  *baixo = 100;
+  if (!histograma)
+    return;
+
+  memset(histograma, 0, (CANNY_MAGNITUDE_MAX + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < n_pixels; i++)
+    histograma[magnitude[i]]++;
+  for (int v = 1; v <= CANNY_MAGNITUDE_MAX; v++)
+  {
+    total += histograma[v];
+    soma_total += (uint64_t)v * histograma[v];
+  }
+
+  for (int v = 1; v < CANNY_MAGNITUDE_MAX && total > 0; v++)
+  {
+    double sigma, w0, w1, m0, m1;
+
+    omega += histograma[v];
+    myu += (uint64_t)v * histograma[v];
+    if (omega == 0 || omega == total)
+      continue;
+
+    w0 = (double)omega / total;
+    w1 = 1.0 - w0;
+    m0 = (double)myu / omega;
+    m1 = (double)(soma_total - myu) / (total - omega);
+    sigma = w0 * w1 * (m0 - m1) * (m0 - m1);
+    if (sigma > melhor)
+    {
+      melhor = sigma;
+      limiar = v + 1;
+    }
+  }
+
+  pather_free(histograma);
+  if (total > 0)
+  {
+    *alto = limiar;
+    *baixo = limiar / 2 > 0 ? limiar / 2 : 1;
+  }
+}
+
+/**
+ * Hysteresis
+ *
+ * Liga os pixels fortes e, a partir deles, os fracos ligados a eles
+ * por vizinhança-8. A pilha guarda os índices ainda por expandir; um
+ * pixel é marcado ao entrar nela, então nenhum entra duas vezes.
+ *
+ * @return 1, ou 0 se faltar memória para a pilha
+ */
+static int histerese(uint8_t *classe, unsigned long largura, unsigned long altura, ImagemBinaria *bin)
+{
+  size_t n = 0, capacidade = 4096;
+  uint32_t *pilha = (uint32_t *)pather_malloc(capacidade * sizeof(uint32_t));
+  const long vizinhos[8] = { -(long)largura - 1, -(long)largura, -(long)largura + 1, -1, 1,
+                             (long)largura - 1, (long)largura, (long)largura + 1 };
+
+  if (!pilha)
+    return 0;
+
+  for (uint32_t i = 0; i < (uint32_t)(largura * altura); i++)
+  {
+    if (classe[i] != CLASSE_FORTE)
+      continue;
+    classe[i] = CLASSE_LIGADA;
+    pilha[n++] = i;
+
+    /* As classes da borda da imagem são nulas, então os vizinhos de
+       qualquer pixel na pilha estão dentro dela */
+    while (n > 0)
+    {
+      uint32_t no = pilha[--n];
+
+      bin->dados[(no / largura) * bin->palavras + (no % largura) / 64] |= (uint64_t)1 << ((no % largura) % 64);
+      for (int v = 0; v < 8; v++)
+      {
+        uint32_t u = (uint32_t)((long)no + vizinhos[v]);
+        if (classe[u] != CLASSE_FRACA)
+          continue;
+
+        if (n == capacidade)
+        {
+          uint32_t *nova = (uint32_t *)pather_realloc(pilha, 2 * capacidade * sizeof(uint32_t));
+          if (!nova)
+          {
+            pather_free(pilha);
+            return 0;
+          }
+          pilha = nova;
+          capacidade *= 2;
+        }
+        classe[u] = CLASSE_LIGADA;
+        pilha[n++] = u;
+      }
+    }
+  }
+
+  pather_free(pilha);
+  return 1;
+}
+
+/**
+ * Canny Edge Detection
+ *
+ * @param  img       imagem de entrada
+ * @param  baixo     magnitude mínima de um pixel fraco
+ * @param  alto      magnitude mínima de um pixel forte (0 escolhe os
+ *                   dois pelo Otsu das magnitudes)
+ * @param  n_threads threads a usar; 0 usa um por processador
+ * @return           imagem binária com as bordas ligadas, ou NULL se
+ *                   faltar memória
+ */
+ImagemBinaria *canny_edges(Imagem1C *img, int baixo, int alto, int n_threads)
+{
+  const size_t n_pixels = (size_t)img->largura * img->altura;
+  TarefaCanny modelo;
+  ImagemBinaria *bin;
+  int falhou = 0;
+
+  bin = bin_create(img->largura, img->altura);
+  if (!bin)
+    return NULL;
+
+  memset(&modelo, 0, sizeof(modelo));
+  modelo.img = img;
+  modelo.falhou = &falhou;
+  modelo.magnitude = (int16_t *)pather_malloc(n_pixels * sizeof(int16_t));
+  modelo.direcao = (uint8_t *)pather_malloc(n_pixels);
+  modelo.classe = (uint8_t *)pather_malloc(n_pixels);
+  if (!modelo.magnitude || !modelo.direcao || !modelo.classe)
+    goto erro;
+
+  modelo.fase = FASE_GRADIENTE;
+  paralelo(&modelo, img->altura, n_threads, 2 * img->largura * sizeof(int16_t));
+  if (falhou)
+    goto erro;
+
+  if (alto <= 0)
+    limiares_automaticos(modelo.magnitude, n_pixels, &baixo, &alto);
+  modelo.alto = alto < CANNY_MAGNITUDE_MAX ? alto : CANNY_MAGNITUDE_MAX;
+  modelo.baixo = baixo > 0 && baixo < modelo.alto ? baixo : modelo.alto;
+
+  modelo.fase = FASE_SUPRESSAO;
+  paralelo(&modelo, img->altura, n_threads, 0);
+  pather_free(modelo.magnitude);
+  pather_free(modelo.direcao);
+  modelo.magnitude = NULL;
+  modelo.direcao = NULL;
+
+  if (!histerese(modelo.classe, img->largura, img->altura, bin))
+    goto erro;
+
+  pather_free(modelo.classe);
+  return bin;
+
+erro:
+  pather_free(modelo.magnitude);
+  pather_free(modelo.direcao);
+  pather_free(modelo.classe);
+  bin_destroy(bin);
+  return NULL;
+}
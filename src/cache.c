@@ -0,0 +1,361 @@
+/**
+ * Result Cache
+ *
+ * Formato de uma entrada: um cabeçalho `EntradaCache` (na ordem de
+ * bytes do host, pois o cache é local à máquina) seguido do caminho no
+ * formato do `codec.h`, com checksum.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+/* Standard Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+/* File Header */
+#include <pather/cache.h>
+#include <pather/hash.h>
+#include <pather/alloc.h>
+#include <pather/codec.h>
+
+#define CACHE_MAGICO 0x43485450u /* "PTHC" */
+#define CACHE_VERSAO 3u
+#define CACHE_SUFIXO ".path"
+
+/**
+ * Entry Header
+ */
+typedef struct
+{
+  uint32_t magico;
+  uint32_t versao;
+  uint64_t chave;
+} EntradaCache;
+
+/**
+ * Entry Metadata
+ *
+ * Usado só na remoção das entradas menos usadas.
+ */
+typedef struct
+{
+  char nome[64];
+  off_t tamanho;
+  struct timespec uso;
+} InfoEntrada;
+
+/**
+ * Cache Key
+ *
+ * Hash dos pixels combinado com as opções que mudam o resultado. A
+ * máscara (`kernel`) fica de fora: ela só afeta o dump de depuração.
+ */
+uint64_t cache_key(Imagem1C *img, const PatherConfig *config)
+{
+  int32_t opcoes[14] = { CACHE_VERSAO, config->solver, config->threshold,
+                         config->close_radius, config->gap_length,
+                         config->min_component, config->restrict_components,
+                         config->threshold_window, (int32_t)(config->threshold_k * 1e6),
+                         config->prefilter, (int32_t)(config->prefilter_sigma * 1e6),
+                         config->prefilter_radius, config->canny_low, config->canny_high };
+  return hash_bytes(opcoes, sizeof(opcoes), hash_imagem1C(img));
+}
+
+/**
+ * Entry Path
+ *
+ * @return 1 se o caminho coube em `destino`, 0 se seria truncado
+ */
+static int nome_entrada(char *destino, size_t tamanho, const char *dir, uint64_t chave)
+{
+  int n = snprintf(destino, tamanho, "%s/%016llx" CACHE_SUFIXO, dir, (unsigned long long)chave);
+  return n >= 0 && (size_t)n < tamanho;
+}
+
+/**
+ * Full Read/Write
+ */
+static int le_tudo(int fd, void *dados, size_t n)
+{
+  unsigned char *p = (unsigned char *)dados;
+  while (n > 0)
+  {
+    ssize_t lido = read(fd, p, n);
+    if (lido < 0 && errno == EINTR)
+      continue;
+    if (lido <= 0)
+      return 0;
+    p += lido;
+    n -= lido;
+  }
+  return 1;
+}
+
+static int escreve_tudo(int fd, const void *dados, size_t n)
+{
+  const unsigned char *p = (const unsigned char *)dados;
+  while (n > 0)
+  {
+    ssize_t escrito = write(fd, p, n);
+    if (escrito < 0 && errno == EINTR)
+      continue;
+    if (escrito <= 0)
+      return 0;
+    p += escrito;
+    n -= escrito;
+  }
+  return 1;
+}
+
+/**
+ * Cache Lookup
+ *
+ * Em caso de acerto, atualiza o mtime da entrada (marca de uso do LRU).
+ * O caminho retornado deve ser liberado com free().
+ *
+ * @return número de coordenadas, ou -1 se a entrada não existe ou é inválida
+ */
+int cache_lookup(const char *dir, uint64_t chave, Coordenada **caminho, long *custo)
+{
+  char arquivo[4096];
+  EntradaCache entrada;
+  struct stat info;
+  unsigned char *dados;
+  size_t tamanho;
+  int fd, n;
+
+  *caminho = NULL;
+  if (!nome_entrada(arquivo, sizeof(arquivo), dir, chave))
+    return -1;
+
+  fd = open(arquivo, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  /* Confere cabeçalho e tamanho antes de confiar no conteúdo */
+  if (fstat(fd, &info) != 0 || !le_tudo(fd, &entrada, sizeof(entrada)) ||
+      entrada.magico != CACHE_MAGICO || entrada.versao != CACHE_VERSAO ||
+      entrada.chave != chave || info.st_size <= (off_t)sizeof(entrada))
+  {
+    close(fd);
+    return -1;
+  }
+
+  /* O codec confere o tamanho e o checksum do caminho */
+  tamanho = (size_t)info.st_size - sizeof(entrada);
+  dados = (unsigned char *)pather_malloc(tamanho);
+  if (!dados || !le_tudo(fd, dados, tamanho) || (n = path_decode(dados, tamanho, caminho, custo)) < 0)
+  {
+    pather_free(dados);
+    close(fd);
+    return -1;
+  }
+  pather_free(dados);
+
+  /* Marca o uso para o LRU; falhar aqui não invalida o acerto */
+  futimens(fd, NULL);
+  close(fd);
+  return n;
+}
+
+/**
+ * LRU Order
+ */
+static int compara_uso(const void *a, const void *b)
+{
+  const struct timespec *ta = &((const InfoEntrada *)a)->uso;
+  const struct timespec *tb = &((const InfoEntrada *)b)->uso;
+
+  if (ta->tv_sec != tb->tv_sec)
+    return ta->tv_sec < tb->tv_sec ? -1 : 1;
+  if (ta->tv_nsec != tb->tv_nsec)
+    return ta->tv_nsec < tb->tv_nsec ? -1 : 1;
+  return 0;
+}
+
+/**
+ * Store the Size Estimate
+ *
+ * Grava a estimativa no `.lock`. Se ela não é confiável (`valida` 0) ou
+ * não pôde ser gravada, apaga a que estava lá, para a próxima gravação
+ * varrer o diretório.
+ *
+ * @return 1 se o `.lock` ficou consistente, 0 do contrário
+ */
+static int grava_estimativa(int trava, uint64_t estimativa, int valida)
+{
+  if (valida && pwrite(trava, &estimativa, sizeof(estimativa), 0) == (ssize_t)sizeof(estimativa))
+    return 1;
+  return ftruncate(trava, 0) == 0;
+}
+
+/**
+ * Evict Least Recently Used Entries
+ *
+ * O arquivo `.lock` guarda uma estimativa (uint64_t) do tamanho do
+ * cache. Cada entrada nova soma `acrescimo` a ela e, enquanto couber em
+ * `max_bytes`, nada mais é feito. Só quando a estimativa passa do
+ * limite (ou ainda não existe) o diretório é varrido: as entradas são
+ * somadas, as de uso mais antigo são removidas até caber e o total
+ * exato volta para o `.lock`. Entradas sobrescritas ou apagadas por
+ * fora só fazem a estimativa sobrar, o que adianta a próxima varredura.
+ *
+ * Um flock exclusivo no `.lock` serializa a estimativa e a remoção
+ * entre processos; leitores não precisam dele, pois um arquivo aberto
+ * continua legível depois do unlink.
+ */
+static void cache_evict(const char *dir, size_t max_bytes, uint64_t acrescimo)
+{
+  char arquivo[4096];
+  InfoEntrada *entradas = NULL;
+  size_t n = 0, capacidade = 0;
+  off_t total = 0;
+  uint64_t estimativa;
+  int completa = 1;
+  struct dirent *item;
+  struct stat info;
+  DIR *d;
+  int trava;
+
+  snprintf(arquivo, sizeof(arquivo), "%s/.lock", dir);
+  trava = open(arquivo, O_RDWR | O_CREAT, 0644);
+  if (trava < 0)
+    return;
+  if (flock(trava, LOCK_EX) != 0)
+  {
+    close(trava);
+    return;
+  }
+
+  if (pread(trava, &estimativa, sizeof(estimativa), 0) == (ssize_t)sizeof(estimativa) &&
+      estimativa + acrescimo <= max_bytes)
+  {
+    grava_estimativa(trava, estimativa + acrescimo, 1);
+    goto fim;
+  }
+
+  d = opendir(dir);
+  if (!d)
+    goto fim;
+
+  while ((item = readdir(d)) != NULL)
+  {
+    size_t len = strlen(item->d_name);
+    if (len >= sizeof(entradas->nome) || len <= strlen(CACHE_SUFIXO) ||
+        strcmp(item->d_name + len - strlen(CACHE_SUFIXO), CACHE_SUFIXO) != 0)
+      continue;
+
+    snprintf(arquivo, sizeof(arquivo), "%s/%s", dir, item->d_name);
+    if (stat(arquivo, &info) != 0)
+      continue;
+
+    if (n == capacidade)
+    {
+      InfoEntrada *novo;
+      capacidade = capacidade ? capacidade * 2 : 256;
+      novo = (InfoEntrada *)pather_realloc(entradas, capacidade * sizeof(InfoEntrada));
+      if (!novo)
+      {
+        completa = 0;
+        break;
+      }
+      entradas = novo;
+    }
+
+    strcpy(entradas[n].nome, item->d_name);
+    entradas[n].tamanho = info.st_size;
+    entradas[n].uso = info.st_mtim;
+    total += info.st_size;
+    n++;
+  }
+  closedir(d);
+
+  if ((size_t)total > max_bytes)
+  {
+    qsort(entradas, n, sizeof(InfoEntrada), compara_uso);
+    for (size_t i = 0; i < n && (size_t)total > max_bytes; i++)
+    {
+      snprintf(arquivo, sizeof(arquivo), "%s/%s", dir, entradas[i].nome);
+      if (unlink(arquivo) == 0)
+        total -= entradas[i].tamanho;
+    }
+  }
+
+  /* Sem a lista inteira, o total é parcial */
+  grava_estimativa(trava, (uint64_t)total, completa);
+
+fim:
+  pather_free(entradas);
+  flock(trava, LOCK_UN);
+  close(trava);
+}
+
+/**
+ * Cache Store
+ *
+ * Escreve a entrada em um arquivo temporário único (`mkstemp`, sem o
+ * sufixo das entradas) e a publica com rename, de forma que leitores
+ * nunca vejam uma entrada pela metade, nem duas threads escrevam no
+ * mesmo temporário. Depois, aplica o limite de tamanho do cache.
+ *
+ * @return 1 se a entrada foi gravada, 0 do contrário
+ */
+int cache_store(const char *dir, size_t max_bytes, uint64_t chave, Coordenada *caminho, int n, long custo)
+{
+  char temporario[4096], arquivo[4096];
+  EntradaCache entrada;
+  unsigned char *dados;
+  size_t tamanho = path_encoded_size(n, CODEC_CHECKSUM);
+  int fd, ok;
+
+  if (!tamanho)
+    return 0;
+
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+    return 0;
+
+  entrada.magico = CACHE_MAGICO;
+  entrada.versao = CACHE_VERSAO;
+  entrada.chave = chave;
+
+  /* Um caminho que não é 4-conexo não tem como ser codificado */
+  dados = (unsigned char *)pather_malloc(tamanho);
+  if (!dados || !path_encode(caminho, n, custo, CODEC_CHECKSUM, dados))
+  {
+    pather_free(dados);
+    return 0;
+  }
+
+  ok = snprintf(temporario, sizeof(temporario), "%s/%016llx.XXXXXX", dir,
+                (unsigned long long)chave) < (int)sizeof(temporario);
+  if (!ok || !nome_entrada(arquivo, sizeof(arquivo), dir, chave) ||
+      (fd = mkstemp(temporario)) < 0)
+  {
+    pather_free(dados);
+    return 0;
+  }
+  fchmod(fd, 0644);
+
+  ok = escreve_tudo(fd, &entrada, sizeof(entrada)) && escreve_tudo(fd, dados, tamanho);
+  ok = close(fd) == 0 && ok;
+  pather_free(dados);
+
+  if (!ok || rename(temporario, arquivo) != 0)
+  {
+    unlink(temporario);
+    return 0;
+  }
+
+  if (max_bytes)
+    cache_evict(dir, max_bytes, sizeof(entrada) + tamanho);
+  return 1;
+}
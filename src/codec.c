@@ -0,0 +1,187 @@
+/**
+ * Delta Path Codec
+ *
+ * Passos de 2 bits: 0 direita, 1 baixo, 2 esquerda, 3 cima. A tabela
+ * `DESLOCAMENTOS` é montada por macro na compilação: para cada byte de
+ * passos, o deslocamento acumulado de cada uma das suas 4 coordenadas
+ * em relação à coordenada anterior ao byte. Assim as 4 escritas de um
+ * byte não dependem umas das outras.
+ */
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+
+/* File Header */
+#include <pather/codec.h>
+#include <pather/hash.h>
+
+#define CODEC_MAGICO     0x44485450u /* "PTHD" */
+#define CODEC_CABECALHO  28
+
+/* Deslocamento do passo `j` do byte `b` */
+#define PASSO_X(b, j) ((((b) >> (2 * (j))) & 3) == 0 ? 1 : (((b) >> (2 * (j))) & 3) == 2 ? -1 : 0)
+#define PASSO_Y(b, j) ((((b) >> (2 * (j))) & 3) == 1 ? 1 : (((b) >> (2 * (j))) & 3) == 3 ? -1 : 0)
+
+#define DESLOCAMENTO(b)                                                              \
+  { { PASSO_X(b, 0), PASSO_Y(b, 0) },                                                \
+    { PASSO_X(b, 0) + PASSO_X(b, 1), PASSO_Y(b, 0) + PASSO_Y(b, 1) },                \
+    { PASSO_X(b, 0) + PASSO_X(b, 1) + PASSO_X(b, 2),                                 \
+      PASSO_Y(b, 0) + PASSO_Y(b, 1) + PASSO_Y(b, 2) },                               \
+    { PASSO_X(b, 0) + PASSO_X(b, 1) + PASSO_X(b, 2) + PASSO_X(b, 3),                 \
+      PASSO_Y(b, 0) + PASSO_Y(b, 1) + PASSO_Y(b, 2) + PASSO_Y(b, 3) } }
+
+#define DESLOCAMENTO_4(b)  DESLOCAMENTO(b), DESLOCAMENTO(b + 1), DESLOCAMENTO(b + 2), DESLOCAMENTO(b + 3)
+#define DESLOCAMENTO_16(b) DESLOCAMENTO_4(b), DESLOCAMENTO_4(b + 4), DESLOCAMENTO_4(b + 8), DESLOCAMENTO_4(b + 12)
+#define DESLOCAMENTO_64(b) DESLOCAMENTO_16(b), DESLOCAMENTO_16(b + 16), DESLOCAMENTO_16(b + 32), DESLOCAMENTO_16(b + 48)
+
+static const int8_t DESLOCAMENTOS[256][4][2] = {
+  DESLOCAMENTO_64(0), DESLOCAMENTO_64(64), DESLOCAMENTO_64(128), DESLOCAMENTO_64(192)
+};
+
+/* Código do passo (dx + 1, dy + 1), ou -1 se não é um passo 4-conexo */
+static const int8_t CODIGOS[3][3] = {
+  { -1, 2, -1 },
+  { 3, -1, 1 },
+  { -1, 0, -1 },
+};
+
+/**
+ * Little Endian Fields
+ */
+static void escreve32(unsigned char *p, uint32_t v)
+{
+  p[0] = (unsigned char)v;
+  p[1] = (unsigned char)(v >> 8);
+  p[2] = (unsigned char)(v >> 16);
+  p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t le32(const unsigned char *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * Encoded Size
+ *
+ * @return bytes do caminho codificado, ou 0 se `n` não é positivo
+ */
+size_t path_encoded_size(int n, int flags)
+{
+  if (n <= 0)
+    return 0;
+  return CODEC_CABECALHO + ((size_t)n + 2) / 4 + ((flags & CODEC_CHECKSUM) ? 4 : 0);
+}
+
+/**
+ * Encode a Path
+ *
+ * `destino` precisa de `path_encoded_size(n, flags)` bytes.
+ *
+ * @return bytes escritos, ou 0 se o caminho está vazio ou tem um passo
+ *         que não é para um vizinho-4
+ */
+size_t path_encode(const Coordenada *caminho, int n, long custo, int flags, unsigned char *destino)
+{
+  size_t tamanho = path_encoded_size(n, flags);
+  unsigned char *p = destino + CODEC_CABECALHO;
+
+  if (!tamanho)
+    return 0;
+
+  escreve32(destino, CODEC_MAGICO);
+  escreve32(destino + 4, (uint32_t)(flags & CODEC_CHECKSUM));
+  escreve32(destino + 8, (uint32_t)n);
+  escreve32(destino + 12, (uint32_t)caminho[0].x);
+  escreve32(destino + 16, (uint32_t)caminho[0].y);
+  escreve32(destino + 20, (uint32_t)(uint64_t)(int64_t)custo);
+  escreve32(destino + 24, (uint32_t)((uint64_t)(int64_t)custo >> 32));
+
+  for (int i = 1; i < n; i += 4)
+  {
+    int fim = n - i < 4 ? n : i + 4;
+    unsigned int byte = 0;
+
+    for (int j = i; j < fim; j++)
+    {
+      unsigned int dx = (unsigned int)(caminho[j].x - caminho[j - 1].x + 1);
+      unsigned int dy = (unsigned int)(caminho[j].y - caminho[j - 1].y + 1);
+
+      if (dx > 2 || dy > 2 || CODIGOS[dx][dy] < 0)
+        return 0;
+      byte |= (unsigned int)CODIGOS[dx][dy] << (2 * (j - i));
+    }
+    *p++ = (unsigned char)byte;
+  }
+
+  if (flags & CODEC_CHECKSUM)
+    escreve32(p, (uint32_t)hash_bytes(destino, (size_t)(p - destino), 0));
+
+  return tamanho;
+}
+
+/**
+ * Decode a Path
+ *
+ * O caminho retornado deve ser liberado com free().
+ *
+ * @return número de coordenadas, ou -1 se os dados não são um caminho
+ *         codificado válido (ou o checksum não confere)
+ */
+int path_decode(const unsigned char *dados, size_t tamanho, Coordenada **caminho, long *custo)
+{
+  const unsigned char *p = dados + CODEC_CABECALHO;
+  uint32_t flags, n, i;
+  Coordenada *c;
+  int x, y;
+
+  *caminho = NULL;
+  if (tamanho < CODEC_CABECALHO || le32(dados) != CODEC_MAGICO)
+    return -1;
+
+  flags = le32(dados + 4);
+  n = le32(dados + 8);
+  if ((flags & ~(uint32_t)CODEC_CHECKSUM) || n == 0 || n > INT_MAX ||
+      path_encoded_size((int)n, (int)flags) != tamanho)
+    return -1;
+  if ((flags & CODEC_CHECKSUM) && le32(dados + tamanho - 4) != (uint32_t)hash_bytes(dados, tamanho - 4, 0))
+    return -1;
+
+  c = (Coordenada *)malloc((size_t)n * sizeof(Coordenada));
+  if (!c)
+    return -1;
+
+  x = c[0].x = (int32_t)le32(dados + 12);
+  y = c[0].y = (int32_t)le32(dados + 16);
+
+  /* Bytes cheios: 4 coordenadas por consulta à tabela */
+  for (i = 1; i + 4 <= n; i += 4, p++)
+  {
+    const int8_t (*d)[2] = DESLOCAMENTOS[*p];
+
+    c[i].x = x + d[0][0];
+    c[i].y = y + d[0][1];
+    c[i + 1].x = x + d[1][0];
+    c[i + 1].y = y + d[1][1];
+    c[i + 2].x = x + d[2][0];
+    c[i + 2].y = y + d[2][1];
+    c[i + 3].x = x + d[3][0];
+    c[i + 3].y = y + d[3][1];
+    x += d[3][0];
+    y += d[3][1];
+  }
+
+  /* Último byte, com menos de 4 passos */
+  for (int k = 0; i < n; i++, k++)
+  {
+    c[i].x = x + DESLOCAMENTOS[*p][k][0];
+    c[i].y = y + DESLOCAMENTOS[*p][k][1];
+  }
+
+  *caminho = c;
+  if (custo)
+    *custo = (long)(int64_t)((uint64_t)le32(dados + 20) | (uint64_t)le32(dados + 24) << 32);
+  return (int)n;
+}
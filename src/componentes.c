@@ -0,0 +1,300 @@
+/**
+ * Connected Components
+ *
+ * Union-find em blocos de linhas. O vetor de rótulos é a própria
+ * floresta: cada pixel do primeiro plano guarda índice + 1 do seu pai,
+ * e toda ligação aponta para um índice menor, então a raiz de cada
+ * árvore é o primeiro pixel do componente na ordem de varredura.
+ *
+ * 1. Cada thread rotula uma faixa de linhas sem olhar para fora dela,
+ *    então as faixas não disputam nada.
+ * 2. As fronteiras entre faixas são unidas em seguida.
+ * 3. Uma varredura em ordem troca os índices por rótulos densos e
+ *    acumula caixa e contagem: como os pais vêm antes dos filhos, o
+ *    rótulo final do pai já está pronto quando o filho é visitado.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <string.h>
+
+/* File Header */
+#include <pather/componentes.h>
+#include <pather/alloc.h>
+#include <pather/paralelo.h>
+
+/**
+ * Labeling Band
+ */
+typedef struct
+{
+  ImagemBinaria *bin;
+  uint32_t *rotulos;
+  unsigned long y0, y1;
+} FaixaCCL;
+
+static int bit(const ImagemBinaria *bin, unsigned long x, unsigned long y)
+{
+  return (bin->dados[y * bin->palavras + x / 64] >> (x % 64)) & 1;
+}
+
+/**
+ * Find with Path Halving
+ *
+ * @return índice da raiz
+ */
+static uint32_t raiz(uint32_t *rotulos, uint32_t i)
+{
+  while (rotulos[i] != i + 1)
+  {
+    uint32_t pai = rotulos[i] - 1;
+    rotulos[i] = rotulos[pai];
+    i = rotulos[i] - 1;
+  }
+  return i;
+}
+
+/**
+ * Union
+ *
+ * A raiz de maior índice passa a apontar para a de menor.
+ */
+static void une(uint32_t *rotulos, uint32_t a, uint32_t b)
+{
+  a = raiz(rotulos, a);
+  b = raiz(rotulos, b);
+  if (a < b)
+    rotulos[b] = a + 1;
+  else if (b < a)
+    rotulos[a] = b + 1;
+}
+
+/**
+ * Label One Band
+ *
+ * Percorre só os bits ligados de cada palavra.
+ */
+static void *rotula_faixa(void *arg)
+{
+  FaixaCCL *faixa = (FaixaCCL *)arg;
+  ImagemBinaria *bin = faixa->bin;
+  uint32_t *rotulos = faixa->rotulos;
+  const unsigned long w = bin->largura;
+
+  for (unsigned long y = faixa->y0; y < faixa->y1; y++)
+  {
+    const uint64_t *linha = bin->dados + y * bin->palavras;
+
+    memset(rotulos + y * w, 0, w * sizeof(uint32_t));
+
+    for (unsigned long p = 0; p < bin->palavras; p++)
+    {
+      uint64_t bits = linha[p];
+      while (bits)
+      {
+        unsigned long x = p * 64 + (unsigned long)__builtin_ctzll(bits);
+        uint32_t i = (uint32_t)(y * w + x);
+        int esquerda = x > 0 && bit(bin, x - 1, y);
+        int acima = y > faixa->y0 && bit(bin, x, y - 1);
+
+        bits &= bits - 1;
+
+        if (esquerda)
+        {
+          rotulos[i] = i;
+          if (acima)
+            une(rotulos, i - 1, (uint32_t)(i - w));
+        }
+        else if (acima)
+          rotulos[i] = (uint32_t)(i - w + 1);
+        else
+          rotulos[i] = i + 1;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Label Connected Components
+ *
+ * @param  bin       imagem binária (primeiro plano = bit 1)
+ * @param  n_threads threads a usar; 0 usa um por processador
+ * @return           a rotulagem, ou NULL se faltar memória
+ */
+Rotulagem *ccl_label(ImagemBinaria *bin, int n_threads)
+{
+  const unsigned long w = bin->largura, h = bin->altura;
+  FaixaCCL faixas[PATHER_MAX_THREADS];
+  int n_faixas;
+  unsigned long capacidade = 0;
+  Rotulagem *rot;
+
+  if ((unsigned long long)w * h >= UINT32_MAX)
+    return NULL;
+
+  rot = (Rotulagem *)pather_malloc(sizeof(Rotulagem));
+  if (!rot)
+    return NULL;
+  rot->largura = w;
+  rot->altura = h;
+  rot->componentes = NULL;
+  rot->n = 0;
+  rot->rotulos = (uint32_t *)pather_malloc(w * h * sizeof(uint32_t));
+  if (!rot->rotulos)
+  {
+    pather_free(rot);
+    return NULL;
+  }
+
+  /* 1. Faixas independentes */
+  n_faixas = parallel_threads(n_threads, h);
+
+  for (int f = 0; f < n_faixas; f++)
+  {
+    faixas[f].bin = bin;
+    faixas[f].rotulos = rot->rotulos;
+    faixas[f].y0 = h * f / n_faixas;
+    faixas[f].y1 = h * (f + 1) / n_faixas;
+  }
+
+  parallel_run(rotula_faixa, faixas, sizeof(FaixaCCL), n_faixas);
+
+  /* 2. Fronteiras entre faixas */
+  for (int f = 1; f < n_faixas; f++)
+  {
+    unsigned long y = faixas[f].y0;
+    const uint64_t *linha = bin->dados + y * bin->palavras;
+    const uint64_t *anterior = linha - bin->palavras;
+
+    for (unsigned long p = 0; p < bin->palavras; p++)
+    {
+      uint64_t bits = linha[p] & anterior[p];
+      while (bits)
+      {
+        unsigned long x = p * 64 + (unsigned long)__builtin_ctzll(bits);
+        bits &= bits - 1;
+        une(rot->rotulos, (uint32_t)(y * w + x), (uint32_t)((y - 1) * w + x));
+      }
+    }
+  }
+
+  /* 3. Rótulos densos e estatísticas */
+  for (unsigned long y = 0; y < h; y++)
+    for (unsigned long x = 0; x < w; x++)
+    {
+      uint32_t i = (uint32_t)(y * w + x);
+      uint32_t pai = rot->rotulos[i];
+      Componente *c;
+
+      if (pai == 0)
+        continue;
+
+      if (pai == i + 1)
+      {
+        if (rot->n == capacidade)
+        {
+          Componente *novo;
+          capacidade = capacidade ? capacidade * 2 : 256;
+          novo = (Componente *)pather_realloc(rot->componentes, capacidade * sizeof(Componente));
+          if (!novo)
+          {
+            ccl_destroy(rot);
+            return NULL;
+          }
+          rot->componentes = novo;
+        }
+
+        rot->rotulos[i] = ++rot->n;
+        c = &rot->componentes[rot->n - 1];
+        c->x0 = c->x1 = x;
+        c->y0 = c->y1 = y;
+        c->pixels = 0;
+      }
+      else
+        rot->rotulos[i] = rot->rotulos[pai - 1];
+
+      c = &rot->componentes[rot->rotulos[i] - 1];
+      if (x < c->x0) c->x0 = x;
+      if (x > c->x1) c->x1 = x;
+      c->y1 = y;
+      c->pixels++;
+    }
+
+  return rot;
+}
+
+void ccl_destroy(Rotulagem *rot)
+{
+  if (!rot)
+    return;
+
+  pather_free(rot->componentes);
+  pather_free(rot->rotulos);
+  pather_free(rot);
+}
+
+/**
+ * Remove Small Components
+ *
+ * Pinta de fundo, em `bin` e nos rótulos, os componentes com menos de
+ * `min_pixels` pixels. Eles continuam na lista, com 0 pixels.
+ */
+void ccl_remove_small(Rotulagem *rot, ImagemBinaria *bin, unsigned long min_pixels)
+{
+  for (unsigned long y = 0; y < rot->altura; y++)
+    for (unsigned long x = 0; x < rot->largura; x++)
+    {
+      uint32_t *r = &rot->rotulos[y * rot->largura + x];
+      if (*r && rot->componentes[*r - 1].pixels < min_pixels)
+      {
+        bin->dados[y * bin->palavras + x / 64] &= ~((uint64_t)1 << (x % 64));
+        *r = 0;
+      }
+    }
+
+  for (uint32_t k = 0; k < rot->n; k++)
+    if (rot->componentes[k].pixels < min_pixels)
+      rot->componentes[k].pixels = 0;
+}
+
+/**
+ * Mask of Spanning Components
+ *
+ * Componentes que tocam as colunas da esquerda e da direita. Por serem
+ * conexos, cada um deles contém um caminho válido de uma borda à outra.
+ *
+ * @return a máscara, ou NULL se nenhum componente atravessa a imagem
+ *         (ou se faltar memória)
+ */
+ImagemBinaria *ccl_spanning_mask(Rotulagem *rot)
+{
+  ImagemBinaria *mascara;
+  uint8_t *atravessa;
+  int algum = 0;
+
+  atravessa = (uint8_t *)pather_malloc(rot->n + 1);
+  if (!atravessa)
+    return NULL;
+
+  atravessa[0] = 0;
+  for (uint32_t k = 1; k <= rot->n; k++)
+  {
+    const Componente *c = &rot->componentes[k - 1];
+    atravessa[k] = c->pixels > 0 && c->x0 == 0 && c->x1 == rot->largura - 1;
+    algum |= atravessa[k];
+  }
+
+  mascara = algum ? bin_create(rot->largura, rot->altura) : NULL;
+  if (mascara)
+    for (unsigned long y = 0; y < rot->altura; y++)
+      for (unsigned long x = 0; x < rot->largura; x++)
+        if (atravessa[rot->rotulos[y * rot->largura + x]])
+          mascara->dados[y * mascara->palavras + x / 64] |= (uint64_t)1 << (x % 64);
+
+  pather_free(atravessa);
+  return mascara;
+}
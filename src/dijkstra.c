@@ -0,0 +1,599 @@
+/**
+ * Shortest Path Solver
+ *
+ * Dijkstra com heap binária sobre os pixels da imagem. O custo de
+ * entrar em um pixel é o seu nível de cinza + 1, de forma que pixels
+ * escuros (a linha) são baratos e o comprimento do caminho também
+ * conta.
+ *
+ * A memória de trabalho é de 5 bytes por pixel (distância + direção
+ * do predecessor) mais a heap, toda alocada pelo `pather_malloc`; um
+ * espaço de trabalho reaproveitável soma 4 bytes por pixel de época,
+ * e o layout em blocos, 1 byte por pixel da cópia do mapa de custo.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* File Header */
+#include <pather/dijkstra.h>
+#include <pather/alloc.h>
+#include <pather/heap.h>
+#include <pather/paralelo.h>
+#include <pather/trace.h>
+
+/**
+ * Query Batch
+ *
+ * Estado compartilhado pelas threads do `dijkstra_queries`; cada
+ * thread pega a próxima consulta com um contador atômico.
+ */
+typedef struct
+{
+  Imagem1C *custo;
+  ImagemBinaria *mascara;
+  ConsultaCaminho *consultas;
+  int n_consultas;
+  const PatherConfig *config;
+  const uint8_t *mapa;   /* Mapa de custo em blocos, só lido pelas threads */
+  int proximo;
+} LoteConsultas;
+
+/**
+ * Mask Test
+ */
+static int permitido(const ImagemBinaria *mascara, uint32_t x, uint32_t y)
+{
+  return !mascara || ((mascara->dados[y * mascara->palavras + x / 64] >> (x % 64)) & 1);
+}
+
+/**
+ * Grid Position
+ *
+ * Posição do pixel (x, y), de índice `no` = y * largura + x, nas grades
+ * do espaço de trabalho. No layout em blocos, o número do bloco vem nos
+ * bits altos e a posição dentro dele nos 2 * BLOCO_LOG2 bits baixos.
+ */
+static uint32_t posicao(const TrabalhoDijkstra *t, uint32_t no, uint32_t x, uint32_t y)
+{
+  if (!t->blocos)
+    return no;
+  return ((y >> BLOCO_LOG2) * t->blocos + (x >> BLOCO_LOG2)) << (2 * BLOCO_LOG2) |
+         (y & (LADO_BLOCO - 1)) << BLOCO_LOG2 | (x & (LADO_BLOCO - 1));
+}
+
+/**
+ * Predecessor Index
+ *
+ * Converte a direção guardada em `pred` no índice do pixel anterior.
+ */
+static int64_t predecessor(const TrabalhoDijkstra *t, uint32_t no, uint32_t largura)
+{
+  uint32_t y = no / largura;
+
+  switch (t->pred[posicao(t, no, no - y * largura, y)])
+  {
+    case PRED_ESQUERDA: return (int64_t)no - 1;
+    case PRED_DIREITA:  return (int64_t)no + 1;
+    case PRED_ACIMA:    return (int64_t)no - largura;
+    case PRED_ABAIXO:   return (int64_t)no + largura;
+    default:            return -1;
+  }
+}
+
+/**
+ * Shortest Path between the Left and Right Columns
+ *
+ * Todos os pixels da coluna da esquerda são origens; a busca termina
+ * quando o primeiro pixel da coluna da direita é assentado. O caminho
+ * retornado é alocado aqui e deve ser liberado pelo chamador.
+ *
+ * @param  custo   imagem usada como mapa de custo
+ * @param  caminho saída: sequência de coordenadas vizinhas-4
+ * @param  total   saída opcional: custo acumulado do caminho
+ *
+ * @return         número de coordenadas, -1 se não há caminho, ou
+ *                 PATHER_SEM_MEMORIA se a memória de trabalho não couber
+ *                 no orçamento
+ */
+int dijkstra_path(Imagem1C *custo, Coordenada **caminho, long *total)
+{
+  return dijkstra_path_mask(custo, NULL, caminho, total);
+}
+
+/**
+ * Masked Shortest Path
+ *
+ * Como o `dijkstra_path`, mas só visita os pixels com o bit ligado em
+ * `mascara` (NULL libera todos). Pixels fora da máscara nunca entram
+ * na heap.
+ */
+int dijkstra_path_mask(Imagem1C *custo, ImagemBinaria *mascara, Coordenada **caminho, long *total)
+{
+  PatherConfig config;
+
+  pather_config_default(&config);
+  return dijkstra_path_config(custo, mascara, &config, caminho, total);
+}
+
+/**
+ * Masked Shortest Path with Grid Options
+ *
+ * Como o `dijkstra_path_mask`, com as grades no layout e nas páginas
+ * pedidos em `config->layout` e `config->huge_pages`.
+ */
+int dijkstra_path_config(Imagem1C *custo, ImagemBinaria *mascara, const PatherConfig *config,
+                         Coordenada **caminho, long *total)
+{
+  TrabalhoDijkstra *trabalho;
+  int n;
+
+  *caminho = NULL;
+  trabalho = dijkstra_workspace_grid(custo->largura, custo->altura, 0, config->layout, config->huge_pages);
+  if (!trabalho)
+    return PATHER_SEM_MEMORIA;
+
+  n = dijkstra_path_ws(trabalho, custo, mascara, caminho, total);
+  dijkstra_workspace_destroy(trabalho);
+  return n;
+}
+
+/**
+ * Solver Workspace
+ *
+ * Guarda distância, predecessor e heap entre buscas. Com `reutilizavel`,
+ * cada pixel ganha também a época da busca que escreveu a sua distância
+ * (mais 4 bytes por pixel): uma distância de época antiga vale infinito,
+ * então começar uma nova busca não precisa percorrer a imagem toda e o
+ * custo de cada busca fica proporcional aos pixels que ela visita.
+ *
+ * @param  n_pixels     número de pixels das imagens a resolver
+ * @param  reutilizavel 1 para usar épocas, 0 para uma busca só
+ * @return              o espaço de trabalho, ou NULL se faltar memória
+ */
+TrabalhoDijkstra *dijkstra_workspace(uint32_t n_pixels, int reutilizavel)
+{
+  TrabalhoDijkstra *trabalho = dijkstra_workspace_grid(n_pixels, 1, reutilizavel, PATHER_LAYOUT_ROWS, 0);
+
+  /* Sem a largura, o tamanho da imagem só é conferido por n_pixels */
+  if (trabalho)
+    trabalho->largura = trabalho->altura = 0;
+  return trabalho;
+}
+
+/**
+ * Grid Geometry
+ *
+ * Preenche o tamanho e o número de blocos das grades no layout pedido.
+ */
+static void geometria(TrabalhoDijkstra *t, uint32_t largura, uint32_t altura, PatherLayout layout)
+{
+  t->largura = largura;
+  t->altura = altura;
+  t->blocos = 0;
+  t->n_pixels = largura * altura;
+  if (layout == PATHER_LAYOUT_TILES)
+  {
+    t->blocos = (largura + LADO_BLOCO - 1) >> BLOCO_LOG2;
+    t->n_pixels = t->blocos * (((altura + LADO_BLOCO - 1) >> BLOCO_LOG2) << (2 * BLOCO_LOG2));
+  }
+}
+
+/**
+ * Solver Workspace for a Grid
+ *
+ * Como o `dijkstra_workspace`, para imagens de `largura` x `altura`
+ * pixels, com as grades no layout pedido. Com `huge_pages`, as grades
+ * grandes pedem páginas enormes transparentes (`pather_malloc_huge`).
+ *
+ * @return o espaço de trabalho, ou NULL se faltar memória
+ */
+TrabalhoDijkstra *dijkstra_workspace_grid(uint32_t largura, uint32_t altura, int reutilizavel,
+                                          PatherLayout layout, int huge_pages)
+{
+  void *(*aloca)(size_t) = huge_pages ? pather_malloc_huge : pather_malloc;
+  TrabalhoDijkstra *trabalho = (TrabalhoDijkstra *)pather_malloc(sizeof(TrabalhoDijkstra));
+  uint32_t n_pixels;
+  if (!trabalho)
+    return NULL;
+
+  geometria(trabalho, largura, altura, layout);
+  n_pixels = trabalho->n_pixels;
+  trabalho->huge_pages = huge_pages;
+  trabalho->custo = NULL;
+  trabalho->custo_proprio = NULL;
+  trabalho->custo_origem = NULL;
+  trabalho->epoca_atual = 0;
+  trabalho->assentados = 0;
+  trabalho->heap.itens = NULL;
+  trabalho->heap.tamanho = trabalho->heap.capacidade = 0;
+  trabalho->dist = (uint32_t *)aloca(n_pixels * sizeof(uint32_t));
+  trabalho->pred = (uint8_t *)aloca(n_pixels * sizeof(uint8_t));
+  trabalho->epoca = reutilizavel ? (uint32_t *)aloca(n_pixels * sizeof(uint32_t)) : NULL;
+  if (!trabalho->dist || !trabalho->pred || (reutilizavel && !trabalho->epoca))
+  {
+    dijkstra_workspace_destroy(trabalho);
+    return NULL;
+  }
+
+  if (trabalho->epoca)
+    memset(trabalho->epoca, 0, n_pixels * sizeof(uint32_t));
+  return trabalho;
+}
+
+void dijkstra_workspace_destroy(TrabalhoDijkstra *trabalho)
+{
+  if (!trabalho)
+    return;
+
+  pather_free(trabalho->heap.itens);
+  pather_free(trabalho->custo_proprio);
+  pather_free(trabalho->epoca);
+  pather_free(trabalho->pred);
+  pather_free(trabalho->dist);
+  pather_free(trabalho);
+}
+
+/**
+ * Invalidate the Tiled Cost Copy
+ *
+ * Faz a próxima busca recopiar o mapa de custo para os blocos. É
+ * obrigatório depois de mudar os pixels da imagem de custo no lugar,
+ * já que a cópia só é refeita sozinha quando a imagem passada muda.
+ */
+void dijkstra_workspace_invalidate(TrabalhoDijkstra *trabalho)
+{
+  trabalho->custo_origem = NULL;
+}
+
+/**
+ * Distance in the Current Search
+ *
+ * `i` é a posição do pixel nas grades (`posicao`).
+ */
+static uint32_t distancia(const TrabalhoDijkstra *t, uint32_t i)
+{
+  return t->epoca && t->epoca[i] != t->epoca_atual ? UINT32_MAX : t->dist[i];
+}
+
+static void relaxa(TrabalhoDijkstra *t, uint32_t i, uint32_t d, uint8_t direcao)
+{
+  t->dist[i] = d;
+  t->pred[i] = direcao;
+  if (t->epoca)
+    t->epoca[i] = t->epoca_atual;
+}
+
+/**
+ * Cost of Entering a Pixel
+ */
+static uint32_t peso(const TrabalhoDijkstra *t, const Imagem1C *custo, uint32_t i, uint32_t x, uint32_t y)
+{
+  return (t->custo ? t->custo[i] : custo->dados[y][x]) + 1u;
+}
+
+/**
+ * Copy the Cost Map into Tiles
+ *
+ * Cada pedaço de linha dentro de um bloco é contíguo nas duas imagens.
+ */
+static void copia_custo(const TrabalhoDijkstra *t, const Imagem1C *custo, uint8_t *destino)
+{
+  for (uint32_t y = 0; y < t->altura; y++)
+    for (uint32_t x = 0; x < t->largura; x += LADO_BLOCO)
+      memcpy(destino + posicao(t, 0, x, y), custo->dados[y] + x,
+             t->largura - x < LADO_BLOCO ? t->largura - x : LADO_BLOCO);
+}
+
+/**
+ * Tiled Cost Map of a Search
+ *
+ * No layout em blocos, garante que `t->custo` tem o mapa de `custo`:
+ * um mapa compartilhado é usado como está; senão a cópia própria é
+ * alocada na primeira busca e só é refeita se a imagem mudar ou se o
+ * espaço de trabalho foi invalidado.
+ *
+ * @return 0 se faltar memória para a cópia
+ */
+static int prepara_custo(TrabalhoDijkstra *t, const Imagem1C *custo)
+{
+  if (!t->blocos || (t->custo && t->custo != t->custo_proprio) || t->custo_origem == custo)
+    return 1;
+
+  if (!t->custo_proprio)
+    t->custo_proprio = (uint8_t *)(t->huge_pages ? pather_malloc_huge : pather_malloc)(t->n_pixels);
+  if (!t->custo_proprio)
+    return 0;
+
+  copia_custo(t, custo, t->custo_proprio);
+  t->custo = t->custo_proprio;
+  t->custo_origem = custo;
+  return 1;
+}
+
+static int compara_indice(const void *a, const void *b)
+{
+  uint32_t ia = *(const uint32_t *)a, ib = *(const uint32_t *)b;
+  return ia < ib ? -1 : ia > ib;
+}
+
+/**
+ * Shortest Path with a Workspace
+ *
+ * A busca do `dijkstra_path_mask` sobre um espaço de trabalho do
+ * `dijkstra_workspace`, que pode ser reaproveitado entre chamadas com
+ * imagens do mesmo tamanho.
+ */
+int dijkstra_path_ws(TrabalhoDijkstra *t, Imagem1C *custo, ImagemBinaria *mascara, Coordenada **caminho, long *total)
+{
+  return dijkstra_query_ws(t, custo, mascara, NULL, 0, NULL, 0, caminho, total);
+}
+
+/**
+ * Shortest Path between Point Sets
+ *
+ * Como o `dijkstra_path_ws`, mas com origens e destinos explícitos. Sem
+ * origens, valem os pixels da coluna da esquerda; sem destinos, os da
+ * coluna da direita. Pontos fora da imagem ou da máscara são ignorados.
+ * Os destinos são ordenados por índice e procurados por busca binária
+ * quando um pixel é assentado.
+ *
+ * @return número de coordenadas, -1 se nenhum destino é alcançável, ou
+ *         PATHER_SEM_MEMORIA se faltar memória
+ */
+int dijkstra_query_ws(TrabalhoDijkstra *t, Imagem1C *custo, ImagemBinaria *mascara,
+                      const Coordenada *origens, int n_origens, const Coordenada *destinos, int n_destinos,
+                      Coordenada **caminho, long *total)
+{
+  uint32_t largura = custo->largura, altura = custo->altura;
+  uint32_t n_pixels = largura * altura;
+  uint32_t *alvos = NULL;
+  size_t n_alvos = 0;
+  int64_t alvo = -1;
+  uint64_t empilhados = 0, assentados = 0, pico = 0;
+  int n = -1;
+
+  *caminho = NULL;
+  t->assentados = 0;
+  if (n_pixels == 0 || (t->largura ? largura != t->largura || altura != t->altura : n_pixels != t->n_pixels))
+    return -1;
+  if (!prepara_custo(t, custo))
+    return PATHER_SEM_MEMORIA;
+
+  if (destinos && n_destinos > 0)
+  {
+    alvos = (uint32_t *)pather_malloc((size_t)n_destinos * sizeof(uint32_t));
+    if (!alvos)
+      return PATHER_SEM_MEMORIA;
+    for (int i = 0; i < n_destinos; i++)
+      if ((uint32_t)destinos[i].x < largura && (uint32_t)destinos[i].y < altura)
+        alvos[n_alvos++] = (uint32_t)destinos[i].y * largura + (uint32_t)destinos[i].x;
+    qsort(alvos, n_alvos, sizeof(uint32_t), compara_indice);
+  }
+
+  /* Nova época; na volta do contador, as épocas antigas são zeradas */
+  t->heap.tamanho = 0;
+  if (t->epoca)
+  {
+    if (++t->epoca_atual == 0)
+    {
+      memset(t->epoca, 0, t->n_pixels * sizeof(uint32_t));
+      t->epoca_atual = 1;
+    }
+  }
+  else
+    for (uint32_t i = 0; i < t->n_pixels; i++)
+    {
+      t->dist[i] = UINT32_MAX;
+      t->pred[i] = PRED_NENHUM;
+    }
+
+  /* Origens: as pedidas, ou a coluna da esquerda inteira */
+  for (uint32_t i = 0; i < (origens && n_origens > 0 ? (uint32_t)n_origens : altura); i++)
+  {
+    uint32_t x = origens && n_origens > 0 ? (uint32_t)origens[i].x : 0;
+    uint32_t y = origens && n_origens > 0 ? (uint32_t)origens[i].y : i;
+    uint32_t no = y * largura + x;
+    uint32_t i_no;
+
+    if (x >= largura || y >= altura || !permitido(mascara, x, y))
+      continue;
+    i_no = posicao(t, no, x, y);
+    if (peso(t, custo, i_no, x, y) >= distancia(t, i_no))
+      continue;
+    relaxa(t, i_no, peso(t, custo, i_no, x, y), PRED_NENHUM);
+    if (!heap_push(&t->heap, t->dist[i_no], no))
+    {
+      pather_free(alvos);
+      return PATHER_SEM_MEMORIA;
+    }
+    empilhados++;
+  }
+
+  while (t->heap.tamanho > 0)
+  {
+    uint64_t item;
+    uint32_t no, d, x, y;
+    uint32_t vizinhos[4], vx[4], vy[4];
+    uint8_t direcoes[4];
+    int n_vizinhos = 0;
+
+    if (t->heap.tamanho > pico)
+      pico = t->heap.tamanho;
+
+    item = heap_pop(&t->heap);
+    no = (uint32_t)item;
+    d = (uint32_t)(item >> 32);
+    y = no / largura;
+    x = no - y * largura;
+    if (d > distancia(t, posicao(t, no, x, y)))
+      continue;
+    assentados++;
+
+    if (alvos ? bsearch(&no, alvos, n_alvos, sizeof(uint32_t), compara_indice) != NULL : x == largura - 1)
+    {
+      alvo = no;
+      break;
+    }
+
+    /* A direção registrada aponta do vizinho de volta para `no` */
+#define VIZINHO(u, ux, uy, direcao) \
+    (vizinhos[n_vizinhos] = (u), vx[n_vizinhos] = (ux), vy[n_vizinhos] = (uy), direcoes[n_vizinhos++] = (direcao))
+    if (x > 0)           VIZINHO(no - 1, x - 1, y, PRED_DIREITA);
+    if (x < largura - 1) VIZINHO(no + 1, x + 1, y, PRED_ESQUERDA);
+    if (y > 0)           VIZINHO(no - largura, x, y - 1, PRED_ABAIXO);
+    if (y < altura - 1)  VIZINHO(no + largura, x, y + 1, PRED_ACIMA);
+#undef VIZINHO
+
+    for (int v = 0; v < n_vizinhos; v++)
+    {
+      uint32_t u = vizinhos[v];
+      uint32_t i_u, nd;
+      if (!permitido(mascara, vx[v], vy[v]))
+        continue;
+      i_u = posicao(t, u, vx[v], vy[v]);
+      nd = d + peso(t, custo, i_u, vx[v], vy[v]);
+      if (nd < distancia(t, i_u))
+      {
+        relaxa(t, i_u, nd, direcoes[v]);
+        if (!heap_push(&t->heap, nd, u))
+        {
+          pather_free(alvos);
+          return PATHER_SEM_MEMORIA;
+        }
+        empilhados++;
+      }
+    }
+  }
+
+  pather_free(alvos);
+  t->assentados = assentados;
+  TRACE_ADD(TRACE_NODES_PUSHED, empilhados);
+  TRACE_ADD(TRACE_NODES_SETTLED, assentados);
+  TRACE_MAX(TRACE_QUEUE_PEAK, pico);
+  TRACE_BYTES(assentados * 4 * (1 + sizeof(uint32_t) + sizeof(uint8_t)) + empilhados * sizeof(uint64_t));
+
+  if (alvo < 0)
+    return -1;
+
+  /* Reconstrói o caminho seguindo os predecessores */
+  n = 0;
+  for (int64_t no = alvo; no >= 0; no = predecessor(t, no, largura))
+    n++;
+
+  /* O caminho é devolvido ao chamador, que o libera com free() */
+  *caminho = (Coordenada *)malloc(n * sizeof(Coordenada));
+  if (!*caminho)
+    return PATHER_SEM_MEMORIA;
+  TRACE_ALLOC(n * sizeof(Coordenada));
+
+  int c = n;
+  for (int64_t no = alvo; no >= 0; no = predecessor(t, no, largura))
+  {
+    c--;
+    (*caminho)[c].x = (int)(no % largura);
+    (*caminho)[c].y = (int)(no / largura);
+  }
+
+  if (total)
+    *total = t->dist[posicao(t, (uint32_t)alvo, (uint32_t)(alvo % largura), (uint32_t)(alvo / largura))];
+  return n;
+}
+
+/**
+ * Query Batch Worker
+ *
+ * Cada thread tem o seu espaço de trabalho reaproveitável (só `dist`,
+ * `pred` e `epoca`; o mapa em blocos é o do lote), então uma consulta
+ * só paga pelos pixels que visita.
+ */
+static void *resolve_lote(void *arg)
+{
+  LoteConsultas *lote = (LoteConsultas *)arg;
+  TrabalhoDijkstra *trabalho = NULL;
+  int i;
+
+  while ((i = __sync_fetch_and_add(&lote->proximo, 1)) < lote->n_consultas)
+  {
+    ConsultaCaminho *consulta = &lote->consultas[i];
+
+    consulta->n = PATHER_SEM_MEMORIA;
+    if (!trabalho)
+    {
+      trabalho = dijkstra_workspace_grid(lote->custo->largura, lote->custo->altura, 1,
+                                         lote->config->layout, lote->config->huge_pages);
+      if (!trabalho)
+        continue;
+      trabalho->custo = lote->mapa;
+    }
+
+    consulta->n = dijkstra_query_ws(trabalho, lote->custo, lote->mascara,
+                                    consulta->origens, consulta->n_origens,
+                                    consulta->destinos, consulta->n_destinos,
+                                    &consulta->caminho, &consulta->custo);
+  }
+
+  dijkstra_workspace_destroy(trabalho);
+  return NULL;
+}
+
+/**
+ * Answer Many Queries on One Cost Map
+ *
+ * Resolve as consultas em paralelo sobre o mesmo mapa de custo (e a
+ * mesma máscara), que só é lido. No layout em blocos, a cópia em
+ * blocos do mapa é feita uma vez aqui e dividida entre as threads.
+ * Uma consulta sem memória para o espaço de trabalho fica com
+ * n = PATHER_SEM_MEMORIA.
+ *
+ * @param  custo       mapa de custo compartilhado
+ * @param  mascara     pixels permitidos, ou NULL
+ * @param  consultas   as consultas; `caminho`, `n` e `custo` são preenchidos
+ * @param  n_consultas número de consultas
+ * @param  config      `n_threads` (0 usa um por processador) e o layout
+ *                     das grades de cada thread
+ * @return             número de consultas com caminho
+ */
+int dijkstra_queries(Imagem1C *custo, ImagemBinaria *mascara, ConsultaCaminho *consultas, int n_consultas,
+                     const PatherConfig *config)
+{
+  LoteConsultas lote = { custo, mascara, consultas, n_consultas, config, NULL, 0 };
+  uint8_t *mapa = NULL;
+  int resolvidas = 0;
+
+  if (n_consultas <= 0)
+    return 0;
+
+  if (config->layout == PATHER_LAYOUT_TILES)
+  {
+    TrabalhoDijkstra grade;
+
+    geometria(&grade, custo->largura, custo->altura, config->layout);
+    mapa = (uint8_t *)(config->huge_pages ? pather_malloc_huge : pather_malloc)(grade.n_pixels);
+    if (!mapa)
+    {
+      for (int i = 0; i < n_consultas; i++)
+      {
+        consultas[i].caminho = NULL;
+        consultas[i].n = PATHER_SEM_MEMORIA;
+      }
+      return 0;
+    }
+    copia_custo(&grade, custo, mapa);
+    lote.mapa = mapa;
+  }
+
+  /* Todas as threads tiram consultas do mesmo lote */
+  parallel_run(resolve_lote, &lote, 0, parallel_threads(config->n_threads, (unsigned long)n_consultas));
+  pather_free(mapa);
+
+  for (int i = 0; i < n_consultas; i++)
+    if (consultas[i].n > 0)
+      resolvidas++;
+  return resolvidas;
+}
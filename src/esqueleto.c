@@ -0,0 +1,600 @@
+/**
+ * Skeleton Graph
+ *
+ * A vizinhança-8 de um pixel vira um índice de 8 bits (bit k = vizinho
+ * k, no sentido horário a partir do norte, como P2..P9 no artigo de
+ * Zhang e Suen), então cada teste do afinamento é uma consulta a uma
+ * tabela de 256 posições. Só os bits ligados de cada palavra são
+ * visitados.
+ *
+ * Cada subiteração lê uma imagem e escreve a outra, de forma que as
+ * faixas de linhas podem ser processadas por threads independentes.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* File Header */
+#include <pather/esqueleto.h>
+#include <pather/alloc.h>
+#include <pather/heap.h>
+#include <pather/paralelo.h>
+#include <pather/trace.h>
+
+/* Deslocamento do vizinho k: N, NE, L, SE, S, SO, O, NO */
+static const int DX[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int DY[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+
+/**
+ * Work Range
+ */
+typedef struct
+{
+  const ImagemBinaria *src;
+  ImagemBinaria *dst;
+  const uint64_t *zeros;   /* Linha vazia para fora da imagem */
+  const uint8_t *tabela;
+  unsigned long inicio, fim;
+  unsigned long removidos;
+} TarefaEsqueleto;
+
+/**
+ * Three Bits of a Row
+ *
+ * Os pixels x - 1, x e x + 1 da linha nos bits 0, 1 e 2 (fora da
+ * imagem conta como fundo).
+ */
+static unsigned tres_bits(const uint64_t *linha, unsigned long largura, unsigned long x)
+{
+  unsigned r = (unsigned)((linha[x / 64] >> (x % 64)) & 1) << 1;
+
+  if (x > 0)
+    r |= (unsigned)((linha[(x - 1) / 64] >> ((x - 1) % 64)) & 1);
+  if (x + 1 < largura)
+    r |= (unsigned)((linha[(x + 1) / 64] >> ((x + 1) % 64)) & 1) << 2;
+  return r;
+}
+
+/**
+ * Neighbourhood Index
+ *
+ * Monta o índice de 8 bits a partir das linhas de cima, do pixel e de
+ * baixo.
+ */
+static unsigned indice(const uint64_t *cima, const uint64_t *meio, const uint64_t *baixo,
+                       unsigned long largura, unsigned long x)
+{
+  unsigned a = tres_bits(cima, largura, x);
+  unsigned m = tres_bits(meio, largura, x);
+  unsigned b = tres_bits(baixo, largura, x);
+
+  return ((a >> 1) & 1) | ((a >> 2) & 1) << 1 | ((m >> 2) & 1) << 2 | ((b >> 2) & 1) << 3 |
+         ((b >> 1) & 1) << 4 | (b & 1) << 5 | (m & 1) << 6 | (a & 1) << 7;
+}
+
+static unsigned vizinhanca(const ImagemBinaria *bin, const uint64_t *zeros, unsigned long x, unsigned long y)
+{
+  const uint64_t *meio = bin->dados + y * bin->palavras;
+  const uint64_t *cima = y > 0 ? meio - bin->palavras : zeros;
+  const uint64_t *baixo = y + 1 < bin->altura ? meio + bin->palavras : zeros;
+
+  return indice(cima, meio, baixo, bin->largura, x);
+}
+
+/**
+ * Zhang–Suen Tables
+ *
+ * Um pixel sai na subiteração s se tem de 2 a 6 vizinhos, exatamente
+ * uma transição fundo → primeiro plano na volta P2..P9, P2, e se
+ * P2·P4·P6 = P4·P6·P8 = 0 (s = 0) ou P2·P4·P8 = P2·P6·P8 = 0 (s = 1).
+ */
+static void monta_tabelas(uint8_t tabelas[2][256])
+{
+  for (int i = 0; i < 256; i++)
+  {
+    int p[8], vizinhos = 0, transicoes = 0, base;
+
+    for (int k = 0; k < 8; k++)
+    {
+      p[k] = (i >> k) & 1;
+      vizinhos += p[k];
+    }
+    for (int k = 0; k < 8; k++)
+      transicoes += !p[k] && p[(k + 1) % 8];
+
+    base = vizinhos >= 2 && vizinhos <= 6 && transicoes == 1;
+    tabelas[0][i] = (uint8_t)(base && !(p[0] && p[2] && p[4]) && !(p[2] && p[4] && p[6]));
+    tabelas[1][i] = (uint8_t)(base && !(p[0] && p[2] && p[6]) && !(p[0] && p[4] && p[6]));
+  }
+}
+
+/**
+ * Thinning: One Band of One Sub-iteration
+ */
+static void *afina_faixa(void *arg)
+{
+  TarefaEsqueleto *t = (TarefaEsqueleto *)arg;
+  const unsigned long palavras = t->src->palavras, altura = t->src->altura;
+
+  for (unsigned long y = t->inicio; y < t->fim; y++)
+  {
+    const uint64_t *meio = t->src->dados + y * palavras;
+    const uint64_t *cima = y > 0 ? meio - palavras : t->zeros;
+    const uint64_t *baixo = y + 1 < altura ? meio + palavras : t->zeros;
+    uint64_t *saida = t->dst->dados + y * palavras;
+
+    memcpy(saida, meio, palavras * sizeof(uint64_t));
+    for (unsigned long p = 0; p < palavras; p++)
+    {
+      uint64_t bits = meio[p];
+      while (bits)
+      {
+        unsigned b = (unsigned)__builtin_ctzll(bits);
+        bits &= bits - 1;
+
+        if (t->tabela[indice(cima, meio, baixo, t->src->largura, p * 64 + b)])
+        {
+          saida[p] &= ~((uint64_t)1 << b);
+          t->removidos++;
+        }
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Run over Bands
+ *
+ * Divide as linhas entre as threads; a thread atual fica com as faixas
+ * que não ganharam thread.
+ */
+static void paralelo(TarefaEsqueleto *modelo, unsigned long total, int n_threads, void *(*funcao)(void *))
+{
+  TarefaEsqueleto tarefas[PATHER_MAX_THREADS];
+
+  n_threads = parallel_threads(n_threads, total);
+  for (int t = 0; t < n_threads; t++)
+  {
+    tarefas[t] = *modelo;
+    tarefas[t].inicio = total * t / n_threads;
+    tarefas[t].fim = total * (t + 1) / n_threads;
+    tarefas[t].removidos = 0;
+  }
+
+  parallel_run(funcao, tarefas, sizeof(TarefaEsqueleto), n_threads);
+
+  modelo->removidos = 0;
+  for (int t = 0; t < n_threads; t++)
+    modelo->removidos += tarefas[t].removidos;
+}
+
+/**
+ * Zhang–Suen Thinning
+ *
+ * Afina o primeiro plano de `bin` no lugar, até uma passada completa
+ * não remover nenhum pixel. O resultado é conexo-8 e tem um pixel de
+ * largura (salvo alguns degraus nas diagonais).
+ *
+ * @param  bin       imagem binária, substituída pelo esqueleto
+ * @param  n_threads threads a usar (0 = uma por núcleo)
+ * @return           número de passadas, ou -1 se faltar memória
+ */
+int bin_thin(ImagemBinaria *bin, int n_threads)
+{
+  uint8_t tabelas[2][256];
+  ImagemBinaria *outra, *src, *dst;
+  uint64_t *zeros;
+  TarefaEsqueleto modelo;
+  unsigned long removidos;
+  int passadas = 0;
+
+  if (bin->largura == 0 || bin->altura == 0)
+    return 0;
+
+  outra = bin_create(bin->largura, bin->altura);
+  zeros = (uint64_t *)pather_malloc(bin->palavras * sizeof(uint64_t));
+  if (!outra || !zeros)
+  {
+    bin_destroy(outra);
+    pather_free(zeros);
+    return -1;
+  }
+  memset(zeros, 0, bin->palavras * sizeof(uint64_t));
+  monta_tabelas(tabelas);
+
+  /* Duas trocas por passada: ao sair, o resultado está de volta em `bin` */
+  src = bin;
+  dst = outra;
+  do
+  {
+    removidos = 0;
+    for (int s = 0; s < 2; s++)
+    {
+      ImagemBinaria *troca;
+
+      modelo.src = src;
+      modelo.dst = dst;
+      modelo.zeros = zeros;
+      modelo.tabela = tabelas[s];
+      paralelo(&modelo, bin->altura, n_threads, afina_faixa);
+      removidos += modelo.removidos;
+
+      troca = src;
+      src = dst;
+      dst = troca;
+    }
+    passadas++;
+  } while (removidos > 0);
+
+  bin_destroy(outra);
+  pather_free(zeros);
+  return passadas;
+}
+
+/*============================================================================*/
+
+/**
+ * Node Test
+ *
+ * Um pixel do esqueleto é nó se não tem exatamente dois vizinhos ou se
+ * está em uma das colunas da borda (origens e destinos da busca).
+ */
+static int eh_no(const ImagemBinaria *esq, const uint64_t *zeros, unsigned long x, unsigned long y)
+{
+  return x == 0 || x + 1 == esq->largura ||
+         __builtin_popcount(vizinhanca(esq, zeros, x, y)) != 2;
+}
+
+static uint32_t custo_pixel(const Imagem1C *custo, unsigned long x, unsigned long y)
+{
+  return (uint32_t)custo->dados[y][x] + 1;
+}
+
+/**
+ * Walk a Branch
+ *
+ * Segue a cadeia de pixels que sai do nó `origem` pelo vizinho
+ * `direcao` até o próximo nó. Soma em `peso` o custo de cada pixel
+ * depois da origem e conta em `passos` as coordenadas do ramo já
+ * expandido em vizinhança-4; se `saida` não for NULL, escreve-as lá.
+ *
+ * @return índice do pixel do nó de chegada
+ */
+static uint32_t percorre(const ImagemBinaria *esq, const Imagem1C *custo, const uint64_t *zeros,
+                         uint32_t origem, int direcao, uint64_t *peso, uint32_t *passos, Coordenada *saida)
+{
+  const unsigned long largura = esq->largura;
+  unsigned long px = origem % largura, py = origem / largura;
+  unsigned long x = px + DX[direcao], y = py + DY[direcao];
+
+  *peso = 0;
+  *passos = 0;
+  for (;;)
+  {
+    unsigned vizinhos;
+    int k;
+
+    /* Passo diagonal: entra antes pelo canto mais barato */
+    if (x != px && y != py)
+    {
+      unsigned long cx = x, cy = py;
+      if (custo->dados[y][px] < custo->dados[py][x])
+      {
+        cx = px;
+        cy = y;
+      }
+      *peso += custo_pixel(custo, cx, cy);
+      if (saida)
+      {
+        saida[*passos].x = (int)cx;
+        saida[*passos].y = (int)cy;
+      }
+      (*passos)++;
+    }
+
+    *peso += custo_pixel(custo, x, y);
+    if (saida)
+    {
+      saida[*passos].x = (int)x;
+      saida[*passos].y = (int)y;
+    }
+    (*passos)++;
+
+    if (eh_no(esq, zeros, x, y))
+      return (uint32_t)(y * largura + x);
+
+    /* Pixel de passagem: dos dois vizinhos, segue o que não é o anterior */
+    vizinhos = vizinhanca(esq, zeros, x, y);
+    for (k = 0; k < 8; k++)
+      if (((vizinhos >> k) & 1) && (x + DX[k] != px || y + DY[k] != py))
+        break;
+    if (k == 8)
+      return (uint32_t)(y * largura + x);
+
+    px = x;
+    py = y;
+    x += DX[k];
+    y += DY[k];
+  }
+}
+
+static int compara_pixel(const void *a, const void *b)
+{
+  uint32_t pa = *(const uint32_t *)a, pb = *(const uint32_t *)b;
+  return pa < pb ? -1 : pa > pb;
+}
+
+/**
+ * Extract the Skeleton Graph
+ *
+ * Enumera os nós em ordem de varredura e, de cada nó, percorre os ramos
+ * que saem por cada um dos seus vizinhos. Cada ramo aparece uma vez em
+ * cada sentido. Ciclos sem nenhum nó ficam de fora.
+ *
+ * @param  esqueleto imagem afinada (`bin_thin`)
+ * @param  custo     mapa de custo com as dimensões do esqueleto
+ * @return           grafo, ou NULL se faltar memória
+ */
+GrafoEsqueleto *skeleton_graph(ImagemBinaria *esqueleto, Imagem1C *custo)
+{
+  const unsigned long largura = esqueleto->largura, palavras = esqueleto->palavras;
+  GrafoEsqueleto *grafo;
+  uint64_t *zeros;
+  uint32_t capacidade = 0;
+
+  grafo = (GrafoEsqueleto *)pather_malloc(sizeof(GrafoEsqueleto));
+  zeros = (uint64_t *)pather_malloc(palavras * sizeof(uint64_t));
+  if (!grafo || !zeros)
+  {
+    pather_free(grafo);
+    pather_free(zeros);
+    return NULL;
+  }
+  memset(zeros, 0, palavras * sizeof(uint64_t));
+  memset(grafo, 0, sizeof(GrafoEsqueleto));
+  grafo->largura = largura;
+  grafo->altura = esqueleto->altura;
+
+  /* Primeira varredura conta os nós, a segunda guarda os pixels */
+  for (int passada = 0; passada < 2; passada++)
+  {
+    uint32_t n = 0;
+
+    for (unsigned long y = 0; y < esqueleto->altura; y++)
+      for (unsigned long p = 0; p < palavras; p++)
+      {
+        uint64_t bits = esqueleto->dados[y * palavras + p];
+        while (bits)
+        {
+          unsigned long x = p * 64 + (unsigned long)__builtin_ctzll(bits);
+          bits &= bits - 1;
+          if (!eh_no(esqueleto, zeros, x, y))
+            continue;
+          if (passada == 1)
+            grafo->pixels[n] = (uint32_t)(y * largura + x);
+          n++;
+        }
+      }
+
+    if (passada == 0)
+    {
+      grafo->n_nos = n;
+      grafo->pixels = (uint32_t *)pather_malloc(((size_t)n + 1) * sizeof(uint32_t));
+      grafo->primeiro = (uint32_t *)pather_malloc(((size_t)n + 1) * sizeof(uint32_t));
+      if (!grafo->pixels || !grafo->primeiro)
+        goto erro;
+    }
+  }
+
+  for (uint32_t i = 0; i < grafo->n_nos; i++)
+  {
+    uint32_t pixel = grafo->pixels[i];
+    unsigned vizinhos = vizinhanca(esqueleto, zeros, pixel % largura, pixel / largura);
+
+    grafo->primeiro[i] = grafo->n_ramos;
+    for (int k = 0; k < 8; k++)
+    {
+      RamoEsqueleto *ramo;
+      uint32_t chegada, *no;
+      uint64_t peso;
+
+      if (!((vizinhos >> k) & 1))
+        continue;
+
+      if (grafo->n_ramos == capacidade)
+      {
+        RamoEsqueleto *novo;
+        capacidade = capacidade ? capacidade * 2 : 1024;
+        novo = (RamoEsqueleto *)pather_realloc(grafo->ramos, capacidade * sizeof(RamoEsqueleto));
+        if (!novo)
+          goto erro;
+        grafo->ramos = novo;
+      }
+
+      ramo = &grafo->ramos[grafo->n_ramos++];
+      chegada = percorre(esqueleto, custo, zeros, pixel, k, &peso, &ramo->passos, NULL);
+      no = (uint32_t *)bsearch(&chegada, grafo->pixels, grafo->n_nos, sizeof(uint32_t), compara_pixel);
+      ramo->destino = (uint32_t)(no - grafo->pixels);
+      ramo->peso = peso > UINT32_MAX ? UINT32_MAX : (uint32_t)peso;
+      ramo->direcao = (uint8_t)k;
+    }
+  }
+  grafo->primeiro[grafo->n_nos] = grafo->n_ramos;
+
+  pather_free(zeros);
+  return grafo;
+
+erro:
+  pather_free(zeros);
+  skeleton_graph_destroy(grafo);
+  return NULL;
+}
+
+void skeleton_graph_destroy(GrafoEsqueleto *grafo)
+{
+  if (!grafo)
+    return;
+
+  pather_free(grafo->pixels);
+  pather_free(grafo->primeiro);
+  pather_free(grafo->ramos);
+  pather_free(grafo);
+}
+
+/**
+ * Shortest Path on the Skeleton
+ *
+ * Dijkstra sobre o grafo: os nós da coluna da esquerda são origens e a
+ * busca termina no primeiro nó da coluna da direita assentado. O custo
+ * é o mesmo do `dijkstra_path` (nível de cinza + 1 por pixel) sobre o
+ * caminho expandido. O caminho retornado deve ser liberado com free().
+ *
+ * @param  grafo     grafo de `skeleton_graph`
+ * @param  esqueleto a mesma imagem afinada usada para montar o grafo
+ * @param  custo     o mesmo mapa de custo
+ * @param  caminho   saída: sequência de coordenadas vizinhas-4
+ * @param  total     saída opcional: custo acumulado do caminho
+ *
+ * @return           número de coordenadas, ou -1 se o esqueleto não liga
+ *                   as duas bordas ou se faltar memória
+ */
+int skeleton_path(GrafoEsqueleto *grafo, ImagemBinaria *esqueleto, Imagem1C *custo,
+                  Coordenada **caminho, long *total)
+{
+  const unsigned long largura = grafo->largura;
+  uint32_t *dist, *anterior, *ramo_de, *via = NULL;
+  Heap heap = { NULL, 0, 0 };
+  int64_t alvo = -1;
+  uint64_t empilhados = 0, assentados = 0;
+  uint64_t *zeros = NULL;
+  size_t n_coordenadas;
+  uint32_t n_ramos;
+  int n = -1;
+
+  *caminho = NULL;
+  if (grafo->n_nos == 0)
+    return -1;
+
+  dist = (uint32_t *)pather_malloc(grafo->n_nos * sizeof(uint32_t));
+  anterior = (uint32_t *)pather_malloc(grafo->n_nos * sizeof(uint32_t));
+  ramo_de = (uint32_t *)pather_malloc(grafo->n_nos * sizeof(uint32_t));
+  if (!dist || !anterior || !ramo_de)
+    goto fim;
+
+  for (uint32_t i = 0; i < grafo->n_nos; i++)
+  {
+    dist[i] = UINT32_MAX;
+    anterior[i] = UINT32_MAX;
+  }
+
+  for (uint32_t i = 0; i < grafo->n_nos; i++)
+  {
+    uint32_t pixel = grafo->pixels[i];
+    if (pixel % largura != 0)
+      continue;
+    dist[i] = custo_pixel(custo, 0, pixel / largura);
+    if (!heap_push(&heap, dist[i], i))
+      goto fim;
+    empilhados++;
+  }
+
+  while (heap.tamanho > 0)
+  {
+    uint64_t item = heap_pop(&heap);
+    uint32_t no = (uint32_t)item;
+    uint32_t d = (uint32_t)(item >> 32);
+
+    if (d > dist[no])
+      continue;
+    assentados++;
+
+    if (grafo->pixels[no] % largura == largura - 1)
+    {
+      alvo = no;
+      break;
+    }
+
+    for (uint32_t r = grafo->primeiro[no]; r < grafo->primeiro[no + 1]; r++)
+    {
+      const RamoEsqueleto *ramo = &grafo->ramos[r];
+      uint64_t nd = (uint64_t)d + ramo->peso;
+      if (nd < dist[ramo->destino])
+      {
+        dist[ramo->destino] = (uint32_t)nd;
+        anterior[ramo->destino] = no;
+        ramo_de[ramo->destino] = r;
+        if (!heap_push(&heap, (uint32_t)nd, ramo->destino))
+          goto fim;
+        empilhados++;
+      }
+    }
+  }
+
+  TRACE_ADD(TRACE_NODES_PUSHED, empilhados);
+  TRACE_ADD(TRACE_NODES_SETTLED, assentados);
+
+  if (alvo < 0)
+    goto fim;
+
+  n_ramos = 0;
+  n_coordenadas = 1;
+  for (uint32_t no = (uint32_t)alvo; anterior[no] != UINT32_MAX; no = anterior[no], n_ramos++)
+    n_coordenadas += grafo->ramos[ramo_de[no]].passos;
+
+  via = (uint32_t *)pather_malloc(((size_t)n_ramos + 1) * sizeof(uint32_t));
+  zeros = (uint64_t *)pather_malloc(esqueleto->palavras * sizeof(uint64_t));
+  *caminho = (Coordenada *)malloc(n_coordenadas * sizeof(Coordenada));
+  if (!via || !zeros || !*caminho)
+  {
+    free(*caminho);
+    *caminho = NULL;
+    goto fim;
+  }
+  TRACE_ALLOC(n_coordenadas * sizeof(Coordenada));
+  memset(zeros, 0, esqueleto->palavras * sizeof(uint64_t));
+
+  /* Ramos na ordem da origem para o destino; via[0] é o nó de partida */
+  {
+    uint32_t no = (uint32_t)alvo, c = n_ramos;
+    for (; anterior[no] != UINT32_MAX; no = anterior[no])
+      via[c--] = ramo_de[no];
+    via[0] = no;
+  }
+
+  {
+    uint32_t pixel = grafo->pixels[via[0]];
+    size_t pos = 1;
+
+    (*caminho)[0].x = (int)(pixel % largura);
+    (*caminho)[0].y = (int)(pixel / largura);
+    for (uint32_t c = 1; c <= n_ramos; c++)
+    {
+      const RamoEsqueleto *ramo = &grafo->ramos[via[c]];
+      uint64_t peso;
+      uint32_t passos;
+
+      percorre(esqueleto, custo, zeros, pixel, ramo->direcao, &peso, &passos, *caminho + pos);
+      pos += passos;
+      pixel = grafo->pixels[ramo->destino];
+    }
+  }
+
+  n = (int)n_coordenadas;
+  if (total)
+    *total = dist[alvo];
+
+fim:
+  pather_free(heap.itens);
+  pather_free(zeros);
+  pather_free(via);
+  pather_free(ramo_de);
+  pather_free(anterior);
+  pather_free(dist);
+  return n;
+}
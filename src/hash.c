@@ -0,0 +1,103 @@
+/**
+ * Fast Content Hash
+ *
+ * Quatro acumuladores independentes consomem blocos de 32 bytes (no
+ * estilo do xxHash64), o que mantém o hash limitado pela banda de
+ * memória e não pela latência das multiplicações.
+ */
+
+/* Standard Libraries */
+#include <string.h>
+
+/* File Header */
+#include <pather/hash.h>
+
+#define P1 0x9E3779B185EBCA87ull
+#define P2 0xC2B2AE3D27D4EB4Full
+#define P3 0x165667B19E3779F9ull
+#define P4 0x85EBCA77C2B2AE63ull
+
+static uint64_t rotl(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t le64(const unsigned char *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t rodada(uint64_t acc, uint64_t v)
+{
+  return rotl(acc + v * P2, 31) * P1;
+}
+
+/**
+ * Hash a Byte Buffer
+ *
+ * @param  dados   bytes a processar
+ * @param  n       número de bytes
+ * @param  semente valor inicial; encadeie chamadas passando o hash anterior
+ * @return         hash de 64 bits
+ */
+uint64_t hash_bytes(const void *dados, size_t n, uint64_t semente)
+{
+  const unsigned char *p = (const unsigned char *)dados;
+  const unsigned char *fim = p + n;
+  uint64_t h;
+
+  if (n >= 32)
+  {
+    uint64_t a = semente + P1 + P2, b = semente + P2, c = semente, d = semente - P1;
+
+    do
+    {
+      a = rodada(a, le64(p));
+      b = rodada(b, le64(p + 8));
+      c = rodada(c, le64(p + 16));
+      d = rodada(d, le64(p + 24));
+      p += 32;
+    } while (p + 32 <= fim);
+
+    h = rotl(a, 1) + rotl(b, 7) + rotl(c, 12) + rotl(d, 18);
+    h = (h ^ rodada(0, a)) * P1 + P4;
+    h = (h ^ rodada(0, b)) * P1 + P4;
+    h = (h ^ rodada(0, c)) * P1 + P4;
+    h = (h ^ rodada(0, d)) * P1 + P4;
+  }
+  else
+    h = semente + P3;
+
+  h += (uint64_t)n;
+
+  for (; p + 8 <= fim; p += 8)
+    h = rotl(h ^ rodada(0, le64(p)), 27) * P1 + P4;
+  for (; p < fim; p++)
+    h = rotl(h ^ (*p * P3), 11) * P1;
+
+  /* Avalanche final */
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+/**
+ * Hash of a Gray Image
+ *
+ * Combina as dimensões e todas as linhas da imagem.
+ */
+uint64_t hash_imagem1C(Imagem1C *img)
+{
+  uint64_t dimensoes[2] = { img->largura, img->altura };
+  uint64_t h = hash_bytes(dimensoes, sizeof(dimensoes), 0);
+
+  for (unsigned long y = 0; y < img->altura; y++)
+    h = hash_bytes(img->dados[y], img->largura, h);
+
+  return h;
+}
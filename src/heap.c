@@ -0,0 +1,66 @@
+/**
+ * Binary Heap
+ *
+ * A memória da heap cresce pelo `pather_realloc` e é liberada pelo
+ * dono com `pather_free(heap.itens)`.
+ */
+
+/* File Header */
+#include <pather/heap.h>
+#include <pather/alloc.h>
+
+/**
+ * Push
+ *
+ * @return 1 em caso de sucesso, 0 se faltar memória
+ */
+int heap_push(Heap *heap, uint32_t dist, uint32_t no)
+{
+  uint64_t item = ((uint64_t)dist << 32) | no;
+  size_t i;
+
+  if (heap->tamanho == heap->capacidade)
+  {
+    size_t capacidade = heap->capacidade ? heap->capacidade * 2 : 1024;
+    uint64_t *itens = (uint64_t *)pather_realloc(heap->itens, capacidade * sizeof(uint64_t));
+    if (!itens)
+      return 0;
+    heap->itens = itens;
+    heap->capacidade = capacidade;
+  }
+
+  /* Sift up */
+  i = heap->tamanho++;
+  while (i > 0 && heap->itens[(i - 1) / 2] > item)
+  {
+    heap->itens[i] = heap->itens[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  heap->itens[i] = item;
+  return 1;
+}
+
+/**
+ * Pop the Minimum
+ *
+ * A heap não pode estar vazia.
+ */
+uint64_t heap_pop(Heap *heap)
+{
+  uint64_t topo = heap->itens[0];
+  uint64_t ultimo = heap->itens[--heap->tamanho];
+  size_t i = 0, filho;
+
+  /* Sift down */
+  while ((filho = 2 * i + 1) < heap->tamanho)
+  {
+    if (filho + 1 < heap->tamanho && heap->itens[filho + 1] < heap->itens[filho])
+      filho++;
+    if (heap->itens[filho] >= ultimo)
+      break;
+    heap->itens[i] = heap->itens[filho];
+    i = filho;
+  }
+  heap->itens[i] = ultimo;
+  return topo;
+}
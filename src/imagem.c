@@ -10,11 +10,23 @@
  * aqui procuramos priorizar a clareza e a facilidade de uso. */
 /*============================================================================*/
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 #include <pather/imagem.h>
+#include <pather/alloc.h>
 
 /*============================================================================*/
 
@@ -22,14 +34,33 @@
 #define CANAL_G 1 /* Constante usada para se referir ao canal verde. */
 #define CANAL_B 2 /* Constante usada para se referir ao canal azul. */
 
+#define BYTES_PALETA (256*4) /* Paleta de 256 entradas BGRX. */
+
+/* Luma em ponto fixo: os pesos 0.299, 0.587 e 0.114 multiplicados por 2^16
+   (a soma d exatamente 2^16). Difere em no mximo 1 da conta em double. */
+#define LUMA(r,g,b) ((unsigned char) (((r) * 19595u + (g) * 38470u + (b) * 7471u) >> 16))
+
 unsigned long getLittleEndianULong (unsigned char* buffer);
+FILE* abreBMP (char* arquivo, unsigned long* largura, unsigned long* altura, int* bpp, unsigned char paleta [256][4]);
 int leHeaderBitmap (FILE* stream, unsigned long* offset);
-int leHeaderDIB (FILE* stream, unsigned long* largura, unsigned long* altura);
-int leDados (FILE* stream, Imagem3C* img);
-
-int salvaHeaderBitmap (FILE* stream, Imagem3C* img);
-int salvaHeaderDIB (FILE* stream, Imagem3C* img);
-int salvaDados (FILE* stream, Imagem3C* img);
+int leHeaderDIB (FILE* stream, unsigned long* largura, unsigned long* altura, int* bpp, unsigned long* cores, unsigned long* tamanho);
+int lePaleta (FILE* stream, unsigned long cores, unsigned char paleta [256][4]);
+int pulaBytes (FILE* stream, unsigned long n);
+unsigned long bytesPorLinha (unsigned long largura, int bpp);
+int leDados (FILE* stream, Imagem3C* img, int bpp, unsigned char paleta [256][4]);
+int leDados1C (FILE* stream, Imagem1C* img, int bpp, unsigned char paleta [256][4]);
+FILE* abreRegiaoBMP (char* arquivo, unsigned long x0, unsigned long y0, unsigned long* largura, unsigned long* altura, int* bpp, unsigned char paleta [256][4], unsigned long* offset, unsigned long* largura_linha);
+int leDadosRegiao (FILE* stream, Imagem1C* img1c, Imagem3C* img3c, int bpp, unsigned char paleta [256][4], unsigned long offset, unsigned long largura_linha, unsigned long passo_x0);
+int leDadosReduzidos (FILE* stream, Imagem1C* img, unsigned long largura, unsigned long altura, int bpp, unsigned char paleta [256][4], int fator, int modo);
+
+int salvaBMP (char* arquivo, Imagem1C* img1c, Imagem3C* img3c);
+int escreveTudo (int fd, unsigned char* buffer, unsigned long tamanho);
+void salvaHeaderBitmap (unsigned char* data, unsigned long largura, unsigned long altura, int bpp);
+void salvaHeaderDIB (unsigned char* data, unsigned long largura, unsigned long altura, int bpp);
+void salvaPaletaCinza (unsigned char* data);
+void salvaDados (unsigned char* data, Imagem3C* img);
+void salvaDados1C (unsigned char* data, Imagem1C* img);
+void intercalaLinhaBGR (unsigned char* destino, unsigned char* r, unsigned char* g, unsigned char* b, unsigned long largura);
 void putLittleEndianULong (unsigned long val, unsigned char* buffer);
 void putLittleEndianUShort (unsigned short val, unsigned char* buffer);
 
@@ -49,14 +80,27 @@ Imagem1C* criaImagem1C (int largura, int altura)
 	int i;
 	Imagem1C* img;
 
-	img = (Imagem1C*) malloc (sizeof (Imagem1C));
+	img = (Imagem1C*) pather_malloc (sizeof (Imagem1C));
+	if (!img)
+		return (NULL);
 
 	img->largura = largura;
-	img->altura = altura;
+	img->altura = 0;
 
-    img->dados = (unsigned char**) malloc (sizeof (unsigned char*) * altura);
-    for (i = 0; i < altura; i++)
-        img->dados [i] = (unsigned char*) malloc (sizeof (unsigned char) * largura);
+    img->dados = (unsigned char**) pather_malloc (sizeof (unsigned char*) * altura);
+    if (!img->dados)
+    {
+        pather_free (img);
+        return (NULL);
+    }
+
+    /* Se faltar memria no meio do caminho, destri o que j foi alocado. */
+    for (i = 0; i < altura; i++, img->altura++)
+        if (!(img->dados [i] = (unsigned char*) pather_malloc (sizeof (unsigned char) * largura)))
+        {
+            destroiImagem1C (img);
+            return (NULL);
+        }
 
 	return (img);
 }
@@ -73,9 +117,9 @@ void destroiImagem1C (Imagem1C* img)
 	unsigned long i;
 
     for (i = 0; i < img->altura; i++)
-        free (img->dados [i]);
-	free (img->dados);
-	free (img);
+        pather_free (img->dados [i]);
+	pather_free (img->dados);
+	pather_free (img);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -88,56 +132,235 @@ void destroiImagem1C (Imagem1C* img)
 
 Imagem1C* abreImagem1C (char* arquivo)
 {
-    int i, j;
-    Imagem3C* img3c;
-    Imagem1C* img1c;
-
-    /* Abre o arquivo como uma imagem de 3 canais. */
-    img3c = abreImagem3C (arquivo);
-    if (!img3c)
+    FILE* stream;
+    unsigned long largura = 0, altura = 0;
+    int bpp = 0;
+    unsigned char paleta [256][4];
+    Imagem1C* img;
+
+    stream = abreBMP (arquivo, &largura, &altura, &bpp, paleta);
+    if (!stream)
         return (NULL);
 
-    /* Converte a imagem de 3 canais para grayscale. Usamos aqui os mesmos
-       fatores de converso do OpenCV, que mantm certas propriedades de
-       percepo. */
-    img1c = criaImagem1C (img3c->largura, img3c->altura);
-    for (i = 0; i < img3c->altura; i++)
-        for (j = 0; j < img3c->largura; j++)
-            img1c->dados [i][j] = (unsigned char) (img3c->dados [CANAL_R][i][j] * 0.299 + img3c->dados [CANAL_G][i][j] * 0.587 + img3c->dados [CANAL_B][i][j] * 0.114);
+    img = criaImagem1C (largura, altura);
+    if (!img)
+    {
+        fprintf (stderr, "Error: not enough memory for a %lux%lu image.\n", largura, altura);
+        fclose (stream);
+        return (NULL);
+    }
+
+    /* L os dados direto em escala de cinza, sem passar por uma imagem de
+       3 canais. */
+    if (!leDados1C (stream, img, bpp, paleta))
+    {
+        fprintf (stderr, "Error reading data from file.\n");
+        fclose (stream);
+        destroiImagem1C (img);
+        return (NULL);
+    }
 
-    destroiImagem3C (img3c);
-    return (img1c);
+    fclose (stream);
+    return (img);
 }
 
+/*----------------------------------------------------------------------------*/
+/** L uma imagem BMP de um fluxo j aberto, que pode ser a entrada padro ou
+ * um pipe: tudo  lido s para a frente, e cada linha  convertida para cinza
+ * assim que chega, sem esperar pelo resto do arquivo. O fluxo no  fechado.
+ *
+ * Parmetros: FILE* stream: fluxo a ler, posicionado no incio do arquivo.
+ *
+ * Valor de retorno: uma imagem alocada contendo os dados lidos, ou NULL se no
+ *                   for possvel ler a imagem. */
+
+Imagem1C* leImagem1C (FILE* stream)
+{
+    unsigned long largura = 0, altura = 0;
+    unsigned long data_offset = 0, cores = 0, tamanho_dib = 0, lidos;
+    int bpp = 0;
+    unsigned char paleta [256][4];
+    Imagem1C* img;
+
+    if (!leHeaderBitmap (stream, &data_offset) ||
+        !leHeaderDIB (stream, &largura, &altura, &bpp, &cores, &tamanho_dib))
+        return (NULL);
+
+    lidos = 14 + tamanho_dib;
+    if (bpp == 8)
+    {
+        if (!lePaleta (stream, cores, paleta))
+            return (NULL);
+        lidos += 4 * cores;
+    }
+
+    /* Num pipe no d para voltar: os dados precisam vir depois de tudo o
+       que j foi lido, e o que houver no meio  descartado. */
+    if (data_offset < lidos || !pulaBytes (stream, data_offset - lidos))
+    {
+        fprintf (stderr, "Error reading file data.\n");
+        return (NULL);
+    }
+
+    img = criaImagem1C (largura, altura);
+    if (!img)
+    {
+        fprintf (stderr, "Error: not enough memory for a %lux%lu image.\n", largura, altura);
+        return (NULL);
+    }
+
+    if (!leDados1C (stream, img, bpp, paleta))
+    {
+        fprintf (stderr, "Error reading data from file.\n");
+        destroiImagem1C (img);
+        return (NULL);
+    }
+
+    return (img);
+}
 
 /*----------------------------------------------------------------------------*/
-/** Salva uma imagem em um arquivo dado.
+/** L uma imagem em escala de cinza crua de um fluxo j aberto: largura x
+ * altura bytes, uma linha depois da outra, de cima para baixo e sem padding.
+ * O fluxo no  fechado.
  *
- * Parmetros: Imagem1C* img: imagem a salvar.
- *             char* arquivo: caminho do arquivo a salvar.
+ * Parmetros: FILE* stream: fluxo a ler.
+ *             unsigned long largura, altura: tamanho da imagem.
  *
- * Valor de retorno: 0 se ocorreu algum erro, 1 do contrrio. */
+ * Valor de retorno: uma imagem alocada contendo os dados lidos, ou NULL se no
+ *                   for possvel ler a imagem. */
 
-int salvaImagem1C (Imagem1C* img, char* arquivo)
+Imagem1C* leImagem1CBruta (FILE* stream, unsigned long largura, unsigned long altura)
 {
-    int i, j, ok;
+    unsigned long i;
+    Imagem1C* img;
 
-    /* Cria e salva uma imagem de 3 canais. */
-    Imagem3C* img3c;
-    img3c = criaImagem3C (img->largura, img->altura);
+    if (largura == 0 || altura == 0)
+        return (NULL);
 
-    for (i = 0; i < img->altura; i++)
-        for (j = 0; j < img->largura; j++)
+    img = criaImagem1C (largura, altura);
+    if (!img)
+    {
+        fprintf (stderr, "Error: not enough memory for a %lux%lu image.\n", largura, altura);
+        return (NULL);
+    }
+
+    for (i = 0; i < altura; i++)
+        if (fread ((void*) img->dados [i], 1, largura, stream) != largura)
         {
-            img3c->dados [0][i][j] = img->dados [i][j];
-            img3c->dados [1][i][j] = img->dados [i][j];
-            img3c->dados [2][i][j] = img->dados [i][j];
+            fprintf (stderr, "Error reading data from file.\n");
+            destroiImagem1C (img);
+            return (NULL);
         }
 
-    ok = salvaImagem3C (img3c, arquivo);
-    destroiImagem3C (img3c);
+    return (img);
+}
+
+/*----------------------------------------------------------------------------*/
+/** Abre s uma regio retangular de um arquivo de imagem.
+ *
+ * Parmetros: char* arquivo: caminho do arquivo a abrir.
+ *             unsigned long x0, y0: canto superior esquerdo da regio.
+ *             unsigned long largura, altura: tamanho da regio;  recortado
+ *               aos limites da imagem.
+ *
+ * Valor de retorno: uma imagem alocada com os dados da regio, ou NULL se no
+ *                   for possvel abrir a imagem ou se a regio estiver vazia. */
 
-    return (ok);
+Imagem1C* abreImagem1CRegiao (char* arquivo, unsigned long x0, unsigned long y0, unsigned long largura, unsigned long altura)
+{
+    FILE* stream;
+    int bpp = 0;
+    unsigned long offset = 0, largura_linha = 0;
+    unsigned char paleta [256][4];
+    Imagem1C* img;
+
+    stream = abreRegiaoBMP (arquivo, x0, y0, &largura, &altura, &bpp, paleta, &offset, &largura_linha);
+    if (!stream)
+        return (NULL);
+
+    img = criaImagem1C (largura, altura);
+    if (!img)
+    {
+        fprintf (stderr, "Error: not enough memory for a %lux%lu image.\n", largura, altura);
+        fclose (stream);
+        return (NULL);
+    }
+
+    if (!leDadosRegiao (stream, img, NULL, bpp, paleta, offset, largura_linha, x0 * (bpp / 8)))
+    {
+        fprintf (stderr, "Error reading data from file.\n");
+        fclose (stream);
+        destroiImagem1C (img);
+        return (NULL);
+    }
+
+    fclose (stream);
+    return (img);
+}
+
+/*----------------------------------------------------------------------------*/
+/** Abre um arquivo de imagem j reduzido por um fator, para prvias e buscas
+ * grosseiras. A imagem em resoluo cheia nunca  montada: cada linha lida 
+ * convertida para cinza e acumulada na linha reduzida correspondente.
+ *
+ * Parmetros: char* arquivo: caminho do arquivo a abrir.
+ *             int fator: fator de reduo (2, 4 ou 8, por exemplo). As bordas
+ *               que no completam um bloco viram pixels de blocos menores.
+ *             int modo: REDUCAO_MEDIA ou REDUCAO_MINIMO.
+ *
+ * Valor de retorno: uma imagem alocada com
+ *                   ceil (largura / fator) x ceil (altura / fator) pixels, ou
+ *                   NULL se no for possvel abrir a imagem. */
+
+Imagem1C* abreImagem1CReduzida (char* arquivo, int fator, int modo)
+{
+    FILE* stream;
+    unsigned long largura = 0, altura = 0;
+    int bpp = 0;
+    unsigned char paleta [256][4];
+    Imagem1C* img;
+
+    if (fator < 1)
+        return (NULL);
+
+    stream = abreBMP (arquivo, &largura, &altura, &bpp, paleta);
+    if (!stream)
+        return (NULL);
+
+    img = criaImagem1C ((largura + fator - 1) / fator, (altura + fator - 1) / fator);
+    if (!img)
+    {
+        fprintf (stderr, "Error: not enough memory for a %lux%lu image.\n", largura / fator, altura / fator);
+        fclose (stream);
+        return (NULL);
+    }
+
+    if (!leDadosReduzidos (stream, img, largura, altura, bpp, paleta, fator, modo))
+    {
+        fprintf (stderr, "Error reading data from file.\n");
+        fclose (stream);
+        destroiImagem1C (img);
+        return (NULL);
+    }
+
+    fclose (stream);
+    return (img);
+}
+
+/*----------------------------------------------------------------------------*/
+/** Salva uma imagem em um arquivo dado.
+ *
+ * Parmetros: Imagem1C* img: imagem a salvar.
+ *             char* arquivo: caminho do arquivo a salvar.
+ *
+ * Valor de retorno: 0 se ocorreu algum erro, 1 do contrrio. */
+
+int salvaImagem1C (Imagem1C* img, char* arquivo)
+{
+    /* Salva como 8bpp com uma paleta de tons de cinza, sem expandir para 3
+       canais. */
+    return (salvaBMP (arquivo, img, NULL));
 }
 
 /*============================================================================*/
@@ -156,19 +379,45 @@ Imagem3C* criaImagem3C (int largura, int altura)
 	int i, j;
 	Imagem3C* img;
 
-	img = (Imagem3C*) malloc (sizeof (Imagem3C));
+	img = (Imagem3C*) pather_malloc (sizeof (Imagem3C));
+	if (!img)
+		return (NULL);
 
 	img->largura = largura;
 	img->altura = altura;
 
-	img->dados = (unsigned char***) malloc (sizeof (unsigned char**) * 3); /* Uma matriz por canal. */
+	img->dados = (unsigned char***) pather_malloc (sizeof (unsigned char**) * 3); /* Uma matriz por canal. */
+	if (!img->dados)
+	{
+		pather_free (img);
+		return (NULL);
+	}
+
 	for (i = 0; i < 3; i++)
+		img->dados [i] = (unsigned char**) pather_malloc (sizeof (unsigned char*) * altura);
+	if (!img->dados [0] || !img->dados [1] || !img->dados [2])
 	{
-		img->dados [i] = (unsigned char**) malloc (sizeof (unsigned char*) * altura);
-		for (j = 0; j < altura; j++)
-			img->dados [i][j] = (unsigned char*) malloc (sizeof (unsigned char) * largura);
+		for (i = 0; i < 3; i++)
+			pather_free (img->dados [i]);
+		pather_free (img->dados);
+		pather_free (img);
+		return (NULL);
 	}
 
+	/* Zera os ponteiros antes, para que destroiImagem3C possa limpar uma
+	   imagem alocada pela metade. */
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < altura; j++)
+			img->dados [i][j] = NULL;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < altura; j++)
+			if (!(img->dados [i][j] = (unsigned char*) pather_malloc (sizeof (unsigned char) * largura)))
+			{
+				destroiImagem3C (img);
+				return (NULL);
+			}
+
 	return (img);
 }
 
@@ -186,11 +435,11 @@ void destroiImagem3C (Imagem3C* img)
 	for (i = 0; i < 3; i++)
 	{
 		for (j = 0; j < img->altura; j++)
-			free (img->dados [i][j]);
-		free (img->dados [i]);
+			pather_free (img->dados [i][j]);
+		pather_free (img->dados [i]);
 	}
-	free (img->dados);
-	free (img);
+	pather_free (img->dados);
+	pather_free (img);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -204,48 +453,176 @@ void destroiImagem3C (Imagem3C* img)
 Imagem3C* abreImagem3C (char* arquivo)
 {
 	FILE* stream;
-	unsigned long data_offset = 0, largura = 0, altura = 0;
+	unsigned long largura = 0, altura = 0;
+	int bpp = 0;
+	unsigned char paleta [256][4];
 	Imagem3C* img;
 
+	stream = abreBMP (arquivo, &largura, &altura, &bpp, paleta);
+	if (!stream)
+		return (NULL);
+
+	/* Tudo pronto para criar nossa imagem! */
+	img = criaImagem3C (largura, altura);
+	if (!img)
+	{
+		fprintf (stderr, "Error: not enough memory for a %lux%lu image.\n", largura, altura);
+		fclose (stream);
+		return (NULL);
+	}
+
+	/* L os dados. */
+	if (!leDados (stream, img, bpp, paleta))
+	{
+		fprintf (stderr, "Error reading data from file.\n");
+		fclose (stream);
+		destroiImagem3C (img);
+		return (NULL);
+	}
+
+	fclose (stream);
+    return (img);
+}
+
+/*----------------------------------------------------------------------------*/
+/** Abre s uma regio retangular de um arquivo de imagem.
+ *
+ * Parmetros: os mesmos de abreImagem1CRegiao.
+ *
+ * Valor de retorno: uma imagem alocada com os dados da regio, ou NULL se no
+ *                   for possvel abrir a imagem ou se a regio estiver vazia. */
+
+Imagem3C* abreImagem3CRegiao (char* arquivo, unsigned long x0, unsigned long y0, unsigned long largura, unsigned long altura)
+{
+	FILE* stream;
+	int bpp = 0;
+	unsigned long offset = 0, largura_linha = 0;
+	unsigned char paleta [256][4];
+	Imagem3C* img;
+
+	stream = abreRegiaoBMP (arquivo, x0, y0, &largura, &altura, &bpp, paleta, &offset, &largura_linha);
+	if (!stream)
+		return (NULL);
+
+	img = criaImagem3C (largura, altura);
+	if (!img)
+	{
+		fprintf (stderr, "Error: not enough memory for a %lux%lu image.\n", largura, altura);
+		fclose (stream);
+		return (NULL);
+	}
+
+	if (!leDadosRegiao (stream, NULL, img, bpp, paleta, offset, largura_linha, x0 * (bpp / 8)))
+	{
+		fprintf (stderr, "Error reading data from file.\n");
+		fclose (stream);
+		destroiImagem3C (img);
+		return (NULL);
+	}
+
+	fclose (stream);
+	return (img);
+}
+
+/*----------------------------------------------------------------------------*/
+/** Abre um arquivo BMP e l todos os cabealhos (e a paleta, se houver),
+ * deixando o fluxo posicionado no incio dos dados.
+ *
+ * Parmetros: char* arquivo: caminho do arquivo a abrir.
+ *             unsigned long* largura: parmetro de sada. Largura da imagem.
+ *             unsigned long* altura: parmetro de sada. Altura da imagem.
+ *             int* bpp: parmetro de sada. Bits por pixel (8, 24 ou 32).
+ *             unsigned char paleta [256][4]: parmetro de sada. Paleta BGRX,
+ *               preenchida apenas para imagens de 8bpp.
+ *
+ * Valor de Retorno: o fluxo aberto, ou NULL se ocorreram erros. */
+
+FILE* abreBMP (char* arquivo, unsigned long* largura, unsigned long* altura, int* bpp, unsigned char paleta [256][4])
+{
+	FILE* stream;
+	unsigned long data_offset = 0, cores = 0, tamanho_dib = 0;
+
 	/* Abre o arquivo. */
 	stream = fopen (arquivo, "rb");
 	if (!stream)
 		return (NULL);
 
-	if (!leHeaderBitmap (stream, &data_offset))
+	if (!leHeaderBitmap (stream, &data_offset) ||
+	    !leHeaderDIB (stream, largura, altura, bpp, &cores, &tamanho_dib))
 	{
 		fclose (stream);
 		return (NULL);
 	}
 
-	if (!leHeaderDIB (stream, &largura, &altura))
+	if (*bpp == 8 && !lePaleta (stream, cores, paleta))
 	{
 		fclose (stream);
 		return (NULL);
 	}
 
-	/* Pronto, cabealhos lidos! Vamos agora colocar o fluxo nos dados... */
+	/* Pronto, cabealhos lidos! Vamos agora colocar o fluxo nos dados. */
 	if (fseek (stream, data_offset, SEEK_SET) != 0)
 	{
-		printf ("Error reading file data.\n");
+		fprintf (stderr, "Error reading file data.\n");
 		fclose (stream);
 		return (NULL);
 	}
 
-	/* ... e tudo pronto para criar nossa imagem! */
-	img = criaImagem3C (largura, altura);
+	return (stream);
+}
 
-	/* L os dados. */
-	if (!leDados (stream, img))
+/*----------------------------------------------------------------------------*/
+/** Abre um arquivo BMP para ler uma regio: l os cabealhos, recorta a regio
+ * aos limites da imagem e calcula onde comeam os seus dados no arquivo. As
+ * linhas ficam de baixo para cima no arquivo, ento a primeira linha lida  a
+ * ltima da regio.
+ *
+ * Parmetros: char* arquivo: caminho do arquivo a abrir.
+ *             unsigned long x0, y0: canto superior esquerdo da regio.
+ *             unsigned long* largura, altura: entrada e sada. Tamanho da
+ *               regio, j recortado.
+ *             int* bpp: parmetro de sada. Bits por pixel (8, 24 ou 32).
+ *             unsigned char paleta [256][4]: parmetro de sada. Paleta BGRX.
+ *             unsigned long* offset: parmetro de sada. Posio no arquivo
+ *               do primeiro byte da ltima linha da regio.
+ *             unsigned long* largura_linha: parmetro de sada. Bytes por
+ *               linha do arquivo, com o padding.
+ *
+ * Valor de Retorno: o fluxo aberto, ou NULL se ocorreram erros. */
+
+FILE* abreRegiaoBMP (char* arquivo, unsigned long x0, unsigned long y0, unsigned long* largura, unsigned long* altura, int* bpp, unsigned char paleta [256][4], unsigned long* offset, unsigned long* largura_linha)
+{
+	FILE* stream;
+	unsigned long largura_total = 0, altura_total = 0;
+	long dados;
+
+	stream = abreBMP (arquivo, &largura_total, &altura_total, bpp, paleta);
+	if (!stream)
+		return (NULL);
+
+	if (x0 >= largura_total || y0 >= altura_total || *largura == 0 || *altura == 0)
 	{
-		printf ("Error reading data from file.\n");
+		fprintf (stderr, "Error: region outside of the %lux%lu image.\n", largura_total, altura_total);
 		fclose (stream);
-		free (img);
 		return (NULL);
 	}
 
-	fclose (stream);
-    return (img);
+	if (*largura > largura_total - x0)
+		*largura = largura_total - x0;
+	if (*altura > altura_total - y0)
+		*altura = altura_total - y0;
+
+	/* O abreBMP deixa o fluxo no comeo dos dados. */
+	dados = ftell (stream);
+	if (dados < 0)
+	{
+		fclose (stream);
+		return (NULL);
+	}
+
+	*largura_linha = bytesPorLinha (largura_total, *bpp);
+	*offset = (unsigned long) dados + (altura_total - y0 - *altura) * *largura_linha;
+	return (stream);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -276,14 +653,14 @@ int leHeaderBitmap (FILE* stream, unsigned long* offset)
 
 	if (fread ((void*) data, 1, 14, stream) != 14)
 	{
-		printf ("Error reading the Bitmap header.\n");
+		fprintf (stderr, "Error reading the Bitmap header.\n");
 		return (0);
 	}
 
 	/* Os 2 primeiros bytes precisam ser 'B' e 'M'. */
 	if (data [0] != 'B' || data [1] != 'M')
 	{
-		printf ("Error: can read only BM format.\n");
+		fprintf (stderr, "Error: can read only BM format.\n");
 		return (0);
 	}
 
@@ -298,123 +675,504 @@ int leHeaderBitmap (FILE* stream, unsigned long* offset)
  * Parmetros: FILE* stream: arquivo a ser lido. Supomos que j est aberto.
  *             unsigned long* largura: parmetro de sada. Largura da imagem.
  *             unsigned long* altura: parmetro de sada. Altura da imagem.
+ *             int* bpp: parmetro de sada. Bits por pixel (8, 24 ou 32).
+ *             unsigned long* cores: parmetro de sada. Nmero de cores na
+ *               paleta (s para 8bpp).
+ *             unsigned long* tamanho: parmetro de sada. Bytes lidos do
+ *               header DIB (com as mscaras de BI_BITFIELDS); a paleta vem
+ *               logo depois deles.
+ *
+ * O header  lido s para a frente, sem fseek, ento o fluxo pode ser um
+ * pipe. Ao retornar, ele fica logo depois do header.
  *
  * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
 
-int leHeaderDIB (FILE* stream, unsigned long* largura, unsigned long* altura)
+int leHeaderDIB (FILE* stream, unsigned long* largura, unsigned long* altura, int* bpp, unsigned long* cores, unsigned long* tamanho)
 {
 	unsigned long size = 0; /* O tamanho do cabealho DIB. */
 
 	if (fread ((void*) &size, 4, 1, stream) != 1)
 	{
-		printf ("Error reading DIB header.\n");
+		fprintf (stderr, "Error reading DIB header.\n");
 		return (0);
 	}
 
 	if (size == 12) /* Formato BITMAPCOREHEADER. */
 	{
-		printf ("Error: BITMAPCOREHEADER not supported (is this file really THAT old!?)\n");
+		fprintf (stderr, "Error: BITMAPCOREHEADER not supported (is this file really THAT old!?)\n");
 		return (0);
 	}
 	else if (size >= 40) /* Outros formatos. */
 	{
+		unsigned long compressao = 0;
 		unsigned short tmp_short = 0;
 		unsigned long tmp_long = 0;
 
 		/* Largura. */
 		if (fread ((void*) largura, 4, 1, stream) != 1 || *largura <= 0)
 		{
-			printf ("Error: invalid width.\n");
+			fprintf (stderr, "Error: invalid width.\n");
 			return (0);
 		}
 
 		/* Altura. */
 		if (fread ((void*) altura, 4, 1, stream) != 1 || *altura <= 0)
 		{
-			printf ("Error: invalid height.\n");
+			fprintf (stderr, "Error: invalid height.\n");
 			return (0);
 		}
 
 		/* Color planes. Precisa ser 1. */
 		if (fread ((void*) &tmp_short, 2, 1, stream) != 1 || tmp_short != 1)
 		{
-			printf ("Error reading DIB header.\n");
+			fprintf (stderr, "Error reading DIB header.\n");
 			return (0);
 		}
 
-		/* Bpp. Aqui, estou forando 24 bpp. */
-		if (fread ((void*) &tmp_short, 2, 1, stream) != 1 || tmp_short != 24)
+		/* Bpp. Aceitamos 8 bpp (com paleta), 24 bpp e 32 bpp (BGRA). */
+		if (fread ((void*) &tmp_short, 2, 1, stream) != 1 || (tmp_short != 8 && tmp_short != 24 && tmp_short != 32))
 		{
-			printf ("Error: this function supports only 24 bpp files.\n");
+			fprintf (stderr, "Error: this function supports only 8, 24 and 32 bpp files.\n");
 			return (0);
 		}
+		*bpp = tmp_short;
 
-		/* Compresso. Vou aceitar s imagens sem compresso. */
-		if (fread ((void*) &tmp_long, 4, 1, stream) != 1 || tmp_long != 0)
+		/* Compresso. Vou aceitar s imagens sem compresso, ou BI_BITFIELDS
+		   em 32 bpp (as mscaras so conferidas mais abaixo). */
+		if (fread ((void*) &compressao, 4, 1, stream) != 1 || (compressao != 0 && !(compressao == 3 && *bpp == 32)))
 		{
-			printf ("Error: this function supports only uncompressed files.\n");
+			fprintf (stderr, "Error: this function supports only uncompressed files.\n");
 			return (0);
 		}
 
 		/* Pula os prximos 12 bytes. */
-		if (fseek (stream, 12, SEEK_CUR) != 0)
+		if (!pulaBytes (stream, 12))
+		{
+			fprintf (stderr, "Error reading DIB header.\n");
+			return (0);
+		}
+
+		/* Paleta. S  usada em 8 bpp; 0 quer dizer 256 cores. */
+		if (fread ((void*) &tmp_long, 4, 1, stream) != 1 || tmp_long > 256 || (tmp_long != 0 && *bpp != 8))
 		{
-			printf ("Error reading DIB header.\n");
+			fprintf (stderr, "Error: this function supports color palettes only in 8 bpp files.\n");
 			return (0);
 		}
+		*cores = tmp_long ? tmp_long : 256;
+		*tamanho = 40;
 
-		/* Paleta. No  para usar! */
-		if (fread ((void*) &tmp_long, 4, 1, stream) != 1 || tmp_long != 0)
+		/* Cores importantes: ignorado. */
+		if (!pulaBytes (stream, 4))
 		{
-			printf ("Error: this function does not support color palettes.\n");
+			fprintf (stderr, "Error reading DIB header.\n");
 			return (0);
 		}
 
+		/* Com BI_BITFIELDS, as mscaras R, G, B ficam logo aps os 40 bytes
+		   do BITMAPINFOHEADER (dentro do header, nas verses V4/V5). S
+		   aceitamos a ordem BGRA usual. */
+		if (compressao == 3)
+		{
+			unsigned char mascaras [12];
+
+			*tamanho += 12;
+			if (fread ((void*) mascaras, 1, 12, stream) != 12 ||
+			    getLittleEndianULong (mascaras) != 0x00FF0000 ||
+			    getLittleEndianULong (mascaras + 4) != 0x0000FF00 ||
+			    getLittleEndianULong (mascaras + 8) != 0x000000FF)
+			{
+				fprintf (stderr, "Error: this function supports only BGRA bitfields.\n");
+				return (0);
+			}
+		}
+
+		/* O resto do header (V4/V5) no nos interessa. */
+		if (size > *tamanho)
+		{
+			if (!pulaBytes (stream, size - *tamanho))
+			{
+				fprintf (stderr, "Error reading DIB header.\n");
+				return (0);
+			}
+			*tamanho = size;
+		}
+
 		return (1);
 	}
 
 	return (0);
 }
 
+/*----------------------------------------------------------------------------*/
+/** L a paleta de uma imagem de 8 bpp, que vem logo depois do header DIB.
+ *
+ * Parmetros: FILE* stream: arquivo a ser lido. Supomos que j est aberto e
+ *               posicionado no fim do header DIB.
+ *             unsigned long cores: nmero de entradas da paleta.
+ *             unsigned char paleta [256][4]: parmetro de sada. Entradas
+ *               BGRX; as que no esto no arquivo ficam pretas.
+ *
+ * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
+
+int lePaleta (FILE* stream, unsigned long cores, unsigned char paleta [256][4])
+{
+	memset (paleta, 0, BYTES_PALETA);
+
+	if (fread ((void*) paleta, 4, cores, stream) != cores)
+	{
+		fprintf (stderr, "Error reading the color palette.\n");
+		return (0);
+	}
+
+	return (1);
+}
+
+/*----------------------------------------------------------------------------*/
+/** Descarta bytes do fluxo, lendo-os. Ao contrrio do fseek, funciona tambm
+ * em pipes e na entrada padro.
+ *
+ * Parmetros: FILE* stream: arquivo a ser lido. Supomos que j est aberto.
+ *             unsigned long n: nmero de bytes a pular.
+ *
+ * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
+
+int pulaBytes (FILE* stream, unsigned long n)
+{
+	unsigned char descarte [256];
+
+	while (n > 0)
+	{
+		unsigned long bloco = n < sizeof (descarte) ? n : sizeof (descarte);
+
+		if (fread ((void*) descarte, 1, bloco, stream) != bloco)
+			return (0);
+		n -= bloco;
+	}
+
+	return (1);
+}
+
+/*----------------------------------------------------------------------------*/
+/** Calcula o tamanho de uma linha no arquivo. Cada linha precisa ter um
+ * mltiplo de 4 bytes.
+ *
+ * Parmetros: unsigned long largura: largura da imagem.
+ *             int bpp: bits por pixel.
+ *
+ * Valor de Retorno: o nmero de bytes por linha, incluindo o padding. */
+
+unsigned long bytesPorLinha (unsigned long largura, int bpp)
+{
+	return ((largura * bpp + 31) / 32) * 4;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Conversores de linha, um por formato. Nos de 24 e 32 bpp o passo entre os
+ * pixels  uma constante, ento o lao  desenrolado e vetorizado pelo
+ * compilador; o formato  escolhido uma vez por imagem, e no a cada linha.
+ * Os de cinza recebem a tabela `cinza` (s usada em 8 bpp); os de 3 canais,
+ * a paleta. */
+
+typedef void (*ConversorCinza) (unsigned char* destino, const unsigned char* linha, unsigned long largura, const unsigned char* cinza);
+typedef void (*ConversorBGR) (unsigned char* b, unsigned char* g, unsigned char* r, const unsigned char* linha, unsigned long largura, unsigned char paleta [256][4]);
+
+#define CONVERSOR_CINZA(nome, passo) \
+static void nome (unsigned char* destino, const unsigned char* linha, unsigned long largura, const unsigned char* cinza) \
+{ \
+	unsigned long j; \
+	(void) cinza; \
+	for (j = 0; j < largura; j++) \
+		destino [j] = LUMA (linha [j*(passo)+2], linha [j*(passo)+1], linha [j*(passo)]); \
+}
+
+#define CONVERSOR_BGR(nome, passo) \
+static void nome (unsigned char* b, unsigned char* g, unsigned char* r, const unsigned char* linha, unsigned long largura, unsigned char paleta [256][4]) \
+{ \
+	unsigned long j; \
+	(void) paleta; \
+	for (j = 0; j < largura; j++) \
+	{ \
+		b [j] = linha [j*(passo)]; \
+		g [j] = linha [j*(passo)+1]; \
+		r [j] = linha [j*(passo)+2]; \
+	} \
+}
+
+CONVERSOR_CINZA (cinzaLinha24, 3)
+CONVERSOR_CINZA (cinzaLinha32, 4)
+CONVERSOR_BGR (bgrLinha24, 3)
+CONVERSOR_BGR (bgrLinha32, 4)
+
+static void cinzaLinha8 (unsigned char* destino, const unsigned char* linha, unsigned long largura, const unsigned char* cinza)
+{
+	unsigned long j;
+	for (j = 0; j < largura; j++)
+		destino [j] = cinza [linha [j]];
+}
+
+static void bgrLinha8 (unsigned char* b, unsigned char* g, unsigned char* r, const unsigned char* linha, unsigned long largura, unsigned char paleta [256][4])
+{
+	unsigned long j;
+	for (j = 0; j < largura; j++)
+	{
+		b [j] = paleta [linha [j]][0];
+		g [j] = paleta [linha [j]][1];
+		r [j] = paleta [linha [j]][2];
+	}
+}
+
+static ConversorCinza conversorCinza (int bpp)
+{
+	return (bpp == 8 ? cinzaLinha8 : bpp == 24 ? cinzaLinha24 : cinzaLinha32);
+}
+
+static ConversorBGR conversorBGR (int bpp)
+{
+	return (bpp == 8 ? bgrLinha8 : bpp == 24 ? bgrLinha24 : bgrLinha32);
+}
+
 /*----------------------------------------------------------------------------*/
 /** L os dados de um arquivo.
  *
  * Parmetros: FILE* stream: arquivo a ser lido. Supomos que j est aberto.
  *             Imagem3C* img: imagem a preencher.
+ *             int bpp: bits por pixel do arquivo.
+ *             unsigned char paleta [256][4]: paleta, para 8 bpp.
  *
  * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
 
-int leDados (FILE* stream, Imagem3C* img)
+int leDados (FILE* stream, Imagem3C* img, int bpp, unsigned char paleta [256][4])
 {
-	long long i, j;
-	int line_padding;
+	long long i;
+	unsigned long largura_linha;
+	unsigned char* linha;
+	ConversorBGR converte = conversorBGR (bpp);
 
-	/* Calcula quantos bytes preciso pular no fim de cada linha.
-	  Aqui, cada linha precisa ter um mltiplo de 4. */
-	line_padding = (int) ceil (img->largura*3.0/4.0)*4 - (img->largura*3);
+	/* Lemos uma linha inteira (com o padding) por vez. */
+	largura_linha = bytesPorLinha (img->largura, bpp);
+	linha = (unsigned char*) pather_malloc (largura_linha);
+	if (!linha)
+		return (0);
 
 	/* L! */
 	for (i = img->altura-1; i >= 0; i--)
 	{
-		for (j = 0; j < img->largura; j++)
+		if (fread ((void*) linha, 1, largura_linha, stream) != largura_linha)
 		{
-			if (fread (&(img->dados [CANAL_B][i][j]), 1, 1, stream) != 1)
-				return (0);
+			pather_free (linha);
+			return (0);
+		}
 
-			if (fread (&(img->dados [CANAL_G][i][j]), 1, 1, stream) != 1)
-				return (0);
+		converte (img->dados [CANAL_B][i], img->dados [CANAL_G][i], img->dados [CANAL_R][i], linha, img->largura, paleta);
+	}
+
+	pather_free (linha);
+	return (1);
+}
+
+/*----------------------------------------------------------------------------*/
+/** L os dados de um arquivo direto em escala de cinza. Usamos aqui os mesmos
+ * fatores de converso do OpenCV, que mantm certas propriedades de percepo,
+ * em aritmtica inteira (LUMA).
+ * Em 8 bpp, a converso  feita uma vez por entrada da paleta; se a paleta 
+ * a rampa de cinza usual, as linhas so copiadas diretamente.
+ *
+ * Parmetros: FILE* stream: arquivo a ser lido. Supomos que j est aberto.
+ *             Imagem1C* img: imagem a preencher.
+ *             int bpp: bits por pixel do arquivo.
+ *             unsigned char paleta [256][4]: paleta, para 8 bpp.
+ *
+ * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
+
+int leDados1C (FILE* stream, Imagem1C* img, int bpp, unsigned char paleta [256][4])
+{
+	long long i, j;
+	unsigned long largura_linha;
+	unsigned char* linha;
+	unsigned char cinza [256];
+	int rampa = 1;
+	ConversorCinza converte = conversorCinza (bpp);
+
+	if (bpp == 8)
+		for (j = 0; j < 256; j++)
+		{
+			cinza [j] = LUMA (paleta [j][2], paleta [j][1], paleta [j][0]);
+			rampa = rampa && paleta [j][0] == j && paleta [j][1] == j && paleta [j][2] == j;
+		}
+
+	largura_linha = bytesPorLinha (img->largura, bpp);
+	linha = (unsigned char*) pather_malloc (largura_linha);
+	if (!linha)
+		return (0);
 
-			if (fread (&(img->dados [CANAL_R][i][j]), 1, 1, stream) != 1)
+	for (i = img->altura-1; i >= 0; i--)
+	{
+		/* Em 8 bpp com rampa de cinza, lemos direto na linha da imagem e
+		   s descartamos o padding. */
+		if (bpp == 8 && rampa)
+		{
+			if (fread ((void*) img->dados [i], 1, img->largura, stream) != img->largura ||
+			    fread ((void*) linha, 1, largura_linha - img->largura, stream) != largura_linha - img->largura)
+			{
+				pather_free (linha);
 				return (0);
+			}
+			continue;
 		}
 
-		if (fseek (stream, line_padding, SEEK_CUR) != 0)
+		if (fread ((void*) linha, 1, largura_linha, stream) != largura_linha)
+		{
+			pather_free (linha);
 			return (0);
+		}
+
+		converte (img->dados [i], linha, img->largura, cinza);
 	}
 
+	pather_free (linha);
 	return (1);
 }
 
+/*----------------------------------------------------------------------------*/
+/** L os dados de uma regio, linha a linha. De cada linha do arquivo s so
+ * lidos os bytes das colunas da regio; as linhas fora dela nunca so lidas.
+ *
+ * Parmetros: FILE* stream: arquivo a ser lido. Supomos que j est aberto.
+ *             Imagem1C* img1c: imagem de 1 canal a preencher, ou NULL.
+ *             Imagem3C* img3c: imagem de 3 canais a preencher, ou NULL.
+ *             int bpp: bits por pixel do arquivo.
+ *             unsigned char paleta [256][4]: paleta, para 8 bpp.
+ *             unsigned long offset: posio da ltima linha da regio.
+ *             unsigned long largura_linha: bytes por linha do arquivo.
+ *             unsigned long passo_x0: bytes at a primeira coluna da regio.
+ *
+ * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
+
+int leDadosRegiao (FILE* stream, Imagem1C* img1c, Imagem3C* img3c, int bpp, unsigned char paleta [256][4], unsigned long offset, unsigned long largura_linha, unsigned long passo_x0)
+{
+	long long i, j;
+	unsigned long largura, altura, bytes;
+	unsigned char* linha;
+	unsigned char cinza [256];
+	int passo = bpp / 8;
+	ConversorCinza converte_cinza = conversorCinza (bpp);
+	ConversorBGR converte_bgr = conversorBGR (bpp);
+
+	largura = img1c ? img1c->largura : img3c->largura;
+	altura = img1c ? img1c->altura : img3c->altura;
+	bytes = largura * passo;
+
+	if (img1c && bpp == 8)
+		for (j = 0; j < 256; j++)
+			cinza [j] = LUMA (paleta [j][2], paleta [j][1], paleta [j][0]);
+
+	linha = (unsigned char*) pather_malloc (bytes);
+	if (!linha)
+		return (0);
+
+	for (i = altura-1; i >= 0; i--, offset += largura_linha)
+	{
+		if (fseek (stream, offset + passo_x0, SEEK_SET) != 0 ||
+		    fread ((void*) linha, 1, bytes, stream) != bytes)
+		{
+			pather_free (linha);
+			return (0);
+		}
+
+		if (img1c)
+			converte_cinza (img1c->dados [i], linha, largura, cinza);
+		else
+			converte_bgr (img3c->dados [CANAL_B][i], img3c->dados [CANAL_G][i], img3c->dados [CANAL_R][i], linha, largura, paleta);
+	}
+
+	pather_free (linha);
+	return (1);
+}
+
+/*----------------------------------------------------------------------------*/
+/** L os dados de um arquivo reduzindo-os por um fator. Cada linha do arquivo
+ *  convertida para cinza e acumulada na linha reduzida do seu bloco: no modo
+ * REDUCAO_MINIMO, guardando o menor valor; no modo REDUCAO_MEDIA, somando as
+ * colunas e dividindo quando a ltima linha do bloco  lida (as linhas vm de
+ * baixo para cima, ento a ltima lida  a de cima).
+ *
+ * Parmetros: FILE* stream: arquivo a ser lido. Supomos que j est aberto.
+ *             Imagem1C* img: imagem reduzida a preencher.
+ *             unsigned long largura, altura: tamanho da imagem no arquivo.
+ *             int bpp: bits por pixel do arquivo.
+ *             unsigned char paleta [256][4]: paleta, para 8 bpp.
+ *             int fator: fator de reduo.
+ *             int modo: REDUCAO_MEDIA ou REDUCAO_MINIMO.
+ *
+ * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
+
+int leDadosReduzidos (FILE* stream, Imagem1C* img, unsigned long largura, unsigned long altura, int bpp, unsigned char paleta [256][4], int fator, int modo)
+{
+	long long i;
+	unsigned long j, largura_linha;
+	unsigned char *linha, *cinza_linha;
+	unsigned int* soma;
+	unsigned char cinza [256];
+	int ok = 1;
+	ConversorCinza converte = conversorCinza (bpp);
+
+	if (bpp == 8)
+		for (j = 0; j < 256; j++)
+			cinza [j] = LUMA (paleta [j][2], paleta [j][1], paleta [j][0]);
+
+	largura_linha = bytesPorLinha (largura, bpp);
+	linha = (unsigned char*) pather_malloc (largura_linha);
+	cinza_linha = (unsigned char*) pather_malloc (largura);
+	soma = (unsigned int*) pather_malloc (sizeof (unsigned int) * img->largura);
+	if (!linha || !cinza_linha || !soma)
+		ok = 0;
+
+	for (i = altura-1; ok && i >= 0; i--)
+	{
+		unsigned char* saida = img->dados [i / fator];
+		int primeira = i == (long long) altura-1 || i % fator == fator-1; /* Primeira linha lida do bloco. */
+
+		if (fread ((void*) linha, 1, largura_linha, stream) != largura_linha)
+		{
+			ok = 0;
+			break;
+		}
+
+		converte (cinza_linha, linha, largura, cinza);
+
+		if (modo == REDUCAO_MINIMO)
+		{
+			for (j = 0; j < largura; j++)
+				if ((primeira && j % fator == 0) || cinza_linha [j] < saida [j / fator])
+					saida [j / fator] = cinza_linha [j];
+			continue;
+		}
+
+		if (primeira)
+			memset (soma, 0, sizeof (unsigned int) * img->largura);
+		for (j = 0; j < largura; j++)
+			soma [j / fator] += cinza_linha [j];
+
+		/* Bloco completo: divide pelo nmero de pixels (menor nas bordas). */
+		if (i % fator == 0)
+		{
+			unsigned long linhas = altura - i < (unsigned long) fator ? altura - i : (unsigned long) fator;
+
+			for (j = 0; j < img->largura; j++)
+			{
+				unsigned long colunas = largura - j*fator < (unsigned long) fator ? largura - j*fator : (unsigned long) fator;
+				unsigned long n = linhas * colunas;
+				saida [j] = (unsigned char) ((soma [j] + n/2) / n);
+			}
+		}
+	}
+
+	pather_free (soma);
+	pather_free (cinza_linha);
+	pather_free (linha);
+	return (ok);
+}
+
 /*----------------------------------------------------------------------------*/
 /** Salva uma imagem em um arquivo dado.
  *
@@ -425,33 +1183,104 @@ int leDados (FILE* stream, Imagem3C* img)
 
 int salvaImagem3C (Imagem3C* img, char* arquivo)
 {
-	FILE* stream;
+	return (salvaBMP (arquivo, NULL, img));
+}
+
+/*----------------------------------------------------------------------------*/
+/** Serializa uma imagem inteira (cabealhos, paleta e dados) em um nico
+ * buffer e o escreve com um s pwrite. Se o buffer no couber no oramento de
+ * memria, o arquivo  dimensionado e mapeado com mmap, e a serializao 
+ * feita direto no mapeamento.
+ *
+ * Parmetros: char* arquivo: caminho do arquivo a salvar.
+ *             Imagem1C* img1c: imagem de 1 canal a salvar em 8 bpp, ou NULL.
+ *             Imagem3C* img3c: imagem de 3 canais a salvar em 24 bpp, ou NULL.
+ *
+ * Valor de retorno: 0 se ocorreu algum erro, 1 do contrrio. */
+
+int salvaBMP (char* arquivo, Imagem1C* img1c, Imagem3C* img3c)
+{
+	unsigned long largura, altura, cabecalhos, tamanho;
+	unsigned char* buffer;
+	int fd, bpp, ok = 1, mapeado = 0;
+
+	largura = img1c ? img1c->largura : img3c->largura;
+	altura = img1c ? img1c->altura : img3c->altura;
+	bpp = img1c ? 8 : 24;
+	cabecalhos = 14+40 + (bpp == 8 ? BYTES_PALETA : 0);
+	tamanho = cabecalhos + altura*bytesPorLinha (largura, bpp);
 
 	/* Abre o arquivo. */
-	stream = fopen (arquivo, "wb");
-	if (!stream)
+	fd = open (arquivo, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
 		return (0);
 
-	/* Escreve os blocos. */
-	if (!salvaHeaderBitmap (stream, img))
+	buffer = (unsigned char*) pather_malloc (tamanho);
+	if (!buffer)
 	{
-		fclose (stream);
-		return (0);
+		if (ftruncate (fd, tamanho) != 0 ||
+		    (buffer = (unsigned char*) mmap (NULL, tamanho, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		{
+			fprintf (stderr, "Error: not enough memory to write image data.\n");
+			close (fd);
+			return (0);
+		}
+		mapeado = 1;
 	}
 
-	if (!salvaHeaderDIB (stream, img))
+	/* Monta os blocos. */
+	salvaHeaderBitmap (buffer, largura, altura, bpp);
+	salvaHeaderDIB (buffer+14, largura, altura, bpp);
+	if (img1c)
 	{
-		fclose (stream);
-		return (0);
+		salvaPaletaCinza (buffer+14+40);
+		salvaDados1C (buffer+cabecalhos, img1c);
 	}
+	else
+		salvaDados (buffer+cabecalhos, img3c);
 
-	if (!salvaDados (stream, img))
+	if (mapeado)
+		ok = munmap (buffer, tamanho) == 0;
+	else
 	{
-		fclose (stream);
+		ok = escreveTudo (fd, buffer, tamanho);
+		pather_free (buffer);
+	}
+
+	if (close (fd) != 0 || !ok)
+	{
+		fprintf (stderr, "Error writing image data.\n");
 		return (0);
 	}
 
-	fclose (stream);
+	return (1);
+}
+
+/*----------------------------------------------------------------------------*/
+/** Escreve um buffer inteiro no incio de um arquivo. Normalmente  um nico
+ * pwrite; s repetimos se a escrita for parcial ou interrompida.
+ *
+ * Parmetros: int fd: descritor do arquivo.
+ *             unsigned char* buffer: dados a escrever.
+ *             unsigned long tamanho: nmero de bytes.
+ *
+ * Valor de retorno: 0 se ocorreu algum erro, 1 do contrrio. */
+
+int escreveTudo (int fd, unsigned char* buffer, unsigned long tamanho)
+{
+	unsigned long escrito = 0;
+	ssize_t n;
+
+	while (escrito < tamanho)
+	{
+		n = pwrite (fd, buffer+escrito, tamanho-escrito, escrito);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return (0);
+		escrito += n;
+	}
+
 	return (1);
 }
 
@@ -490,65 +1319,57 @@ void putLittleEndianUShort (unsigned short val, unsigned char* buffer)
 /*----------------------------------------------------------------------------*/
 /** Escreve o header Bitmap.
  *
- * Parmetros: FILE* file: arquivo a ser escrito. Supomos que j est aberto.
- *             Imagem3C* img: imagem a ser salva.
+ * Parmetros: unsigned char* data: buffer onde escrever os 14 bytes.
+ *             unsigned long largura: largura da imagem.
+ *             unsigned long altura: altura da imagem.
+ *             int bpp: bits por pixel (8 ou 24). Em 8 bpp h uma paleta.
  *
- * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
+ * Valor de Retorno: NENHUM */
 
-int salvaHeaderBitmap (FILE* stream, Imagem3C* img)
+void salvaHeaderBitmap (unsigned char* data, unsigned long largura, unsigned long altura, int bpp)
 {
-	unsigned char data [14]; /* O bloco tem exatamente 14 bytes. */
-	int pos = 0;
-	unsigned long bytes_por_linha;
+	int pos = 0; /* O bloco tem exatamente 14 bytes. */
+	unsigned long cabecalhos = 14+40 + (bpp == 8 ? BYTES_PALETA : 0);
 
 	data [pos++] = 'B';
 	data [pos++] = 'M';
 
-	/* Tamanho do arquivo. Definimos como sendo 14+40 (dos cabealhos) + o espao dos dados. */
-	bytes_por_linha = (unsigned long) ceil (img->largura*3.0/4.0)*4;
-	putLittleEndianULong (14+40+img->altura*bytes_por_linha, &(data [pos]));
+	/* Tamanho do arquivo. Definimos como sendo 14+40 (dos cabealhos) + a paleta + o espao dos dados. */
+	putLittleEndianULong (cabecalhos+altura*bytesPorLinha (largura, bpp), &(data [pos]));
 	pos+=4;
 
 	/* Reservado. */
 	putLittleEndianULong (0, &(data [pos]));
 	pos+=4;
 
-	/* Offset. Definimos como 14+40 (o tamanho dos cabealhos). */
-	putLittleEndianULong (14+40, &(data [pos]));
-
-	if (fwrite ((void*) data, 1, 14, stream) != 14)
-	{
-		printf ("Error writing Bitmap header.\n");
-		return (0);
-	}
-
-	return (1);
+	/* Offset. Definimos como o tamanho dos cabealhos e da paleta. */
+	putLittleEndianULong (cabecalhos, &(data [pos]));
 }
 
 /*----------------------------------------------------------------------------*/
 /** Escreve o header DIB.
  *
- * Parmetros: FILE* file: arquivo a ser escrito. Supomos que j est aberto.
- *             Imagem3C* img: imagem a ser salva.
+ * Parmetros: unsigned char* data: buffer onde escrever os 40 bytes.
+ *             unsigned long largura: largura da imagem.
+ *             unsigned long altura: altura da imagem.
+ *             int bpp: bits por pixel (8 ou 24).
  *
- * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
+ * Valor de Retorno: NENHUM */
 
-int salvaHeaderDIB (FILE* stream, Imagem3C* img)
+void salvaHeaderDIB (unsigned char* data, unsigned long largura, unsigned long altura, int bpp)
 {
-	unsigned char data [40]; /* O bloco tem exatamente 40 bytes. */
-	int pos = 0;
-	unsigned long bytes_por_linha;
+	int pos = 0; /* O bloco tem exatamente 40 bytes. */
 
 	/* Tamanho do header. Vamos usar um BITMAPINFOHEADER. */
 	putLittleEndianULong (40, &(data [pos]));
 	pos += 4;
 
 	/* Largura. */
-	putLittleEndianULong (img->largura, &(data [pos]));
+	putLittleEndianULong (largura, &(data [pos]));
 	pos += 4;
 
 	/* Altura. */
-	putLittleEndianULong (img->altura, &(data [pos]));
+	putLittleEndianULong (altura, &(data [pos]));
 	pos += 4;
 
 	/* Color planes. */
@@ -556,7 +1377,7 @@ int salvaHeaderDIB (FILE* stream, Imagem3C* img)
 	pos += 2;
 
 	/* bpp. */
-	putLittleEndianUShort (24, &(data [pos]));
+	putLittleEndianUShort (bpp, &(data [pos]));
 	pos += 2;
 
 	/* Compresso. */
@@ -564,8 +1385,7 @@ int salvaHeaderDIB (FILE* stream, Imagem3C* img)
 	pos += 4;
 
 	/* Tamanho dos dados. */
-	bytes_por_linha = (unsigned long) ceil (img->largura*3.0/4.0)*4;
-	putLittleEndianULong (img->altura*bytes_por_linha, &(data [pos]));
+	putLittleEndianULong (altura*bytesPorLinha (largura, bpp), &(data [pos]));
 	pos += 4;
 
 	/* Resoluo horizontal e vertical (simplesmente copiei este valor de algum arquivo!). */
@@ -574,65 +1394,126 @@ int salvaHeaderDIB (FILE* stream, Imagem3C* img)
 	putLittleEndianULong (0xF61, &(data [pos]));
 	pos += 4;
 
-	/* Cores. */
-	putLittleEndianULong (0, &(data [pos]));
+	/* Cores. Em 8 bpp, a paleta completa de 256 tons de cinza. */
+	putLittleEndianULong (bpp == 8 ? 256 : 0, &(data [pos]));
 	pos += 4;
 	putLittleEndianULong (0, &(data [pos]));
-	pos += 4;
+}
 
-	if (fwrite ((void*) data, 1, 40, stream) != 40)
+/*----------------------------------------------------------------------------*/
+/** Escreve uma paleta de 256 tons de cinza (rampa 0..255).
+ *
+ * Parmetros: unsigned char* paleta: buffer onde escrever os 1024 bytes.
+ *
+ * Valor de Retorno: NENHUM */
+
+void salvaPaletaCinza (unsigned char* paleta)
+{
+	int i;
+
+	for (i = 0; i < 256; i++)
 	{
-		printf ("Error writing DIB header.\n");
-		return (0);
+		paleta [i*4] = paleta [i*4+1] = paleta [i*4+2] = (unsigned char) i;
+		paleta [i*4+3] = 0;
 	}
-
-	return (1);
 }
 
 /*----------------------------------------------------------------------------*/
 /** Escreve o bloco de dados.
  *
- * Parmetros: FILE* file: arquivo a ser escrito. Supomos que j est aberto.
+ * Parmetros: unsigned char* data: buffer onde escrever as linhas (com padding).
  *             Imagem3C* img: imagem a ser salva.
  *
- * Valor de Retorno: 1 se no ocorreram erros, 0 do contrrio. */
+ * Valor de Retorno: NENHUM */
 
-int salvaDados (FILE* stream, Imagem3C* img)
+void salvaDados (unsigned char* data, Imagem3C* img)
 {
-	long long i, j;
+	long long i;
 	unsigned long largura_linha, line_padding;
-	unsigned char* linha;
-	unsigned long pos_linha;
 
 	/* Calcula quantos bytes preciso pular no fim de cada linha.
 	  Aqui, cada linha precisa ter um mltiplo de 4. */
-	largura_linha = (unsigned long) ceil (img->largura*3.0/4.0)*4;
+	largura_linha = bytesPorLinha (img->largura, 24);
 	line_padding = largura_linha - (img->largura*3);
-	linha = (unsigned char*) malloc (sizeof (unsigned char) * largura_linha);
 
-    for (i = img->altura-1; i >= 0; i--)
+	for (i = img->altura-1; i >= 0; i--)
 	{
-		pos_linha = 0;
-		for (j = 0; j < img->largura; j++)
-		{
-            linha [pos_linha++] = img->dados [CANAL_B][i][j];
-			linha [pos_linha++] = img->dados [CANAL_G][i][j];
-			linha [pos_linha++] = img->dados [CANAL_R][i][j];
-		}
+		intercalaLinhaBGR (data, img->dados [CANAL_R][i], img->dados [CANAL_G][i], img->dados [CANAL_B][i], img->largura);
+		memset (data + img->largura*3, 0, line_padding);
+		data += largura_linha;
+	}
+}
 
-		for (j = 0; j < line_padding; j++)
-			linha [pos_linha++] = 0;
+/*----------------------------------------------------------------------------*/
+/** Intercala 3 planos (R, G, B) em uma linha BGR. Com SSSE3, 16 pixels so
+ * montados por iterao com 9 pshufb; o resto vai um pixel por vez.
+ *
+ * Parmetros: unsigned char* destino: linha de sada (3*largura bytes).
+ *             unsigned char* r, g, b: linhas de cada canal.
+ *             unsigned long largura: nmero de pixels.
+ *
+ * Valor de Retorno: NENHUM */
 
-		if (fwrite ((void*) linha, 1, largura_linha, stream) != largura_linha)
-		{
-			printf ("Error writing image data.\n");
-			free (linha);
-			return (0);
-		}
+void intercalaLinhaBGR (unsigned char* destino, unsigned char* r, unsigned char* g, unsigned char* b, unsigned long largura)
+{
+	unsigned long j = 0;
+
+#ifdef __SSSE3__
+	const __m128i b0 = _mm_setr_epi8 (0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128, 5);
+	const __m128i g0 = _mm_setr_epi8 (-128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128);
+	const __m128i r0 = _mm_setr_epi8 (-128, -128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128);
+	const __m128i b1 = _mm_setr_epi8 (-128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10, -128);
+	const __m128i g1 = _mm_setr_epi8 (5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10);
+	const __m128i r1 = _mm_setr_epi8 (-128, 5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128);
+	const __m128i b2 = _mm_setr_epi8 (-128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128, -128);
+	const __m128i g2 = _mm_setr_epi8 (-128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128);
+	const __m128i r2 = _mm_setr_epi8 (10, -128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15);
+
+	for (; j + 16 <= largura; j += 16)
+	{
+		__m128i vb = _mm_loadu_si128 ((const __m128i*) (b+j));
+		__m128i vg = _mm_loadu_si128 ((const __m128i*) (g+j));
+		__m128i vr = _mm_loadu_si128 ((const __m128i*) (r+j));
+
+		_mm_storeu_si128 ((__m128i*) (destino+j*3),
+			_mm_or_si128 (_mm_or_si128 (_mm_shuffle_epi8 (vb, b0), _mm_shuffle_epi8 (vg, g0)), _mm_shuffle_epi8 (vr, r0)));
+		_mm_storeu_si128 ((__m128i*) (destino+j*3+16),
+			_mm_or_si128 (_mm_or_si128 (_mm_shuffle_epi8 (vb, b1), _mm_shuffle_epi8 (vg, g1)), _mm_shuffle_epi8 (vr, r1)));
+		_mm_storeu_si128 ((__m128i*) (destino+j*3+32),
+			_mm_or_si128 (_mm_or_si128 (_mm_shuffle_epi8 (vb, b2), _mm_shuffle_epi8 (vg, g2)), _mm_shuffle_epi8 (vr, r2)));
 	}
+#endif
 
-	free (linha);
-	return (1);
+	for (; j < largura; j++)
+	{
+		destino [j*3] = b [j];
+		destino [j*3+1] = g [j];
+		destino [j*3+2] = r [j];
+	}
+}
+
+/*----------------------------------------------------------------------------*/
+/** Escreve o bloco de dados de uma imagem em escala de cinza (8 bpp). Cada
+ * linha da imagem j est no formato do arquivo; s falta o padding.
+ *
+ * Parmetros: unsigned char* data: buffer onde escrever as linhas (com padding).
+ *             Imagem1C* img: imagem a ser salva.
+ *
+ * Valor de Retorno: NENHUM */
+
+void salvaDados1C (unsigned char* data, Imagem1C* img)
+{
+	long long i;
+	unsigned long largura_linha;
+
+	largura_linha = bytesPorLinha (img->largura, 8);
+
+	for (i = img->altura-1; i >= 0; i--)
+	{
+		memcpy (data, img->dados [i], img->largura);
+		memset (data + img->largura, 0, largura_linha - img->largura);
+		data += largura_linha;
+	}
 }
 
 /*============================================================================*/
@@ -0,0 +1,311 @@
+/**
+ * Adaptive Thresholding
+ *
+ * A tabela é montada em duas fases paralelas: somas acumuladas ao longo
+ * de cada linha (threads com faixas de linhas) e depois ao longo das
+ * colunas (threads com faixas de colunas, descendo linha a linha, o que
+ * mantém o acesso contíguo). O threshold de cada pixel também é
+ * calculado por faixas de linhas, que escrevem palavras distintas da
+ * imagem binária.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* File Header */
+#include <pather/limiar.h>
+#include <pather/alloc.h>
+#include <pather/paralelo.h>
+
+/* Faixa dinâmica do desvio padrão no Sauvola */
+#define SAUVOLA_R 128.0
+
+/* Parâmetros padrão (usados quando o chamador passa 0) */
+#define BRADLEY_T 0.15
+#define SAUVOLA_K 0.34
+
+typedef enum
+{
+  FASE_LINHAS,
+  FASE_COLUNAS,
+  FASE_BRADLEY,
+  FASE_SAUVOLA
+} FaseLimiar;
+
+/**
+ * Work Range
+ *
+ * Cada thread recebe um intervalo [inicio, fim) de linhas ou de
+ * colunas, dependendo da fase.
+ */
+typedef struct
+{
+  FaseLimiar fase;
+  Imagem1C *img;
+  ImagemIntegral *integral;
+  ImagemBinaria *bin;
+  unsigned long inicio, fim;
+  unsigned long raio;
+  double parametro;
+} TarefaLimiar;
+
+static void *executa(void *arg);
+
+/**
+ * Run a Phase over Bands
+ *
+ * Divide `total` linhas/colunas entre as threads; a thread atual fica
+ * com a primeira faixa.
+ */
+static void paralelo(TarefaLimiar *modelo, unsigned long total, int n_threads)
+{
+  TarefaLimiar tarefas[PATHER_MAX_THREADS];
+
+  n_threads = parallel_threads(n_threads, total);
+  for (int t = 0; t < n_threads; t++)
+  {
+    tarefas[t] = *modelo;
+    tarefas[t].inicio = total * t / n_threads;
+    tarefas[t].fim = total * (t + 1) / n_threads;
+  }
+
+  parallel_run(executa, tarefas, sizeof(TarefaLimiar), n_threads);
+}
+
+/**
+ * Row Prefix Sums
+ */
+static void soma_linhas(TarefaLimiar *tarefa)
+{
+  ImagemIntegral *integral = tarefa->integral;
+  const unsigned long passo = integral->largura + 1;
+
+  for (unsigned long y = tarefa->inicio; y < tarefa->fim; y++)
+  {
+    const unsigned char *linha = tarefa->img->dados[y];
+    uint32_t *s = integral->soma + (y + 1) * passo;
+    uint32_t acc = 0;
+
+    s[0] = 0;
+    for (unsigned long x = 0; x < integral->largura; x++)
+      s[x + 1] = acc += linha[x];
+
+    if (integral->quadrados)
+    {
+      uint64_t *q = integral->quadrados + (y + 1) * passo;
+      uint64_t acc2 = 0;
+
+      q[0] = 0;
+      for (unsigned long x = 0; x < integral->largura; x++)
+        q[x + 1] = acc2 += (uint64_t)linha[x] * linha[x];
+    }
+  }
+}
+
+/**
+ * Column Prefix Sums
+ *
+ * `inicio` e `fim` são colunas da tabela (de 1 a largura).
+ */
+static void soma_colunas(TarefaLimiar *tarefa)
+{
+  ImagemIntegral *integral = tarefa->integral;
+  const unsigned long passo = integral->largura + 1;
+
+  for (unsigned long y = 2; y <= integral->altura; y++)
+  {
+    uint32_t *s = integral->soma + y * passo;
+    const uint32_t *acima = s - passo;
+
+    for (unsigned long x = tarefa->inicio + 1; x < tarefa->fim + 1; x++)
+      s[x] += acima[x];
+
+    if (integral->quadrados)
+    {
+      uint64_t *q = integral->quadrados + y * passo;
+      const uint64_t *q_acima = q - passo;
+
+      for (unsigned long x = tarefa->inicio + 1; x < tarefa->fim + 1; x++)
+        q[x] += q_acima[x];
+    }
+  }
+}
+
+/**
+ * Threshold Rows
+ *
+ * A janela é cortada nas bordas da imagem e a área usada é a da parte
+ * que sobrou.
+ */
+static void limiariza(TarefaLimiar *tarefa, int sauvola)
+{
+  ImagemIntegral *integral = tarefa->integral;
+  ImagemBinaria *bin = tarefa->bin;
+  const unsigned long w = integral->largura, h = integral->altura, passo = w + 1, r = tarefa->raio;
+
+  for (unsigned long y = tarefa->inicio; y < tarefa->fim; y++)
+  {
+    const unsigned long y0 = y > r ? y - r : 0, y1 = y + r + 1 < h ? y + r + 1 : h;
+    const uint32_t *s0 = integral->soma + y0 * passo, *s1 = integral->soma + y1 * passo;
+    const unsigned char *linha = tarefa->img->dados[y];
+    uint64_t *saida = bin->dados + y * bin->palavras;
+
+    for (unsigned long x = 0; x < w; x++)
+    {
+      const unsigned long x0 = x > r ? x - r : 0, x1 = x + r + 1 < w ? x + r + 1 : w;
+      const unsigned long area = (x1 - x0) * (y1 - y0);
+      const uint32_t soma = s1[x1] - s1[x0] - s0[x1] + s0[x0];
+      int escuro;
+
+      if (sauvola)
+      {
+        const uint64_t *q0 = integral->quadrados + y0 * passo, *q1 = integral->quadrados + y1 * passo;
+        const double quadrados = (double)(q1[x1] - q1[x0] - q0[x1] + q0[x0]);
+        const double media = (double)soma / area;
+        const double variancia = quadrados / area - media * media;
+        const double desvio = variancia > 0 ? sqrt(variancia) : 0;
+
+        escuro = linha[x] <= media * (1.0 + tarefa->parametro * (desvio / SAUVOLA_R - 1.0));
+      }
+      else
+        escuro = (double)linha[x] * area <= (double)soma * (1.0 - tarefa->parametro);
+
+      saida[x / 64] |= (uint64_t)escuro << (x % 64);
+    }
+  }
+}
+
+static void *executa(void *arg)
+{
+  TarefaLimiar *tarefa = (TarefaLimiar *)arg;
+
+  switch (tarefa->fase)
+  {
+    case FASE_LINHAS:  soma_linhas(tarefa); break;
+    case FASE_COLUNAS: soma_colunas(tarefa); break;
+    case FASE_BRADLEY: limiariza(tarefa, 0); break;
+    case FASE_SAUVOLA: limiariza(tarefa, 1); break;
+  }
+
+  return NULL;
+}
+
+/**
+ * Build the Summed-area Tables
+ *
+ * @param  img        imagem de entrada
+ * @param  quadrados  também monta a tabela dos quadrados
+ * @param  n_threads  threads a usar; 0 usa um por processador
+ * @return            as tabelas, ou NULL se faltar memória
+ */
+ImagemIntegral *integral_create(Imagem1C *img, int quadrados, int n_threads)
+{
+  const size_t celulas = (size_t)(img->largura + 1) * (img->altura + 1);
+  TarefaLimiar modelo;
+  ImagemIntegral *integral;
+
+  integral = (ImagemIntegral *)pather_malloc(sizeof(ImagemIntegral));
+  if (!integral)
+    return NULL;
+
+  integral->largura = img->largura;
+  integral->altura = img->altura;
+  integral->soma = (uint32_t *)pather_malloc(celulas * sizeof(uint32_t));
+  integral->quadrados = quadrados ? (uint64_t *)pather_malloc(celulas * sizeof(uint64_t)) : NULL;
+  if (!integral->soma || (quadrados && !integral->quadrados))
+  {
+    integral_destroy(integral);
+    return NULL;
+  }
+
+  /* Linha 0 zerada; a coluna 0 é zerada junto com as somas das linhas */
+  memset(integral->soma, 0, (img->largura + 1) * sizeof(uint32_t));
+  if (quadrados)
+    memset(integral->quadrados, 0, (img->largura + 1) * sizeof(uint64_t));
+
+  memset(&modelo, 0, sizeof(modelo));
+  modelo.img = img;
+  modelo.integral = integral;
+
+  modelo.fase = FASE_LINHAS;
+  paralelo(&modelo, img->altura, n_threads);
+  modelo.fase = FASE_COLUNAS;
+  paralelo(&modelo, img->largura, n_threads);
+
+  return integral;
+}
+
+void integral_destroy(ImagemIntegral *integral)
+{
+  if (!integral)
+    return;
+
+  pather_free(integral->soma);
+  pather_free(integral->quadrados);
+  pather_free(integral);
+}
+
+/**
+ * Threshold with a Local Window
+ */
+static ImagemBinaria *limiar_local(Imagem1C *img, int janela, double parametro, FaseLimiar fase, int n_threads)
+{
+  TarefaLimiar modelo;
+  ImagemIntegral *integral;
+  ImagemBinaria *bin;
+
+  /* Janela padrão de Bradley: um oitavo da largura */
+  if (janela <= 0)
+    janela = (int)(img->largura / 8) | 1;
+
+  bin = bin_create(img->largura, img->altura);
+  if (!bin)
+    return NULL;
+
+  integral = integral_create(img, fase == FASE_SAUVOLA, n_threads);
+  if (!integral)
+  {
+    bin_destroy(bin);
+    return NULL;
+  }
+
+  memset(&modelo, 0, sizeof(modelo));
+  modelo.fase = fase;
+  modelo.img = img;
+  modelo.integral = integral;
+  modelo.bin = bin;
+  modelo.raio = (unsigned long)janela / 2;
+  modelo.parametro = parametro;
+  paralelo(&modelo, img->altura, n_threads);
+
+  integral_destroy(integral);
+  return bin;
+}
+
+/**
+ * Bradley Thresholding
+ *
+ * @param  img       imagem de entrada
+ * @param  janela    lado da janela em pixels (0 usa largura / 8)
+ * @param  t         fração abaixo da média para ser escuro (0 usa 0.15)
+ * @param  n_threads threads a usar; 0 usa um por processador
+ * @return           imagem binária com os pixels escuros ligados, ou NULL
+ */
+ImagemBinaria *threshold_bradley(Imagem1C *img, int janela, double t, int n_threads)
+{
+  return limiar_local(img, janela, t > 0 ? t : BRADLEY_T, FASE_BRADLEY, n_threads);
+}
+
+/**
+ * Sauvola Thresholding
+ *
+ * @param  k sensibilidade ao desvio padrão local (0 usa 0.34)
+ */
+ImagemBinaria *threshold_sauvola(Imagem1C *img, int janela, double k, int n_threads)
+{
+  return limiar_local(img, janela, k > 0 ? k : SAUVOLA_K, FASE_SAUVOLA, n_threads);
+}
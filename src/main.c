@@ -8,12 +8,22 @@
  * for better results, and run some filters.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 /* Standard Library */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 
 /* Project Header */
 #include <pather/pather.h>
+#include <pather/alloc.h>
+#include <pather/overlay.h>
+#include <pather/avaliacao.h>
+#include <pather/sequencia.h>
+#include <pather/mascaras.h>
+#include <pather/codec.h>
 
 /*============================================================================*/
 
@@ -34,38 +44,418 @@ char* ARQUIVOS [] =
 
 /*============================================================================*/
 
-void criaMatrizDT (Imagem1C* img);
-void preencheMatrizDT (Imagem1C* img, int row, int col);
-long testaCaminho (Coordenada* caminho, int n, Imagem1C* dt);
+/* Formatos do caminho na sada padro */
+#define SAIDA_RESUMO  0 /* S o resumo, e o caminho pintado em out.bmp */
+#define SAIDA_TEXTO   1 /* Uma linha "x y" por coordenada */
+#define SAIDA_BINARIA 2 /* Cabealho e pares em little endian */
+#define SAIDA_DELTA   3 /* Caminho codificado pelo codec.h, com checksum */
+
+/* De onde vem a imagem e para onde vai o caminho */
+typedef struct {
+	char* arquivo;                 /* NULL quando a imagem vem de um descritor */
+	int fd;                        /* Descritor lido quando arquivo  NULL */
+	unsigned long largura, altura; /* Tamanho da imagem crua, ou 0 para BMP */
+	int saida;
+} Entrada;
+
+static int leArgumentos(int argc, char** argv, Entrada* e)
+{
+	e->arquivo = "../img/TESTE3.BMP";
+	e->fd = 0;
+	e->largura = e->altura = 0;
+	e->saida = SAIDA_RESUMO;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-") == 0) {
+			e->arquivo = NULL;
+			e->fd = 0;
+		} else if (strcmp(argv[i], "--fd") == 0 && i + 1 < argc) {
+			e->arquivo = NULL;
+			e->fd = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--raw") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%lux%lu", &e->largura, &e->altura) != 2 || !e->largura || !e->altura)
+				return 0;
+		} else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "text") == 0)
+				e->saida = SAIDA_TEXTO;
+			else if (strcmp(argv[i], "binary") == 0)
+				e->saida = SAIDA_BINARIA;
+			else if (strcmp(argv[i], "delta") == 0)
+				e->saida = SAIDA_DELTA;
+			else
+				return 0;
+		} else if (argv[i][0] == '-') {
+			return 0;
+		} else {
+			e->arquivo = argv[i];
+		}
+	}
+	return 1;
+}
+
+/* L a imagem de um arquivo ou, sem voltar no fluxo, de um descritor */
+static Imagem1C* abreEntrada(const Entrada* e)
+{
+	Imagem1C* img;
+	FILE* stream;
+
+	if (e->arquivo && !e->largura)
+		return abreImagem1C(e->arquivo);
+
+	if (e->arquivo)
+		stream = fopen(e->arquivo, "rb");
+	else
+		stream = e->fd == 0 ? stdin : fdopen(e->fd, "rb");
+	if (!stream)
+		return NULL;
+
+	img = e->largura ? leImagem1CBruta(stream, e->largura, e->altura) : leImagem1C(stream);
+	if (stream != stdin)
+		fclose(stream);
+	return img;
+}
+
+static void escreveLE(FILE* saida, uint64_t v, int bytes)
+{
+	unsigned char b[8];
+	for (int i = 0; i < bytes; i++)
+		b[i] = (unsigned char)(v >> (8 * i));
+	fwrite(b, 1, bytes, saida);
+}
+
+/* Binrio: n (uint32) e custo (int64), seguidos de n pares x, y (uint32) */
+static int escreveCaminho(FILE* saida, const Coordenada* caminho, int n, long custo, int formato)
+{
+	if (formato == SAIDA_DELTA) {
+		size_t tamanho = path_encoded_size(n, CODEC_CHECKSUM);
+		unsigned char* dados = malloc(tamanho);
+		int ok = dados && path_encode(caminho, n, custo, CODEC_CHECKSUM, dados) &&
+		         fwrite(dados, 1, tamanho, saida) == tamanho;
+		free(dados);
+		if (!ok)
+			return 0;
+	} else if (formato == SAIDA_BINARIA) {
+		escreveLE(saida, (uint32_t)n, 4);
+		escreveLE(saida, (uint64_t)(int64_t)custo, 8);
+		for (int i = 0; i < n; i++) {
+			escreveLE(saida, (uint32_t)caminho[i].x, 4);
+			escreveLE(saida, (uint32_t)caminho[i].y, 4);
+		}
+	} else {
+		for (int i = 0; i < n; i++)
+			fprintf(saida, "%d %d\n", caminho[i].x, caminho[i].y);
+	}
+	return fflush(saida) == 0 && !ferror(saida);
+}
+
+/* Pinta o caminho de vermelho; sem a cpia com patch quando a entrada 
+   8bpp (o vermelho no existe na paleta), decodifica e salva em 24bpp */
+static int salvaCaminho(char* origem, char* destino, Coordenada* caminho, int n)
+{
+	Imagem3C* out;
+	int ok;
+
+	if (salvaCaminhoSobreposto(origem, destino, caminho, n))
+		return 1;
+
+	out = abreImagem3C(origem);
+	if (!out)
+		return 0;
+	for (int c = 0; c < n; c++) {
+		out->dados[0][caminho[c].y][caminho[c].x] = 255;
+		out->dados[1][caminho[c].y][caminho[c].x] = 0;
+		out->dados[2][caminho[c].y][caminho[c].x] = 0;
+	}
+	ok = salvaImagem3C(out, destino);
+	destroiImagem3C(out);
+	return ok;
+}
 
 /*============================================================================*/
 
-int main(void)
+static int processaSequencia(const char* padrao, const PatherConfig* config)
+{
+	char nome [4096];
+	Sequencia* seq = NULL;
+	int raio = getenv("PATHER_SEQ_RADIUS") ? atoi(getenv("PATHER_SEQ_RADIUS")) : 8;
+	double salto = getenv("PATHER_SEQ_JUMP") ? atof(getenv("PATHER_SEQ_JUMP")) : 0.25;
+	int i;
+
+	/* Os frames vo direto para o solver, sem as etapas do pipeline */
+	if (config->prefilter != PATHER_PREFILTER_NONE || config->gap_length > 0 ||
+	    config->threshold != PATHER_THRESHOLD_NONE || config->close_radius > 0 ||
+	    config->min_component > 0 || config->restrict_components ||
+	    config->solver != PATHER_SOLVER_DIJKSTRA) {
+		fprintf(stderr, "O modo sequencia nao aceita PATHER_PREFILTER, PATHER_GAP_LENGTH, "
+		                "PATHER_THRESHOLD, PATHER_CLOSE_RADIUS, PATHER_MIN_COMPONENT, "
+		                "PATHER_RESTRICT nem PATHER_SOLVER\n");
+		return 2;
+	}
+
+	for (i = 0; ; i++)
+	{
+		Imagem1C* img;
+		Coordenada* caminho;
+		long custo;
+		int n;
+
+		snprintf(nome, sizeof(nome), padrao, i);
+		img = abreImagem1C (nome);
+		if (!img)
+			break;
+
+		if (!seq && !(seq = seq_create(img->largura, img->altura, raio, salto))) {
+			fprintf(stderr, "Sem memoria para a sequencia\n");
+			destroiImagem1C(img);
+			return 1;
+		}
+
+		n = seq_frame(seq, img, &caminho, &custo);
+		if (n < 0)
+			printf("Frame %d: nao foi possivel encontrar um caminho\n", i);
+		else
+			printf("Frame %d: caminho com %d coordenadas, custo %ld\n", i, n, custo);
+
+		free(caminho);
+		destroiImagem1C(img);
+	}
+
+	seq_destroy(seq);
+	printf("%d frames, memoria: pico de %zu bytes\n", i, mem_peak());
+	return 0;
+}
+
+static int processaFaixas(const Entrada* e, const PatherConfig* config, long n_faixas)
+{
+	Imagem1C* img = abreEntrada(e);
+	ConsultaCaminho* consultas;
+	Coordenada* pontos;
+	int i;
+
+	if (!img) {
+		fprintf(stderr, "Nao foi possivel abrir o arquivo\n");
+		return 1;
+	}
+	if ((unsigned long)n_faixas > img->altura)
+		n_faixas = (long)img->altura;
+
+	/* Cada faixa liga as suas linhas da coluna da esquerda s da direita */
+	consultas = calloc(n_faixas, sizeof(ConsultaCaminho));
+	pontos = malloc(2 * img->altura * sizeof(Coordenada));
+	if (!consultas || !pontos) {
+		fprintf(stderr, "Sem memoria para as consultas\n");
+		free(consultas);
+		free(pontos);
+		destroiImagem1C(img);
+		return 1;
+	}
+	for (unsigned long y = 0; y < img->altura; y++) {
+		pontos[y].x = 0;
+		pontos[y].y = y;
+		pontos[img->altura + y].x = img->largura - 1;
+		pontos[img->altura + y].y = y;
+	}
+	for (i = 0; i < n_faixas; i++) {
+		int y0 = (int)((long)img->altura * i / n_faixas);
+		int y1 = (int)((long)img->altura * (i + 1) / n_faixas);
+		consultas[i].origens = pontos + y0;
+		consultas[i].destinos = pontos + img->altura + y0;
+		consultas[i].n_origens = consultas[i].n_destinos = y1 - y0;
+	}
+
+	encontraCaminhos(img, consultas, (int)n_faixas, config);
+	for (i = 0; i < n_faixas; i++) {
+		if (consultas[i].n == PATHER_SEM_MEMORIA)
+			printf("Faixa %d: orcamento de memoria excedido\n", i);
+		else if (consultas[i].n < 0)
+			printf("Faixa %d: nao foi possivel encontrar um caminho\n", i);
+		else
+			printf("Faixa %d: caminho com %d coordenadas, custo %ld\n", i, consultas[i].n, consultas[i].custo);
+		free(consultas[i].caminho);
+	}
+
+	free(pontos);
+	free(consultas);
+	destroiImagem1C(img);
+	printf("Memoria: pico de %zu bytes\n", mem_peak());
+	return 0;
+}
+
+int main(int argc, char** argv)
 {
 	/* Store the steps */
 	Coordenada* caminho; 
+	long custo;
+
+	/* A imagem  o arquivo BMP dado (../img/TESTE3.BMP se nenhum for), ou
+	   vem da entrada padro ("-") ou de um descritor (--fd N), lida s para
+	   a frente e convertida linha a linha conforme chega. Com --raw LxA, a
+	   entrada  cinza cru, L x A bytes de cima para baixo. Com
+	   --output text|binary|delta, o caminho vai para a sada padro (delta
+	    o formato compacto do codec.h), e o resumo para a sada de erro */
+	Entrada entrada;
+	if (!leArgumentos(argc, argv, &entrada)) {
+		fprintf(stderr, "Uso: %s [arquivo.bmp | - | --fd N] [--raw LxA] [--output text|binary|delta]\n", argv[0]);
+		return 2;
+	}
+	FILE* resumo = entrada.saida == SAIDA_RESUMO ? stdout : stderr;
+
+	/* Opes do pipeline; o cache de resultados  opcional
+	   (PATHER_CACHE_DIR, limitado por PATHER_CACHE_MAX), assim como o
+	   pr-filtro (PATHER_PREFILTER=gaussian|median, com PATHER_SIGMA ou
+	   PATHER_MEDIAN_RADIUS), a abertura em cinza que completa as falhas (PATHER_GAP_LENGTH) e a
+	   binarizao (PATHER_THRESHOLD=otsu|bradley|sauvola|canny, com
+	   PATHER_THRESHOLD_WINDOW e PATHER_THRESHOLD_K, ou PATHER_CANNY_LOW e
+	   PATHER_CANNY_HIGH), seguida de fechamento
+	   (PATHER_CLOSE_RADIUS) e da poda de componentes (PATHER_MIN_COMPONENT,
+	   PATHER_RESTRICT). O dump de depurao da imagem filtrada s  gravado
+	   com PATHER_DUMP=arquivo.bmp, e a mscara do filtro desse dump 
+	   escolhida por PATHER_KERNEL (sobel_x, sobel_y, scharr_x, scharr_y,
+	   prewitt_x, prewitt_y). Com PATHER_ROI=x0,y0,largura,altura, s essa
+	   regio do arquivo  decodificada e processada; com PATHER_SCALE=2|4|8,
+	   a imagem  reduzida na leitura (PATHER_SCALE_MODE=min|box) para uma
+	   busca grosseira, sem gerar a sada. PATHER_LAYOUT=tiles guarda as
+	   grades do Dijkstra em blocos, e PATHER_HUGE_PAGES=1 pede pginas
+	   enormes para elas */
+	PatherConfig config;
+	pather_config_default(&config);
+	if (getenv("PATHER_PREFILTER")) {
+		if (strcmp(getenv("PATHER_PREFILTER"), "gaussian") == 0)
+			config.prefilter = PATHER_PREFILTER_GAUSSIAN;
+		else if (strcmp(getenv("PATHER_PREFILTER"), "median") == 0)
+			config.prefilter = PATHER_PREFILTER_MEDIAN;
+	}
+	if (getenv("PATHER_SIGMA"))
+		config.prefilter_sigma = atof(getenv("PATHER_SIGMA"));
+	if (getenv("PATHER_MEDIAN_RADIUS"))
+		config.prefilter_radius = atoi(getenv("PATHER_MEDIAN_RADIUS"));
+	if (getenv("PATHER_GAP_LENGTH"))
+		config.gap_length = atoi(getenv("PATHER_GAP_LENGTH"));
+	if (getenv("PATHER_THRESHOLD")) {
+		if (strcmp(getenv("PATHER_THRESHOLD"), "otsu") == 0)
+			config.threshold = PATHER_THRESHOLD_OTSU;
+		else if (strcmp(getenv("PATHER_THRESHOLD"), "bradley") == 0)
+			config.threshold = PATHER_THRESHOLD_BRADLEY;
+		else if (strcmp(getenv("PATHER_THRESHOLD"), "sauvola") == 0)
+			config.threshold = PATHER_THRESHOLD_SAUVOLA;
+		else if (strcmp(getenv("PATHER_THRESHOLD"), "canny") == 0)
+			config.threshold = PATHER_THRESHOLD_CANNY;
+	}
+	if (getenv("PATHER_THRESHOLD_WINDOW"))
+		config.threshold_window = atoi(getenv("PATHER_THRESHOLD_WINDOW"));
+	if (getenv("PATHER_THRESHOLD_K"))
+		config.threshold_k = atof(getenv("PATHER_THRESHOLD_K"));
+	if (getenv("PATHER_CANNY_LOW"))
+		config.canny_low = atoi(getenv("PATHER_CANNY_LOW"));
+	if (getenv("PATHER_CANNY_HIGH"))
+		config.canny_high = atoi(getenv("PATHER_CANNY_HIGH"));
+	if (getenv("PATHER_CLOSE_RADIUS"))
+		config.close_radius = atoi(getenv("PATHER_CLOSE_RADIUS"));
+	if (getenv("PATHER_MIN_COMPONENT"))
+		config.min_component = atoi(getenv("PATHER_MIN_COMPONENT"));
+	if (getenv("PATHER_RESTRICT"))
+		config.restrict_components = atoi(getenv("PATHER_RESTRICT"));
+	if (getenv("PATHER_KERNEL") && !mask_from_name(getenv("PATHER_KERNEL"), &config.kernel))
+		fprintf(stderr, "Mascara desconhecida: %s\n", getenv("PATHER_KERNEL"));
+	if (getenv("PATHER_SOLVER") && strcmp(getenv("PATHER_SOLVER"), "skeleton") == 0)
+		config.solver = PATHER_SOLVER_SKELETON;
+	if (getenv("PATHER_LAYOUT") && strcmp(getenv("PATHER_LAYOUT"), "tiles") == 0)
+		config.layout = PATHER_LAYOUT_TILES;
+	if (getenv("PATHER_HUGE_PAGES"))
+		config.huge_pages = atoi(getenv("PATHER_HUGE_PAGES"));
+	config.cache_dir = getenv("PATHER_CACHE_DIR");
+	config.debug_dump = getenv("PATHER_DUMP");
+	if (getenv("PATHER_CACHE_MAX"))
+		config.cache_max_bytes = mem_parse_size(getenv("PATHER_CACHE_MAX"));
+
+	/* Oramento de memria do job (PATHER_MEM_BUDGET, ex.: 64M) */
+	mem_job_begin(mem_budget_from_env());
+
+	/* Modo sequncia: PATHER_SEQUENCE  um padro printf com o nmero do
+	   frame (ex.: frames/%04d.bmp), lido at o primeiro arquivo que falta.
+	   A faixa em torno do caminho anterior tem raio PATHER_SEQ_RADIUS e
+	   alarga quando o custo sobe mais que PATHER_SEQ_JUMP. Os frames no
+	   passam pelo pr-processamento, ento as opes do pipeline so
+	   recusadas nesse modo */
+	if (getenv("PATHER_SEQUENCE"))
+		return processaSequencia(getenv("PATHER_SEQUENCE"), &config);
+
+	/* Modo faixas: PATHER_BANDS=k divide a imagem em k faixas horizontais
+	   e busca um caminho em cada uma, todas sobre o mesmo mapa de custo */
+	if (getenv("PATHER_BANDS")) {
+		char* fim;
+		long n_faixas = strtol(getenv("PATHER_BANDS"), &fim, 10);
+		if (fim == getenv("PATHER_BANDS") || *fim != '\0' || n_faixas <= 0) {
+			fprintf(stderr, "PATHER_BANDS deve ser um inteiro positivo: %s\n", getenv("PATHER_BANDS"));
+			return 2;
+		}
+		return processaFaixas(&entrada, &config, n_faixas);
+	}
 
-	/* Store the image */
-	Imagem1C* img;
-	img = abreImagem1C ("../img/TESTE3.BMP");
-	if (!img) {
-		printf("Nao foi possivel abrir o arquivo\n");
+	/* Process the file. A regio e a reduo precisam de um arquivo BMP,
+	   e so ignoradas nas outras entradas */
+	int n_coordenadas;
+	int bmp = entrada.arquivo && !entrada.largura;
+	unsigned long roi[4];
+	int escala = getenv("PATHER_SCALE") ? atoi(getenv("PATHER_SCALE")) : 1;
+	int reducao = getenv("PATHER_SCALE_MODE") && strcmp(getenv("PATHER_SCALE_MODE"), "box") == 0 ?
+	              REDUCAO_MEDIA : REDUCAO_MINIMO;
+	if (!bmp)
+		escala = 1;
+	if (bmp && escala <= 1 && getenv("PATHER_ROI") &&
+	    sscanf(getenv("PATHER_ROI"), "%lu,%lu,%lu,%lu", &roi[0], &roi[1], &roi[2], &roi[3]) == 4) {
+		n_coordenadas = encontraCaminhoRegiao(entrada.arquivo, roi[0], roi[1], roi[2], roi[3],
+		                                      &caminho, &custo, &config);
+	} else {
+		/* Store the image */
+		Imagem1C* img;
+		if (escala > 1)
+			img = abreImagem1CReduzida (entrada.arquivo, escala, reducao);
+		else
+			img = abreEntrada(&entrada);
+		if (!img) {
+			fprintf(stderr, "Nao foi possivel abrir o arquivo\n");
+			return 1;
+		}
+
+		n_coordenadas = encontraCaminhoConfig(img, &caminho, &custo, &config);
+		destroiImagem1C(img);
+	}
+	if (n_coordenadas == PATHER_SEM_MEMORIA) {
+		if (mem_budget_from_env())
+			fprintf(stderr, "Orcamento de memoria excedido: o solver nao coube em PATHER_MEM_BUDGET\n");
+		else
+			fprintf(stderr, "Sem memoria para o solver\n");
 		return 1;
 	}
+	if (n_coordenadas < 0) {
+		fprintf(stderr, "Nao foi possivel encontrar um caminho\n");
+		return 1;
+	}
+	fprintf(resumo, "Caminho com %d coordenadas, custo %ld\n", n_coordenadas, custo);
+
+	/* Pinta o caminho numa cpia da entrada, ou o envia pela sada padro */
+	int ok = 1;
+	if (entrada.saida != SAIDA_RESUMO)
+		ok = escreveCaminho(stdout, caminho, n_coordenadas, custo, entrada.saida);
+	else if (SALVA_SAIDA && bmp && escala <= 1 && !salvaCaminho (entrada.arquivo, "out.bmp", caminho, n_coordenadas))
+		fprintf(stderr, "Nao foi possivel salvar a saida\n");
+	if (!ok)
+		fprintf(stderr, "Nao foi possivel escrever o caminho\n");
 
-	/* Process the file */
-	int n_coordenadas = encontraCaminho(img, &caminho);
+	free(caminho);
+	fprintf(resumo, "Memoria: pico de %zu bytes\n", mem_peak());
 
 	/* Return to operating system */
-	return 0;
+	return ok ? 0 : 1;
 }
 
 // int main ()
 // {
 //     int i, n_coordenadas;
 //     Imagem1C* img; /* A imagem de entrada. */
-//     Imagem1C* img_dt; /* Matriz da transformada de distncia. */
-//     Imagem3C* out; /* A imagem de sada. */
+//     MatrizDT* dt; /* Transformada de distncia, reaproveitada do arquivo .dt. */
 //     Coordenada* caminho; /* O caminho descoberto. */
 //     char nome_saida [25]; /* String usada para salvar as sadas. */
 //     unsigned long score;
@@ -82,33 +472,23 @@ int main(void)
 //             return (1);
 //         }
 
-//         /* Cria a imagem da transformada de distncia. */
-//         img_dt = abreImagem1C (ARQUIVOS [i]);
-//         criaMatrizDT (img_dt);
+//         /* Abre a transformada de distncia (calculada s na primeira vez). */
+//         dt = abreMatrizDT (ARQUIVOS [i]);
 
 //         n_coordenadas = encontraCaminho (img, &caminho);
 
 //         /* Testa se este caminho  um caminho vlido, e calcula o score. */
-//         score = testaCaminho (caminho, n_coordenadas, img_dt);
+//         score = testaCaminho (caminho, n_coordenadas, dt->img);
 //         fprintf (out_file, "%ld\n", score);
 
 //         if (SALVA_SAIDA)
 //         {
-//             int c;
-//             out = abreImagem3C (ARQUIVOS [i]);
-//             for (c = 0; c < n_coordenadas; c++)
-//             {
-//                 out->dados [0][caminho [c].y][caminho [c].x] = 255;
-//                 out->dados [1][caminho [c].y][caminho [c].x] = 0;
-//                 out->dados [2][caminho [c].y][caminho [c].x] = 0;
-//             }
-
+//             /* Copia a entrada e pinta s os pixels do caminho. */
 //             sprintf (nome_saida, "out%d.bmp", i);
-//             salvaImagem3C (out, nome_saida);
-//             destroiImagem3C (out);
+//             salvaCaminho (ARQUIVOS [i], nome_saida, caminho, n_coordenadas);
 //         }
 
-//         destroiImagem1C (img_dt);
+//         liberaMatrizDT (dt);
 //         destroiImagem1C (img);
 //         free (caminho);
 //     }
@@ -118,103 +498,4 @@ int main(void)
 //     return (0);
 // }
 
-/*----------------------------------------------------------------------------*/
-/** Cria uma matriz com a transformada da distncia de uma imagem. Para gerar
- * um score automaticamente para fotografias sem entregar uma soluo para o
- * problema original, subverti o conceito da DT normal. Esta DT funciona mesmo
- * se a imagem no tiver apenas bordas. Por outro lado, o algoritmo  pesado
- * e consome bastante memria... Alm disso, para manter tudo em uma imagem,
- * a distncia mxima  255 (para esta aplicao, serve). Considerei aqui a
- * distncia L1 (Manhattan). */
-
-void criaMatrizDT (Imagem1C* img)
-{
-    int i, j, menor;
-
-    /* Acha o menor valor. */
-    menor = 255;
-    for (i = 0; i < img->altura; i++)
-        for (j = 0; j < img->largura; j++)
-            if (img->dados [i][j] < menor)
-                menor = img->dados [i][j];
-
-    /* "Puxa" todos os valores para baixo, de forma que o mnimo seja = 0. */
-    for (i = 0; i < img->altura; i++)
-        for (j = 0; j < img->largura; j++)
-            img->dados [i][j] -= menor;
-
-    /* Percorre a imagem inteira, procura pontos que meream ateno, e ajusta as distncias recursivamente. */
-    for (i = 0; i < img->altura; i++)
-        for (j = 0; j < img->largura; j++)
-            preencheMatrizDT (img, i, j);
-}
-
-/*----------------------------------------------------------------------------*/
-/* Sub-funo recursiva para preencher a matriz. */
-
-void preencheMatrizDT (Imagem1C* img, int row, int col)
-{
-    if (img->dados [row][col] == 255)
-        return; /* No tem como melhorar a partir deste ponto! */
-
-    /* Esquerda */
-    if (col > 0 && img->dados [row][col-1] > img->dados [row][col] + 1)
-    {
-        img->dados [row][col-1] = img->dados [row][col]+1;
-        preencheMatrizDT (img, row, col-1);
-    }
-
-    /* Direita */
-    if (col < img->largura-1 && img->dados [row][col+1] > img->dados [row][col] + 1)
-    {
-        img->dados [row][col+1] = img->dados [row][col]+1;
-        preencheMatrizDT (img, row, col+1);
-    }
-
-    /* Acima */
-    if (row > 0 && img->dados [row-1][col] > img->dados [row][col] + 1)
-    {
-        img->dados [row-1][col] = img->dados [row][col]+1;
-        preencheMatrizDT (img, row-1, col);
-    }
-
-    /* Abaixo */
-    if (row < img->altura-1 && img->dados [row+1][col] > img->dados [row][col] + 1)
-    {
-        img->dados [row+1][col] = img->dados [row][col]+1;
-        preencheMatrizDT (img, row+1, col);
-    }
-}
-
-/*----------------------------------------------------------------------------*/
-/* Testa um caminho. Computa um score para o mesmo. Um fracasso faz a funo
- * retornar -1. Os scores no fazem sentido isoladamente, eles sero
- * posteriormente normalizados pelo desempenho dos programas testados. */
-
-long testaCaminho (Coordenada* caminho, int n, Imagem1C* dt)
-{
-    int c, vizinho_em_x, vizinho_em_y;
-    unsigned long score;
-
-    /* Verifica se o caminho  longo o suficiente, se comea na coluna da esquerda e termina na coluna da direita. */
-    if (n < dt->largura || caminho [0].x != 0 || caminho [n-1].x != dt->largura-1)
-        return (-1);
-
-    /* Verifica se todos os pontos so vizinhos. */
-    for (c = 1; c < n; c++)
-    {
-        vizinho_em_x = caminho [c].x == caminho [c-1].x-1 || caminho [c].x == caminho [c-1].x+1;
-        vizinho_em_y = caminho [c].y == caminho [c-1].y-1 || caminho [c].y == caminho [c-1].y+1;
-
-        if ((!vizinho_em_x && !vizinho_em_y) || (vizinho_em_x && vizinho_em_y))
-            return (-1);
-    }
-
-    /* Calcula o score para este caminho. */
-    score = 0;
-    for (c = 0; c < n; c++)
-        score += dt->dados [caminho [c].y][caminho [c].x];
-    return (score);
-}
-
 /*============================================================================*/
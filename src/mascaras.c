@@ -0,0 +1,145 @@
+/**
+ * Fixed 3x3 Masks
+ *
+ * `KERNEL_MASCARA` gera os dois kernels de cada máscara. Os termos são
+ * escritos com o coeficiente como constante: `if ((c) == 0)` e
+ * companhia são resolvidos na compilação, então cada kernel só tem as
+ * somas dos coeficientes que não são zero.
+ */
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* File Header */
+#include <pather/mascaras.h>
+
+/* Termo escalar: a multiplicação por uma constante 0 é dobrada */
+#define TERMO(c, v) ((c) * (int)(v))
+
+#ifdef __SSE2__
+
+/* Oito pixels de `p` em int16 */
+#define CARREGA(p) _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(p)), _mm_setzero_si128())
+
+#define TERMO_SSE(s, c, p)                                                       \
+  do                                                                             \
+  {                                                                              \
+    if ((c) == 1)                                                                \
+      s = _mm_add_epi16(s, CARREGA(p));                                          \
+    else if ((c) == -1)                                                          \
+      s = _mm_sub_epi16(s, CARREGA(p));                                          \
+    else if ((c) != 0)                                                           \
+      s = _mm_add_epi16(s, _mm_mullo_epi16(CARREGA(p), _mm_set1_epi16((c))));    \
+  } while (0)
+
+/* Oito pixels por vez, enquanto couberem na linha */
+#define LACO_SSE(c00, c01, c02, c10, c11, c12, c20, c21, c22)                   \
+  for (; x + 8 < largura; x += 8)                                                \
+  {                                                                              \
+    __m128i s = _mm_setzero_si128();                                             \
+    TERMO_SSE(s, c00, r0 + x - 1); TERMO_SSE(s, c01, r0 + x); TERMO_SSE(s, c02, r0 + x + 1); \
+    TERMO_SSE(s, c10, r1 + x - 1); TERMO_SSE(s, c11, r1 + x); TERMO_SSE(s, c12, r1 + x + 1); \
+    TERMO_SSE(s, c20, r2 + x - 1); TERMO_SSE(s, c21, r2 + x); TERMO_SSE(s, c22, r2 + x + 1); \
+    _mm_storeu_si128((__m128i *)(g + x), s);                                     \
+  }
+
+#else
+#define LACO_SSE(c00, c01, c02, c10, c11, c12, c20, c21, c22)
+#endif
+
+#define KERNEL_MASCARA(nome, c00, c01, c02, c10, c11, c12, c20, c21, c22)         \
+  static void nome##_linha(const unsigned char *r0, const unsigned char *r1,     \
+                           const unsigned char *r2, int16_t *g, unsigned long largura) \
+  {                                                                              \
+    unsigned long x = 1;                                                         \
+    LACO_SSE(c00, c01, c02, c10, c11, c12, c20, c21, c22)                       \
+    for (; x + 1 < largura; x++)                                                 \
+      g[x] = (int16_t)(TERMO(c00, r0[x - 1]) + TERMO(c01, r0[x]) + TERMO(c02, r0[x + 1]) + \
+                       TERMO(c10, r1[x - 1]) + TERMO(c11, r1[x]) + TERMO(c12, r1[x + 1]) + \
+                       TERMO(c20, r2[x - 1]) + TERMO(c21, r2[x]) + TERMO(c22, r2[x + 1])); \
+  }                                                                              \
+                                                                                 \
+  static int nome##_ponto(unsigned char **b)                                     \
+  {                                                                              \
+    return TERMO(c00, b[0][0]) + TERMO(c01, b[0][1]) + TERMO(c02, b[0][2]) +     \
+           TERMO(c10, b[1][0]) + TERMO(c11, b[1][1]) + TERMO(c12, b[1][2]) +     \
+           TERMO(c20, b[2][0]) + TERMO(c21, b[2][1]) + TERMO(c22, b[2][2]);      \
+  }
+
+PATHER_MASCARAS(KERNEL_MASCARA)
+
+/**
+ * Known Masks
+ */
+typedef struct
+{
+  PatherKernel kernel;
+  const char *nome;
+  int coeficientes[3][3];
+  LinhaMascara linha;
+  PontoMascara ponto;
+} Mascara;
+
+#define ENTRADA_MASCARA(nome, c00, c01, c02, c10, c11, c12, c20, c21, c22)        \
+  { PATHER_KERNEL_##nome, #nome, { { c00, c01, c02 }, { c10, c11, c12 }, { c20, c21, c22 } }, \
+    nome##_linha, nome##_ponto },
+
+static const Mascara MASCARAS[] = { PATHER_MASCARAS(ENTRADA_MASCARA) };
+
+#define N_MASCARAS (sizeof(MASCARAS) / sizeof(MASCARAS[0]))
+
+/**
+ * Row Kernel of a Mask
+ *
+ * @return o kernel de linha, ou NULL para uma máscara desconhecida
+ */
+LinhaMascara mask_row(PatherKernel kernel)
+{
+  for (size_t i = 0; i < N_MASCARAS; i++)
+    if (MASCARAS[i].kernel == kernel)
+      return MASCARAS[i].linha;
+  return NULL;
+}
+
+/**
+ * Point Kernel Matching a Mask
+ *
+ * @return o kernel especializado se `mask` é uma das máscaras
+ *         conhecidas, ou NULL
+ */
+PontoMascara mask_point(int mask[3][3])
+{
+  for (size_t i = 0; i < N_MASCARAS; i++)
+    if (memcmp(MASCARAS[i].coeficientes, mask, sizeof(MASCARAS[i].coeficientes)) == 0)
+      return MASCARAS[i].ponto;
+  return NULL;
+}
+
+/**
+ * Mask by Name
+ *
+ * Aceita os nomes da tabela sem diferenciar maiúsculas ("sobel_y").
+ *
+ * @return 1 se o nome é conhecido, 0 do contrário
+ */
+int mask_from_name(const char *nome, PatherKernel *kernel)
+{
+  for (size_t i = 0; i < N_MASCARAS; i++)
+  {
+    const char *a = MASCARAS[i].nome, *b = nome;
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+      a++, b++;
+    if (!*a && !*b)
+    {
+      *kernel = MASCARAS[i].kernel;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,265 @@
+/**
+ * Grayscale Morphology
+ *
+ * van Herk/Gil-Werman em 1D, para uma janela de k = 2r + 1 amostras:
+ * a sequência (com r amostras neutras em cada ponta) é dividida em
+ * blocos de k; g acumula o mínimo/máximo do início do bloco até cada
+ * posição e h do fim do bloco até cada posição. Toda janela cobre o fim
+ * de um bloco e o começo do seguinte, então a resposta é op(h[x],
+ * g[x + 2r]): três operações por amostra.
+ *
+ * O retângulo é separável. A passada vertical trata linhas inteiras
+ * como vetores (SSE2, 16 pixels por instrução); a horizontal roda a
+ * recorrência em cada linha e vetoriza a combinação final de g e h.
+ * As diagonais reúnem cada diagonal em um vetor e usam a versão 1D.
+ *
+ * Todas as funções aceitam `dst == src`.
+ */
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* File Header */
+#include <pather/morfologia.h>
+#include <pather/alloc.h>
+
+#define OP(a, b) (max ? ((a) > (b) ? (a) : (b)) : ((a) < (b) ? (a) : (b)))
+
+/**
+ * Element-wise Min/Max
+ *
+ * dst[i] = op(a[i], b[i]) para i em [0, n).
+ */
+static void combina(unsigned char *dst, const unsigned char *a, const unsigned char *b, unsigned long n, int max)
+{
+  unsigned long i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    _mm_storeu_si128((__m128i *)(dst + i), max ? _mm_max_epu8(va, vb) : _mm_min_epu8(va, vb));
+  }
+#endif
+
+  for (; i < n; i++)
+    dst[i] = OP(a[i], b[i]);
+}
+
+/**
+ * 1D van Herk/Gil-Werman
+ *
+ * @param g, h buffers de trabalho com n + 2r bytes
+ */
+static void vhgw_1d(const unsigned char *in, unsigned char *out, unsigned long n, unsigned long r,
+                    int max, unsigned char *g, unsigned char *h)
+{
+  const unsigned long k = 2 * r + 1, total = n + 2 * r;
+  const unsigned char neutro = max ? 0 : 255;
+  unsigned long p;
+
+#define AMOSTRA(p) (((p) >= r && (p) < r + n) ? in[(p) - r] : neutro)
+
+  for (p = 0; p < total; p++)
+  {
+    unsigned char v = AMOSTRA(p);
+    g[p] = (p % k == 0) ? v : OP(g[p - 1], v);
+  }
+
+  h[total - 1] = AMOSTRA(total - 1);
+  for (p = total - 1; p-- > 0;)
+  {
+    unsigned char v = AMOSTRA(p);
+    h[p] = ((p + 1) % k == 0) ? v : OP(h[p + 1], v);
+  }
+
+#undef AMOSTRA
+
+  combina(out, h, g + 2 * r, n, max);
+}
+
+/**
+ * Horizontal Pass
+ */
+static int passada_horizontal(Imagem1C *src, Imagem1C *dst, unsigned long r, int max)
+{
+  unsigned char *g, *h;
+
+  if (r == 0)
+  {
+    if (dst != src)
+      for (unsigned long y = 0; y < src->altura; y++)
+        memcpy(dst->dados[y], src->dados[y], src->largura);
+    return 1;
+  }
+
+  g = (unsigned char *)pather_malloc(2 * (src->largura + 2 * r));
+  if (!g)
+    return 0;
+  h = g + src->largura + 2 * r;
+
+  for (unsigned long y = 0; y < src->altura; y++)
+    vhgw_1d(src->dados[y], dst->dados[y], src->largura, r, max, g, h);
+
+  pather_free(g);
+  return 1;
+}
+
+/**
+ * Vertical Pass
+ *
+ * A mesma recorrência da versão 1D, com linhas inteiras no lugar de
+ * amostras. Precisa de g e h para todas as linhas (2 bytes por pixel).
+ */
+static int passada_vertical(Imagem1C *src, Imagem1C *dst, unsigned long r, int max)
+{
+  const unsigned long w = src->largura, k = 2 * r + 1, total = src->altura + 2 * r;
+  unsigned char *g, *h, *neutra;
+  unsigned long p;
+
+  if (r == 0)
+  {
+    if (dst != src)
+      for (unsigned long y = 0; y < src->altura; y++)
+        memcpy(dst->dados[y], src->dados[y], w);
+    return 1;
+  }
+
+  g = (unsigned char *)pather_malloc((2 * total + 1) * w);
+  if (!g)
+    return 0;
+  h = g + total * w;
+  neutra = h + total * w;
+  memset(neutra, max ? 0 : 255, w);
+
+#define LINHA(p) (((p) >= r && (p) < r + src->altura) ? src->dados[(p) - r] : neutra)
+
+  for (p = 0; p < total; p++)
+  {
+    if (p % k == 0)
+      memcpy(g + p * w, LINHA(p), w);
+    else
+      combina(g + p * w, g + (p - 1) * w, LINHA(p), w, max);
+  }
+
+  memcpy(h + (total - 1) * w, LINHA(total - 1), w);
+  for (p = total - 1; p-- > 0;)
+  {
+    if ((p + 1) % k == 0)
+      memcpy(h + p * w, LINHA(p), w);
+    else
+      combina(h + p * w, h + (p + 1) * w, LINHA(p), w, max);
+  }
+
+#undef LINHA
+
+  for (unsigned long y = 0; y < src->altura; y++)
+    combina(dst->dados[y], h + y * w, g + (y + 2 * r) * w, w, max);
+
+  pather_free(g);
+  return 1;
+}
+
+/**
+ * Diagonal Pass
+ *
+ * Cada diagonal (x - y constante para 135°, x + y constante para 45°)
+ * é copiada para um vetor, filtrada em 1D e copiada de volta.
+ */
+static int passada_diagonal(Imagem1C *src, Imagem1C *dst, unsigned long r, int max, int descendo)
+{
+  const long w = (long)src->largura, a = (long)src->altura;
+  const unsigned long maior = (unsigned long)(w < a ? w : a);
+  unsigned char *linha, *g, *h;
+
+  linha = (unsigned char *)pather_malloc(maior + 2 * (maior + 2 * r));
+  if (!linha)
+    return 0;
+  g = linha + maior;
+  h = g + maior + 2 * r;
+
+  /* Cada diagonal começa na coluna 0 ou na primeira/última linha */
+  for (long d = 0; d < w + a - 1; d++)
+  {
+    long x0 = d < a ? 0 : d - a + 1;
+    long y0 = descendo ? (d < a ? a - 1 - d : 0) : (d < a ? d : a - 1);
+    long dy = descendo ? 1 : -1;
+    unsigned long n = 0;
+
+    for (long x = x0, y = y0; x < w && y >= 0 && y < a; x++, y += dy)
+      linha[n++] = src->dados[y][x];
+
+    vhgw_1d(linha, linha, n, r, max, g, h);
+
+    n = 0;
+    for (long x = x0, y = y0; x < w && y >= 0 && y < a; x++, y += dy)
+      dst->dados[y][x] = linha[n++];
+  }
+
+  pather_free(linha);
+  return 1;
+}
+
+/**
+ * Min/Max Filter
+ */
+static int filtra(Imagem1C *src, Imagem1C *dst, const ElementoEstruturante *se, int max)
+{
+  unsigned long rx = se->largura > 0 ? (unsigned long)se->largura / 2 : 0;
+  unsigned long ry = se->altura > 0 ? (unsigned long)se->altura / 2 : 0;
+
+  if (dst->largura != src->largura || dst->altura != src->altura)
+    return 0;
+
+  switch (se->forma)
+  {
+    case SE_RETANGULO:
+      return passada_horizontal(src, dst, rx, max) && passada_vertical(dst, dst, ry, max);
+    case SE_LINHA_0:
+      return passada_horizontal(src, dst, rx, max);
+    case SE_LINHA_90:
+      return passada_vertical(src, dst, rx, max);
+    case SE_LINHA_45:
+      return passada_diagonal(src, dst, rx, max, 0);
+    case SE_LINHA_135:
+      return passada_diagonal(src, dst, rx, max, 1);
+  }
+
+  return 0;
+}
+
+/**
+ * Erosion and Dilation
+ *
+ * @return 1 em caso de sucesso, 0 se faltar memória
+ */
+int morph_erode(Imagem1C *src, Imagem1C *dst, const ElementoEstruturante *se)
+{
+  return filtra(src, dst, se, 0);
+}
+
+int morph_dilate(Imagem1C *src, Imagem1C *dst, const ElementoEstruturante *se)
+{
+  return filtra(src, dst, se, 1);
+}
+
+/**
+ * Opening and Closing
+ *
+ * A segunda operação roda no lugar, sobre `dst`.
+ */
+int morph_open(Imagem1C *src, Imagem1C *dst, const ElementoEstruturante *se)
+{
+  return filtra(src, dst, se, 0) && filtra(dst, dst, se, 1);
+}
+
+int morph_close(Imagem1C *src, Imagem1C *dst, const ElementoEstruturante *se)
+{
+  return filtra(src, dst, se, 1) && filtra(dst, dst, se, 0);
+}
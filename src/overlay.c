@@ -0,0 +1,237 @@
+/**
+ * In-place Path Overlay
+ *
+ * O custo de gerar a saída passa a depender do tamanho do caminho e não da
+ * imagem: a cópia do arquivo é feita pelo kernel (de graça em sistemas de
+ * arquivos com reflink) e depois escrevemos só 3 bytes por pixel do
+ * caminho, agrupando trechos horizontais contíguos em um único pwrite.
+ */
+
+#define _GNU_SOURCE
+
+/* Standard Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+/* File Header */
+#include <pather/overlay.h>
+#include <pather/alloc.h>
+
+/* Maior trecho horizontal escrito de uma vez (em pixels) */
+#define MAX_TRECHO 1024
+
+/* Bloco usado na cópia por read/write */
+#define BLOCO_COPIA (1 << 20)
+
+/**
+ * Little-endian Reads
+ */
+static uint32_t le_u32(const unsigned char *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t le_u16(const unsigned char *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/**
+ * Copy a File
+ *
+ * Tenta, em ordem: clonar o arquivo (FICLONE), copy_file_range e, por
+ * último, um laço de read/write.
+ *
+ * @return 1 se a cópia foi feita, 0 do contrário
+ */
+static int copia_arquivo(int entrada, int saida, off_t tamanho)
+{
+  unsigned char *bloco;
+  off_t copiado = 0;
+  ssize_t n;
+
+#if defined(__linux__) && defined(FICLONE)
+  if (ioctl(saida, FICLONE, entrada) == 0)
+    return 1;
+#endif
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+  while (copiado < tamanho)
+  {
+    n = copy_file_range(entrada, NULL, saida, NULL, tamanho - copiado, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    copiado += n;
+  }
+  if (copiado == tamanho)
+    return 1;
+#endif
+
+  /* Fallback: read/write a partir do ponto onde a cópia parou */
+  bloco = (unsigned char *)pather_malloc(BLOCO_COPIA);
+  if (!bloco)
+    return 0;
+
+  while (copiado < tamanho)
+  {
+    n = pread(entrada, bloco, BLOCO_COPIA, copiado);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0 || pwrite(saida, bloco, n, copiado) != n)
+      break;
+    copiado += n;
+  }
+
+  pather_free(bloco);
+  return copiado == tamanho;
+}
+
+/**
+ * Overlay a Path on a Copy of the Input
+ *
+ * Copia `origem` para `destino` e pinta de vermelho os pixels do caminho,
+ * calculando o offset de cada um a partir do stride das linhas do BMP
+ * (armazenadas de baixo para cima, salvo altura negativa). Aceita arquivos
+ * de 24 e 32 bpp; em 8 bpp o vermelho não existe na paleta de cinza, então
+ * a função falha sem mensagem e o chamador deve decodificar a imagem. O
+ * mesmo vale para BI_BITFIELDS, aceito só em 32 bpp com as máscaras BGRA
+ * usuais, em que os bytes do pixel têm a mesma ordem do BI_RGB.
+ *
+ * @param  origem  arquivo BMP de entrada
+ * @param  destino arquivo de saída
+ * @param  caminho coordenadas a pintar
+ * @param  n       número de coordenadas
+ *
+ * @return         1 se a saída foi gerada, 0 do contrário
+ */
+int salvaCaminhoSobreposto(char *origem, char *destino, Coordenada *caminho, int n)
+{
+  unsigned char header[70];
+  unsigned char vermelho[MAX_TRECHO * 3];
+  struct stat info;
+  uint32_t offset, dib, bpp, compressao, stride;
+  ssize_t lido;
+  int32_t largura, altura;
+  int de_cima = 0, ok = 0;
+  int entrada, saida;
+
+  entrada = open(origem, O_RDONLY);
+  if (entrada < 0)
+    return 0;
+
+  /* Lê e confere o cabeçalho antes de copiar qualquer coisa */
+  if (fstat(entrada, &info) != 0 || (lido = pread(entrada, header, sizeof(header), 0)) < 54 ||
+      header[0] != 'B' || header[1] != 'M')
+  {
+    close(entrada);
+    return 0;
+  }
+
+  offset = le_u32(&header[10]);
+  dib = le_u32(&header[14]);
+  largura = (int32_t)le_u32(&header[18]);
+  altura = (int32_t)le_u32(&header[22]);
+  bpp = le_u16(&header[28]);
+  compressao = le_u32(&header[30]);
+
+  if (altura < 0)
+  {
+    altura = -altura;
+    de_cima = 1;
+  }
+
+  if (largura <= 0 || altura == 0 || (bpp != 24 && bpp != 32) || (compressao != 0 && compressao != 3))
+  {
+    close(entrada);
+    return 0;
+  }
+
+  /* As máscaras vêm logo após o cabeçalho de 40 bytes, ou dentro dele nos
+     cabeçalhos V4/V5; a de alfa só existe a partir de 56 bytes */
+  if (compressao == 3 &&
+      (bpp != 32 || lido < 66 || le_u32(&header[54]) != 0x00FF0000u ||
+       le_u32(&header[58]) != 0x0000FF00u || le_u32(&header[62]) != 0x000000FFu ||
+       (dib >= 56 && (lido < 70 || (le_u32(&header[66]) != 0 && le_u32(&header[66]) != 0xFF000000u)))))
+  {
+    close(entrada);
+    return 0;
+  }
+  stride = ((largura * bpp + 31) / 32) * 4;
+
+  saida = open(destino, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (saida < 0)
+  {
+    close(entrada);
+    return 0;
+  }
+
+  if (!copia_arquivo(entrada, saida, info.st_size))
+  {
+    fprintf(stderr, "Error copying %s.\n", origem);
+    goto fim;
+  }
+
+  /* B = 0, G = 0, R = 255 */
+  for (int i = 0; i < MAX_TRECHO; i++)
+  {
+    vermelho[i * 3] = 0;
+    vermelho[i * 3 + 1] = 0;
+    vermelho[i * 3 + 2] = 255;
+  }
+
+  for (int c = 0; c < n; )
+  {
+    int inicio = c, x0, k;
+    off_t pos;
+
+    if (caminho[c].x < 0 || caminho[c].x >= largura || caminho[c].y < 0 || caminho[c].y >= altura)
+    {
+      fprintf(stderr, "Error: path point (%d, %d) outside the image.\n", caminho[c].x, caminho[c].y);
+      goto fim;
+    }
+
+    /* Em 24 bpp, agrupa pontos vizinhos na mesma linha (em qualquer
+       sentido) em um único trecho contíguo */
+    c++;
+    if (bpp == 24)
+    {
+      int passo = c < n && caminho[c].y == caminho[inicio].y ? caminho[c].x - caminho[inicio].x : 0;
+      if (passo == 1 || passo == -1)
+        while (c < n && c - inicio < MAX_TRECHO && caminho[c].y == caminho[inicio].y &&
+               caminho[c].x == caminho[c - 1].x + passo && caminho[c].x >= 0 && caminho[c].x < largura)
+          c++;
+    }
+
+    k = c - inicio;
+    x0 = caminho[inicio].x < caminho[c - 1].x ? caminho[inicio].x : caminho[c - 1].x;
+    pos = (off_t)offset + (off_t)(de_cima ? caminho[inicio].y : altura - 1 - caminho[inicio].y) * stride
+        + (off_t)x0 * (bpp / 8);
+
+    if (pwrite(saida, vermelho, k * 3, pos) != k * 3)
+    {
+      fprintf(stderr, "Error writing %s.\n", destino);
+      goto fim;
+    }
+  }
+
+  ok = 1;
+
+fim:
+  close(entrada);
+  if (close(saida) != 0)
+    ok = 0;
+  return ok;
+}
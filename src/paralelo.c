@@ -0,0 +1,63 @@
+/**
+ * Worker Threads
+ *
+ * Criação e junção das threads dos estágios paralelos.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <unistd.h>
+#include <pthread.h>
+
+/* File Header */
+#include <pather/paralelo.h>
+
+/**
+ * Number of Threads
+ *
+ * @param  n_threads threads pedidas; 0 (ou negativo) usa uma por processador
+ * @param  total     unidades de trabalho (linhas, colunas, consultas)
+ * @return           entre 1 e PATHER_MAX_THREADS, e não mais que `total`
+ */
+int parallel_threads(int n_threads, unsigned long total)
+{
+  if (n_threads <= 0)
+    n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (n_threads > PATHER_MAX_THREADS)
+    n_threads = PATHER_MAX_THREADS;
+  if ((unsigned long)n_threads > total)
+    n_threads = (int)total;
+  if (n_threads < 1)
+    n_threads = 1;
+  return n_threads;
+}
+
+/**
+ * Run Tasks on Threads
+ *
+ * Chama `funcao` para cada uma das `n` tarefas do vetor `tarefas`, com
+ * elementos de `tamanho` bytes (com `tamanho` 0, todas recebem o mesmo
+ * ponteiro, para lotes em que as threads disputam os itens). A tarefa
+ * 0 e as que não ganharam thread rodam na thread atual; a função só
+ * retorna depois de todas terminarem.
+ */
+void parallel_run(void *(*funcao)(void *), void *tarefas, size_t tamanho, int n)
+{
+  pthread_t threads[PATHER_MAX_THREADS];
+  int criada[PATHER_MAX_THREADS];
+  char *base = (char *)tarefas;
+
+  if (n > PATHER_MAX_THREADS)
+    n = PATHER_MAX_THREADS;
+
+  for (int t = 0; t < n; t++)
+    criada[t] = t > 0 && pthread_create(&threads[t], NULL, funcao, base + t * tamanho) == 0;
+
+  for (int t = 0; t < n; t++)
+    if (!criada[t])
+      funcao(base + t * tamanho);
+  for (int t = 1; t < n; t++)
+    if (criada[t])
+      pthread_join(threads[t], NULL);
+}
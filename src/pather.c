@@ -15,9 +15,25 @@
 #include <stdbool.h>
 #include <math.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* File Header */
 #include <pather/pather.h>
 #include <pather/imagem.h>
+#include <pather/alloc.h>
+#include <pather/binaria.h>
+#include <pather/bordas.h>
+#include <pather/cache.h>
+#include <pather/componentes.h>
+#include <pather/dijkstra.h>
+#include <pather/esqueleto.h>
+#include <pather/limiar.h>
+#include <pather/mascaras.h>
+#include <pather/morfologia.h>
+#include <pather/suavizacao.h>
+#include <pather/trace.h>
 
 /**
  * Menor Caminho na Imagem
@@ -34,45 +50,503 @@
  */
 int encontraCaminho (Imagem1C* img, Coordenada** caminho)
 {
-  /* Cria a imagem filtrada */
-  Imagem1C *filtrada = (Imagem1C *)malloc(sizeof(Imagem1C));
-  filtrada->largura = img->largura;
-  filtrada->altura = img->altura;
-  filtrada->dados = (unsigned char**) malloc (sizeof (unsigned char*) * filtrada->altura);
-  for (int i = 0; i < filtrada->altura; i++)
-    filtrada->dados[i] = (unsigned char*)malloc(sizeof (unsigned char) * filtrada->largura);
+  PatherConfig config;
 
-  for (int y = 0; y < img->altura; y++)
-    for (int x = 0; x < img->largura; x++)
-      filtrada->dados[y][x] = img->dados[y][x];
+  pather_config_default(&config);
+  return encontraCaminhoConfig(img, caminho, NULL, &config);
+}
+
+/**
+ * Default Pipeline Options
+ *
+ * Dijkstra sobre os níveis de cinza, sem pré-filtro, morfologia nem
+ * binarização, Sobel X no filtro e sem cache de resultados.
+ */
+void pather_config_default(PatherConfig *config)
+{
+  config->solver = PATHER_SOLVER_DIJKSTRA;
+  config->threshold = PATHER_THRESHOLD_NONE;
+  config->kernel = PATHER_KERNEL_SOBEL_X;
+  config->prefilter = PATHER_PREFILTER_NONE;
+  config->prefilter_sigma = 1.0;
+  config->prefilter_radius = 1;
+  config->threshold_window = 0;
+  config->threshold_k = 0.0;
+  config->canny_low = 0;
+  config->canny_high = 0;
+  config->close_radius = 0;
+  config->gap_length = 0;
+  config->min_component = 0;
+  config->restrict_components = 0;
+  config->n_threads = 0;
+  config->layout = PATHER_LAYOUT_ROWS;
+  config->huge_pages = 0;
+  config->cache_dir = NULL;
+  config->debug_dump = NULL;
+  config->cache_max_bytes = 64 << 20;
+}
+
+/**
+ * Stage Buffer Sizes
+ *
+ * Tamanho das imagens lidas e escritas por uma etapa, para o
+ * `TRACE_BYTES` (0 para uma etapa que não gerou a saída).
+ */
+static inline uint64_t bytes_imagem(const Imagem1C *img)
+{
+  return img ? (uint64_t)img->largura * img->altura : 0;
+}
+
+static inline uint64_t bytes_binaria(const ImagemBinaria *bin)
+{
+  return bin ? (uint64_t)bin->altura * bin->palavras * sizeof(uint64_t) : 0;
+}
+
+/**
+ * Binarize and Close Gaps
+ *
+ * Binariza `img` em uma imagem de 1 bit por pixel, com o threshold
+ * global de Otsu, com um threshold local (Bradley/Sauvola) ou com as
+ * bordas de Canny, e completa as falhas das linhas com um fechamento
+ * de raio `config->close_radius`.
+ *
+ * @return a imagem binária, ou NULL se faltar memória
+ */
+static ImagemBinaria *binariza(Imagem1C *img, const PatherConfig *config)
+{
+  uint32_t histograma[256];
+  ImagemBinaria *bin;
+
+  switch (config->threshold)
+  {
+    case PATHER_THRESHOLD_BRADLEY:
+      bin = threshold_bradley(img, config->threshold_window, config->threshold_k, config->n_threads);
+      break;
+    case PATHER_THRESHOLD_SAUVOLA:
+      bin = threshold_sauvola(img, config->threshold_window, config->threshold_k, config->n_threads);
+      break;
+    case PATHER_THRESHOLD_CANNY:
+      bin = canny_edges(img, config->canny_low, config->canny_high, config->n_threads);
+      break;
+    default:
+      generate_histogram(img, histograma);
+      bin = bin_from_gray(img, otsu_threshold(img, histograma));
+      break;
+  }
+  if (!bin)
+    return NULL;
+
+  if (config->close_radius > 0 &&
+      !bin_close(bin, bin, config->close_radius, config->close_radius))
+  {
+    bin_destroy(bin);
+    return NULL;
+  }
+
+  return bin;
+}
+
+/**
+ * Prune Components
+ *
+ * Apaga de `bin` os componentes com menos de `config->min_component`
+ * pixels e, com `config->restrict_components`, devolve a máscara dos
+ * componentes que atravessam a imagem para restringir o solver.
+ *
+ * @return a máscara, ou NULL se ela não foi pedida, se nenhum
+ *         componente atravessa a imagem ou se faltar memória
+ */
+static ImagemBinaria *poda_componentes(ImagemBinaria *bin, const PatherConfig *config)
+{
+  ImagemBinaria *mascara = NULL;
+  Rotulagem *rot = ccl_label(bin, config->n_threads);
+
+  if (!rot)
+    return NULL;
+
+  if (config->min_component > 0)
+    ccl_remove_small(rot, bin, (unsigned long)config->min_component);
+  if (config->restrict_components)
+    mascara = ccl_spanning_mask(rot);
+
+  ccl_destroy(rot);
+  return mascara;
+}
+
+/**
+ * Solve on the Skeleton
+ *
+ * Afina `bin` no lugar e busca o caminho no grafo do esqueleto, com
+ * `custo` como mapa de custo dos pixels.
+ *
+ * @return número de coordenadas, ou -1 se o esqueleto não liga as
+ *         bordas ou se faltar memória
+ */
+static int caminho_esqueleto(ImagemBinaria *bin, Imagem1C *custo, Coordenada **caminho, long *total,
+                             int n_threads)
+{
+  GrafoEsqueleto *grafo;
+  int n;
+
+  *caminho = NULL;
+  if (bin_thin(bin, n_threads) < 0)
+    return -1;
+
+  grafo = skeleton_graph(bin, custo);
+  if (!grafo)
+    return -1;
+
+  n = skeleton_path(grafo, bin, custo, caminho, total);
+  skeleton_graph_destroy(grafo);
+  return n;
+}
+
+/**
+ * Denoise
+ *
+ * Aplica o pré-filtro escolhido em uma cópia de `img`.
+ *
+ * @return a imagem suavizada, ou NULL se faltar memória
+ */
+static Imagem1C *suaviza(Imagem1C *img, const PatherConfig *config)
+{
+  Imagem1C *saida = criaImagem1C(img->largura, img->altura);
+  int ok = 0;
+
+  if (!saida)
+    return NULL;
+
+  switch (config->prefilter)
+  {
+    case PATHER_PREFILTER_GAUSSIAN:
+      ok = gaussian_iir(img, saida, config->prefilter_sigma, config->n_threads);
+      break;
+    case PATHER_PREFILTER_MEDIAN:
+      ok = median_filter(img, saida, config->prefilter_radius, config->n_threads);
+      break;
+    default:
+      break;
+  }
+
+  if (!ok)
+  {
+    destroiImagem1C(saida);
+    return NULL;
+  }
+  return saida;
+}
+
+/**
+ * Pipeline Stage Outputs
+ *
+ * Uma etapa desligada (ou pulada por falta de memória) aponta para a
+ * saída da etapa anterior.
+ */
+typedef struct
+{
+  Imagem1C *suavizada;
+  Imagem1C *entrada;
+  Imagem1C *custo;
+  ImagemBinaria *bin;     /* Só com o solver do esqueleto */
+  ImagemBinaria *mascara; /* Componentes permitidos, ou NULL */
+} EtapasPipeline;
+
+/**
+ * Build the Cost Map
+ *
+ * Roda as etapas entre a imagem de entrada e o solver: pré-filtro,
+ * abertura, threshold e poda de componentes. Uma etapa sem memória é
+ * pulada com um aviso.
+ */
+static void prepara(Imagem1C *img, const PatherConfig *config, EtapasPipeline *etapas)
+{
+  etapas->suavizada = etapas->entrada = etapas->custo = img;
+  etapas->bin = etapas->mascara = NULL;
+
+  /* Tira o ruído antes do Sobel e do threshold; todas as etapas
+     seguintes partem da imagem suavizada */
+  if (config->prefilter != PATHER_PREFILTER_NONE)
+  {
+    TRACE_STAGE_BEGIN("prefilter");
+    etapas->suavizada = suaviza(img, config);
+    TRACE_BYTES(bytes_imagem(img) + bytes_imagem(etapas->suavizada));
+    TRACE_STAGE_END();
+
+    if (!etapas->suavizada)
+    {
+      fprintf(stderr, "Aviso: não foi possível aplicar o pré-filtro, pulando a etapa\n");
+      etapas->suavizada = img;
+    }
+    etapas->entrada = etapas->custo = etapas->suavizada;
+  }
+
+  /* Completa as falhas das linhas ainda em escala de cinza, com uma
+     abertura por um segmento horizontal (as linhas cruzam a imagem da
+     esquerda para a direita) */
+  if (config->gap_length > 0)
+  {
+    ElementoEstruturante se = { SE_LINHA_0, config->gap_length, 1 };
+
+    TRACE_STAGE_BEGIN("morph");
+    etapas->entrada = criaImagem1C(img->largura, img->altura);
+    if (etapas->entrada && !morph_open(etapas->suavizada, etapas->entrada, &se))
+    {
+      destroiImagem1C(etapas->entrada);
+      etapas->entrada = NULL;
+    }
+    TRACE_BYTES(bytes_imagem(etapas->suavizada) + bytes_imagem(etapas->entrada));
+    TRACE_STAGE_END();
+
+    if (!etapas->entrada)
+    {
+      fprintf(stderr, "Aviso: sem memória para a morfologia, pulando a etapa\n");
+      etapas->entrada = etapas->suavizada;
+    }
+    etapas->custo = etapas->entrada;
+  }
+
+  /* Binariza a imagem e completa as falhas. O solver do esqueleto
+     precisa da imagem binária mesmo sem threshold (usa o de Otsu) */
+  if (config->threshold != PATHER_THRESHOLD_NONE || config->solver == PATHER_SOLVER_SKELETON)
+  {
+    TRACE_STAGE_BEGIN("threshold");
+    etapas->bin = binariza(etapas->entrada, config);
+    TRACE_BYTES(bytes_imagem(etapas->entrada) + bytes_binaria(etapas->bin));
+    TRACE_STAGE_END();
+
+    /* Descarta as manchas de ruído e limita a busca aos componentes
+       que ligam as duas bordas */
+    if (etapas->bin && (config->min_component > 0 || config->restrict_components))
+    {
+      TRACE_STAGE_BEGIN("components");
+      etapas->mascara = poda_componentes(etapas->bin, config);
+      TRACE_BYTES(bytes_binaria(etapas->bin) + bytes_binaria(etapas->mascara));
+      TRACE_STAGE_END();
+    }
+
+    if (config->threshold != PATHER_THRESHOLD_NONE)
+    {
+      etapas->custo = etapas->bin ? criaImagem1C(img->largura, img->altura) : NULL;
+      if (etapas->custo)
+        bin_to_gray(etapas->bin, etapas->custo);
+
+      if (!etapas->custo)
+      {
+        fprintf(stderr, "Aviso: sem memória para binarizar, usando os níveis de cinza\n");
+        etapas->custo = etapas->entrada;
+      }
+    }
+
+    if (config->solver != PATHER_SOLVER_SKELETON)
+    {
+      bin_destroy(etapas->bin);
+      etapas->bin = NULL;
+    }
+  }
+}
+
+static void libera_etapas(Imagem1C *img, EtapasPipeline *etapas)
+{
+  bin_destroy(etapas->bin);
+  bin_destroy(etapas->mascara);
+
+  if (etapas->custo != etapas->entrada)
+    destroiImagem1C(etapas->custo);
+  if (etapas->entrada != etapas->suavizada)
+    destroiImagem1C(etapas->entrada);
+  if (etapas->suavizada != img)
+    destroiImagem1C(etapas->suavizada);
+}
+
+/**
+ * Menor Caminho com Opções
+ *
+ * Igual ao `encontraCaminho`, mas com as opções do pipeline explícitas.
+ * Com `config->cache_dir` definido, um acerto no cache de resultados
+ * devolve o caminho e o custo guardados sem rodar filtro nem solver.
+ *
+ * @param  img     imagem de entrada
+ * @param  caminho saída: caminho encontrado (liberar com free)
+ * @param  custo   saída opcional: custo do caminho
+ * @param  config  opções do pipeline
+ *
+ * @return         number of steps, PATHER_SEM_MEMORIA se o solver não
+ *                 coube na memória, ou -1 nos outros erros
+ */
+int encontraCaminhoConfig (Imagem1C* img, Coordenada** caminho, long* custo, const PatherConfig* config)
+{
+  int n_passos;
+  long total = 0;
+  uint64_t chave = 0;
+  EtapasPipeline etapas;
+
+  TRACE_CALL_BEGIN(img->largura, img->altura);
+
+  /* Consulta o cache de resultados */
+  if (config->cache_dir)
+  {
+    TRACE_STAGE_BEGIN("cache");
+    chave = cache_key(img, config);
+    n_passos = cache_lookup(config->cache_dir, chave, caminho, &total);
+    TRACE_BYTES(bytes_imagem(img));
+    TRACE_STAGE_END();
+
+    if (n_passos > 0)
+    {
+      if (custo)
+        *custo = total;
+      TRACE_CALL_END();
+      return n_passos;
+    }
+  }
+
+  prepara(img, config, &etapas);
+
+  /* A imagem filtrada só alimenta o dump de depuração, então só é
+     criada quando ele é pedido. Se ela não couber no orçamento de
+     memória do job, seguimos em modo de baixa memória, sem o dump. */
+  Imagem1C *filtrada = NULL;
+  if (config->debug_dump)
+  {
+    TRACE_STAGE_BEGIN("copy");
+    filtrada = criaImagem1C(img->largura, img->altura);
+    if (filtrada)
+    {
+      for (unsigned long y = 0; y < img->altura; y++)
+        for (unsigned long x = 0; x < img->largura; x++)
+          filtrada->dados[y][x] = etapas.suavizada->dados[y][x];
+      TRACE_BYTES(bytes_imagem(etapas.suavizada) + bytes_imagem(filtrada));
+    }
+    else
+      fprintf(stderr, "Aviso: sem memória para a imagem filtrada, pulando filtro e dump\n");
+    TRACE_STAGE_END();
+  }
 
 	/* Fitramos a Imagem */
-	filter(img, filtrada);
-
-  /* Calcula o histograma da imagem usando o algorithmo de Otsu */
-  // uint8_t *histograma = (uint8_t *)malloc(256 * sizeof(uint8_t));
-  // generate_histogram(img, histograma);
-
-  // for (int i = 0; i < 256; i++)
-  //   printf("%d ", histograma[i]);
-  // printf("\n");
-
-  // /* Calcula o valor do threshold */
-  // uint8_t threshold = otsu_threshold(img, histograma);
-  
-  /* Binariza a imagem baseando-se no valor de threshold predito */
-  // for (int y = 0; y < img->altura; y++)
-  // {
-  //   for (int x = 0; x < img->largura; x++)
-  //   {
-  //     binarization(img->dados, y, x, threshold);
-  //   }
-  // }
-
-  salvaImagem1C(filtrada, "teste.bmp");
+  if (filtrada)
+  {
+    TRACE_STAGE_BEGIN("filter");
+    filter_mask(etapas.suavizada, filtrada, config->kernel);
+    TRACE_BYTES(bytes_imagem(etapas.suavizada) + bytes_imagem(filtrada));
+    TRACE_STAGE_END();
+  }
+
+  if (filtrada)
+  {
+    TRACE_STAGE_BEGIN("dump");
+    salvaImagem1C(filtrada, (char *)config->debug_dump);
+    TRACE_BYTES(bytes_imagem(filtrada));
+    TRACE_STAGE_END();
+    destroiImagem1C(filtrada);
+  }
+
+  /* Busca o caminho de menor custo entre as bordas: no grafo do
+     esqueleto, se pedido, e na grade de pixels se ele não servir */
+  n_passos = -1;
+  if (etapas.bin)
+  {
+    TRACE_STAGE_BEGIN("skeleton");
+    n_passos = caminho_esqueleto(etapas.bin, etapas.custo, caminho, &total, config->n_threads);
+    TRACE_BYTES(bytes_binaria(etapas.bin) + bytes_imagem(etapas.custo));
+    TRACE_STAGE_END();
+    bin_destroy(etapas.bin);
+    etapas.bin = NULL;
+
+    if (n_passos < 0)
+      fprintf(stderr, "Aviso: o esqueleto não liga as bordas, usando o solver de pixels\n");
+  }
+
+  if (n_passos < 0)
+  {
+    TRACE_STAGE_BEGIN("solve");
+    n_passos = dijkstra_path_config(etapas.custo, etapas.mascara, config, caminho, &total);
+    TRACE_STAGE_END();
+  }
+
+  libera_etapas(img, &etapas);
+
+  if (n_passos > 0 && config->cache_dir)
+    cache_store(config->cache_dir, config->cache_max_bytes, chave, *caminho, n_passos, total);
+  if (custo)
+    *custo = total;
+
+  TRACE_CALL_END();
 
 	/* Return the number of steps */
-	return 10;
+	return n_passos;
+}
+
+/**
+ * Menor Caminho em uma Região
+ *
+ * Decodifica só o retângulo pedido do arquivo (recortado aos limites
+ * da imagem), roda o pipeline nele e traduz o caminho de volta para as
+ * coordenadas da imagem inteira. Serve quando já se sabe em que faixa
+ * da imagem a linha está; o caminho liga a coluna da esquerda à da
+ * direita do retângulo.
+ *
+ * @return número de coordenadas, ou -1 em caso de erro
+ */
+int encontraCaminhoRegiao (char* arquivo, unsigned long x0, unsigned long y0, unsigned long largura, unsigned long altura,
+                           Coordenada** caminho, long* custo, const PatherConfig* config)
+{
+  Imagem1C *img;
+  int n;
+
+  *caminho = NULL;
+  img = abreImagem1CRegiao(arquivo, x0, y0, largura, altura);
+  if (!img)
+    return -1;
+
+  n = encontraCaminhoConfig(img, caminho, custo, config);
+  destroiImagem1C(img);
+
+  for (int c = 0; c < n; c++)
+  {
+    (*caminho)[c].x += (int)x0;
+    (*caminho)[c].y += (int)y0;
+  }
+
+  return n;
+}
+
+/**
+ * Vários Caminhos na Mesma Imagem
+ *
+ * Responde várias consultas (pares de conjuntos de origens e destinos,
+ * como linhas independentes do mesmo scan) com uma só passada do
+ * pipeline: o mapa de custo e a máscara dos componentes são montados
+ * uma vez e compartilhados pelas buscas, que rodam em paralelo, cada
+ * thread com a sua memória de trabalho. As consultas usam sempre a
+ * grade de pixels (o esqueleto só liga as bordas), e o cache de
+ * resultados e o dump de depuração ficam de fora.
+ *
+ * @param  img         imagem de entrada
+ * @param  consultas   as consultas; `caminho`, `n` e `custo` são preenchidos
+ * @param  n_consultas número de consultas
+ * @param  config      opções do pipeline (`n_threads` vale também para as buscas)
+ *
+ * @return             número de consultas com caminho
+ */
+int encontraCaminhos (Imagem1C* img, ConsultaCaminho* consultas, int n_consultas, const PatherConfig* config)
+{
+  PatherConfig pixels = *config;
+  EtapasPipeline etapas;
+  int resolvidas;
+
+  pixels.solver = PATHER_SOLVER_DIJKSTRA;
+
+  TRACE_CALL_BEGIN(img->largura, img->altura);
+  prepara(img, &pixels, &etapas);
+
+  TRACE_STAGE_BEGIN("queries");
+  resolvidas = dijkstra_queries(etapas.custo, etapas.mascara, consultas, n_consultas, config);
+  TRACE_STAGE_END();
+
+  libera_etapas(img, &etapas);
+  TRACE_CALL_END();
+
+  return resolvidas;
 }
 
 /**
@@ -96,11 +570,16 @@ void print_matrix(unsigned char **m, uint32_t y, uint32_t x)
  * Algoritmo de Convulação
  *
  * Esta seção realiza a convulução de uma dada matriz
- * através de superposição
+ * através de superposição, em aritmética inteira.
  */
-float convulution(unsigned char **base, int mask[3][3], int degree)
+int convulution(unsigned char **base, int mask[3][3], int degree)
 {
-	float sum = 0;
+	int sum = 0;
+	PontoMascara ponto = degree == 3 ? mask_point(mask) : NULL;
+
+	/* Máscara conhecida: kernel desenrolado, sem os termos nulos */
+	if (ponto)
+		return ponto(base);
 
 	for (int y = 0; y < degree; y++)
 		for (int x = 0; x < degree; x++)
@@ -112,81 +591,102 @@ float convulution(unsigned char **base, int mask[3][3], int degree)
  * Filtragem utilizando Operadores de Sobel
  *
  * Removemos ruídos da imagem utilizando a convulsão das
- * matrizes de sobel
+ * matrizes de sobel (a máscara X).
  */
 void filter(Imagem1C *img, Imagem1C *dest)
 {
-	/*
-	 * Pior caso da máscara Y:
-	   	0   0   0
-	   	0   0   0
-	 	  255 255 255
-	 */
-	/* Vertical Mask */
-	int mask_y[3][3] = {
-		{ -1, -2, -1 },
-		{  0,  0,  0 },
-		{  1,  2,  1 },
-	};
+  filter_mask(img, dest, PATHER_KERNEL_SOBEL_X);
+}
 
+/**
+ * Filtragem por uma Máscara Conhecida
+ *
+ * Aplica o kernel desenrolado da máscara (veja `mascaras.h`). Tudo em
+ * inteiros: o gradiente é de 16 bits e a normalização para 0..255
+ * troca a divisão por pixel por uma multiplicação pelo recíproco
+ * pré-calculado, que difere em no máximo 1 da conta em double.
+ */
+void filter_mask(Imagem1C *img, Imagem1C *dest, PatherKernel kernel)
+{
 	/*
-	 * Pior caso da máscara X:
+	 * Pior caso da máscara X do Sobel:
 	   	0   0   255
 	   	0   0   255
 	 	  0   0   255
+	 *
+	 * Horizontal Mask:
+	 *   { -1,  0,  1 },
+	 *   { -2,  0,  2 },
+	 *   { -1,  0,  1 }
 	 */
-	/* Horizontal Mask */
-	int mask_x[3][3] = {
-		{ -1,  0,  1 },
-		{ -2,  0,  2 },
-		{ -1,  0,  1 }
-	};
-
-  /* Pixel Neighbors */
-  unsigned char ** pixel_neighbors;
+  const unsigned long largura = img->largura, altura = img->altura;
+  LinhaMascara linha = mask_row(kernel);
+  int minimum = INT16_MAX, maximum = INT16_MIN;
+  unsigned int faixa, reciproco, deslocamento = 0;
+  int16_t *g;
 
-  /* The minimum and maximum of image */
-  double minimum = 2048.0, maximum = -2048.0;
-  double pixel_value;
-
-	/* Iterate over height + 1 to height - 1 */
-	for (int y = 1; y < img->altura - 1; y++)
-	{
-		for (int x = 1; x < img->largura - 1; x++)
-		{
-      /* Matrix of 3x3 with neighbors */
-      pixel_neighbors = get_neighbors(img->dados, y, x);
-
-      /* Start the pixel value */
-			pixel_value = 0.0;
+  if (largura < 3 || altura < 3 || !linha)
+    return;
 
-      for (int i = 0; i < 3; i++)
-        for (int j = 0; j < 3; j++)
-          pixel_value += mask_x[i][j] * img->dados[y + (i-1)][x + (j-1)];
+  g = (int16_t *)pather_malloc(largura * sizeof(int16_t));
+  if (!g)
+    return;
 
-      if ( pixel_value < minimum ) minimum = pixel_value;
-      if ( pixel_value > maximum ) maximum = pixel_value;
-		}
-	}
-
-  for (int y = 1; y < img->altura - 1; y++)
+  /* The minimum and maximum of image */
+  for (unsigned long y = 1; y < altura - 1; y++)
   {
-    for (int x = 1; x < img->largura - 1; x++)
+    linha(img->dados[y - 1], img->dados[y], img->dados[y + 1], g, largura);
+    for (unsigned long x = 1; x < largura - 1; x++)
     {
-      /* Matrix of 3x3 with neighbors */
-      pixel_neighbors = get_neighbors(img->dados, y, x);
+      if (g[x] < minimum) minimum = g[x];
+      if (g[x] > maximum) maximum = g[x];
+    }
+  }
+
+  /* 255 * v / faixa vira (v << deslocamento) * recíproco >> 16, com
+     faixa << deslocamento >= 256 para o recíproco caber em 16 bits.
+     O recíproco é arredondado para cima, então o resultado é o da
+     divisão exata ou 1 a mais, e nunca passa de 255. */
+  faixa = (unsigned int)(maximum - minimum);
+  if (faixa == 0)
+  {
+    for (unsigned long y = 1; y < altura - 1; y++)
+      for (unsigned long x = 1; x < largura - 1; x++)
+        dest->dados[y][x] = 0;
+    pather_free(g);
+    return;
+  }
+  while ((faixa << deslocamento) < 256)
+    deslocamento++;
+  reciproco = (255u * 65536u + (faixa << deslocamento) - 1) / (faixa << deslocamento);
 
-      /* Start the pixel value */
-      pixel_value = 0.0;
+  for (unsigned long y = 1; y < altura - 1; y++)
+  {
+    unsigned char *saida = dest->dados[y];
+    unsigned long x = 1;
 
-      for (int i = 0; i < 3; i++)
-        for (int j = 0; j < 3; j++)
-          pixel_value += mask_x[i][j] * img->dados[y + (i-1)][x + (j-1)];
+    linha(img->dados[y - 1], img->dados[y], img->dados[y + 1], g, largura);
 
-      pixel_value = 255 * (pixel_value - minimum) / (maximum - minimum);
-      dest->dados[y][x] = (unsigned char)pixel_value;
+#ifdef __SSE2__
+    {
+      const __m128i base = _mm_set1_epi16((int16_t)minimum);
+      const __m128i mult = _mm_set1_epi16((int16_t)reciproco);
+      const __m128i desl = _mm_cvtsi32_si128((int)deslocamento);
+
+      for (; x + 8 < largura; x += 8)
+      {
+        __m128i v = _mm_sll_epi16(_mm_sub_epi16(_mm_loadu_si128((const __m128i *)(g + x)), base), desl);
+        __m128i n = _mm_mulhi_epu16(v, mult);
+        _mm_storel_epi64((__m128i *)(saida + x), _mm_packus_epi16(n, n));
+      }
     }
+#endif
+
+    for (; x + 1 < largura; x++)
+      saida[x] = (unsigned char)((((unsigned int)(g[x] - minimum) << deslocamento) * reciproco) >> 16);
   }
+
+  pather_free(g);
 }
 
 
@@ -194,7 +694,8 @@ void filter(Imagem1C *img, Imagem1C *dest)
  * Normalize a Value into a Range
  *
  * If you have a range in value [A, B] and want to scale
- * into a range [C, D].
+ * into a range [C, D]. Integer version: the result is
+ * truncated, like the former float version after a cast.
  * 
  * @param  value           value to scale
  * @param  base_min        The minimum of our old range (A)
@@ -203,17 +704,17 @@ void filter(Imagem1C *img, Imagem1C *dest)
  * @param  destination_max The maximum of our new range (D)
  * @return                 Scaled value in range [C, D]
  */
-float normalize(float value, float base_min, float base_max, float destination_min, float destination_max)
+int normalize(int value, int base_min, int base_max, int destination_min, int destination_max)
 {
-  return ( destination_min * ( 1 - ( (value - base_min) / (base_max - base_min) )) \
-          + destination_max * ( (value - base_min) / (base_max - base_min) ) );
+  return destination_min + (int)((long long)(value - base_min) * (destination_max - destination_min) / (base_max - base_min));
 }
 
 /**
  * Get Neightboors
  *
  * Retorna uma matriz de 3x3 contendo os vizinhos de uma
- * determinada coordenada de uma determinada matriz.
+ * determinada coordenada de uma determinada matriz. A matriz
+ * deve ser liberada com `pather_free` (linhas e depois o vetor).
  */
 unsigned char ** get_neighbors(unsigned char **dados, uint32_t coordinate_y, uint32_t coordinate_x)
 {
@@ -221,9 +722,18 @@ unsigned char ** get_neighbors(unsigned char **dados, uint32_t coordinate_y, uin
 	unsigned char ** neighbors;
 
 	/* Allocate memory */
-	neighbors = (unsigned char **)malloc(3 * sizeof(unsigned char *));
+	neighbors = (unsigned char **)pather_malloc(3 * sizeof(unsigned char *));
+	if (!neighbors)
+		return NULL;
 	for (int i = 0; i < 3; i++)
-		neighbors[i] = (unsigned char *)malloc(3 * sizeof(unsigned char));
+		neighbors[i] = (unsigned char *)pather_malloc(3 * sizeof(unsigned char));
+	if (!neighbors[0] || !neighbors[1] || !neighbors[2])
+	{
+		for (int i = 0; i < 3; i++)
+			pather_free(neighbors[i]);
+		pather_free(neighbors);
+		return NULL;
+	}
 
 	/* Parse the matrix */
 	for (int y = -1; y < 2; y++)
@@ -253,9 +763,11 @@ void binarization(unsigned char **dados, uint32_t coordinate_y, uint32_t coordin
  *
  * Criamos um histograma contendo os níveis em escala cinza
  * na imagem para sabermos uma distribuição de probabilidade
- * do valor de `threshold` ideal para a imagem
+ * do valor de `threshold` ideal para a imagem. As contagens
+ * são de 32 bits: com 8 bits elas estouravam a partir de 256
+ * pixels do mesmo nível.
  */
-void generate_histogram(Imagem1C *img, uint8_t *histogram)
+void generate_histogram(Imagem1C *img, uint32_t *histogram)
 {
   /* Fill with zeros */
   for (int i = 0; i < 256; i++) histogram[i] = 0;
@@ -269,53 +781,53 @@ void generate_histogram(Imagem1C *img, uint8_t *histogram)
  *
  * Esta função irá retornar o valor do threshold que deve ser
  * aplicado sob a imagem atráves da densidade da distribuição
- * de níveis de cinza na imagem.
+ * de níveis de cinza na imagem. Roda uma vez por histograma
+ * (256 passos), então só a razão final fica em double.
  */
-uint8_t otsu_threshold(Imagem1C *img, uint8_t *histogram)
+uint8_t otsu_threshold(Imagem1C *img, uint32_t *histogram)
 {
-  /* Probability of each density */
-  double probability[256], omega[256];
+  /* Total de pixels e soma dos níveis de cinza */
+  uint64_t total = (uint64_t)img->altura * img->largura;
+  uint64_t soma_total = 0;
 
-  /* Value for separation */
-  double myu[256];
+  /* Pixels e soma dos níveis da classe escura (0 .. i) */
+  uint64_t omega = 0, myu = 0;
 
   /* Inter-class variance */
-  double max_sigma, sigma[256];
+  double max_sigma, sigma;
 
   /* Store the predict of threshold */
   uint8_t threshold;
 
-  /* Distribution */
   for (int i = 0; i < 256; i++)
-    probability[i] = (double)histogram[i] / (img->altura * img->largura);
-
-  /* Omega & MYU */
-  omega[0] = probability[0];
-  myu[0] = 0.0;
-  for (int i = 1; i < 256; i++)
-  {
-    omega[i] = omega[i - 1] + probability[i];
-    myu[i] = myu[i - 1] + (i * probability[i]);
-  }
+    soma_total += (uint64_t)i * histogram[i];
 
-  /* Maximization of Sigma Value */
+  /* Maximization of Sigma Value. A variância entre classes é
+     (soma_total * omega - myu * total)^2 / (omega * (total - omega)),
+     a mesma de antes multiplicada por total^2, que não muda o máximo:
+     só as somas acumuladas, sem probabilidades nem pow() */
   threshold = 0;
   max_sigma = 0.0;
   for ( int i = 0; i < 256; i++ )
   {
-    if ( omega[i] != 0.0 && omega[i] != 1.0 )
-      sigma[i] = pow( myu[255] * omega[i] - myu[i], 2) / ( omega[i] * (1.0 - omega[i]));
-    else
-      sigma[i] = 0.0;
+    double diferenca;
+
+    omega += histogram[i];
+    myu += (uint64_t)i * histogram[i];
+    if ( omega == 0 || omega == total )
+      continue;
+
+    diferenca = (double)soma_total * omega - (double)myu * total;
+    sigma = diferenca * diferenca / ((double)omega * (total - omega));
 
     /* Check if its the optima of Sigma */
-    if (sigma[i] > max_sigma)
+    if (sigma > max_sigma)
     {
-      max_sigma = sigma[i];
+      max_sigma = sigma;
       threshold = i;
     }
   }
 
   /* Return the prediction */
   return threshold;
-}
\ No newline at end of file
+}
@@ -0,0 +1,232 @@
+/**
+ * Frame Sequences
+ *
+ * A faixa é marcada na máscara como a união dos quadrados de lado
+ * 2 * raio + 1 centrados nos pixels do caminho anterior, e apagada da
+ * mesma forma depois da busca, então a máscara nunca é limpa inteira.
+ */
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <string.h>
+
+/* File Header */
+#include <pather/sequencia.h>
+#include <pather/alloc.h>
+#include <pather/trace.h>
+
+/**
+ * Create a Sequence
+ *
+ * @param  largura, altura dimensões dos frames
+ * @param  raio            raio inicial da faixa (mínimo 1)
+ * @param  salto           aumento relativo de custo aceito sem alargar a
+ *                         faixa (0.25 = até 25% mais caro que o anterior)
+ * @return                 a sequência, ou NULL se faltar memória
+ */
+Sequencia *seq_create(unsigned long largura, unsigned long altura, int raio, double salto)
+{
+  Sequencia *seq = (Sequencia *)pather_malloc(sizeof(Sequencia));
+  if (!seq)
+    return NULL;
+
+  memset(seq, 0, sizeof(Sequencia));
+  seq->largura = largura;
+  seq->altura = altura;
+  seq->raio = raio > 0 ? raio : 1;
+  seq->salto = salto;
+  seq->faixa = bin_create(largura, altura);
+  seq->trabalho = dijkstra_workspace((uint32_t)(largura * altura), 1);
+  if (!seq->faixa || !seq->trabalho)
+  {
+    seq_destroy(seq);
+    return NULL;
+  }
+
+  return seq;
+}
+
+void seq_destroy(Sequencia *seq)
+{
+  if (!seq)
+    return;
+
+  dijkstra_workspace_destroy(seq->trabalho);
+  bin_destroy(seq->faixa);
+  pather_free(seq->caminho);
+  pather_free(seq);
+}
+
+/**
+ * Forget the Previous Path
+ *
+ * O próximo frame é resolvido na imagem inteira (para um corte de cena).
+ */
+void seq_reset(Sequencia *seq)
+{
+  seq->n = 0;
+}
+
+/**
+ * Set or Clear a Row Span
+ */
+static void marca_trecho(ImagemBinaria *bin, unsigned long y, unsigned long x0, unsigned long x1, int liga)
+{
+  uint64_t *linha = bin->dados + y * bin->palavras;
+
+  for (unsigned long p = x0 / 64; p <= x1 / 64; p++)
+  {
+    uint64_t m = ~(uint64_t)0;
+    if (p == x0 / 64)
+      m &= ~(uint64_t)0 << (x0 % 64);
+    if (p == x1 / 64)
+      m &= ~(uint64_t)0 >> (63 - x1 % 64);
+    linha[p] = liga ? linha[p] | m : linha[p] & ~m;
+  }
+}
+
+/**
+ * Set or Clear the Band
+ *
+ * O quadrado de um pixel do caminho contém o do pixel anterior menos
+ * uma linha ou coluna, então cada passo só marca a linha ou coluna
+ * nova: O(raio) por pixel do caminho, em vez de O(raio²).
+ */
+static void marca_faixa(Sequencia *seq, unsigned long raio, int liga)
+{
+  for (int c = 0; c < seq->n; c++)
+  {
+    unsigned long x = (unsigned long)seq->caminho[c].x, y = (unsigned long)seq->caminho[c].y;
+    unsigned long x0 = x > raio ? x - raio : 0, y0 = y > raio ? y - raio : 0;
+    unsigned long x1 = x + raio < seq->largura ? x + raio : seq->largura - 1;
+    unsigned long y1 = y + raio < seq->altura ? y + raio : seq->altura - 1;
+    unsigned long px, py;
+
+    if (c == 0)
+    {
+      for (unsigned long yy = y0; yy <= y1; yy++)
+        marca_trecho(seq->faixa, yy, x0, x1, liga);
+      continue;
+    }
+
+    px = (unsigned long)seq->caminho[c - 1].x;
+    py = (unsigned long)seq->caminho[c - 1].y;
+    if (x > px && x + raio < seq->largura)
+      for (unsigned long yy = y0; yy <= y1; yy++)
+        marca_trecho(seq->faixa, yy, x + raio, x + raio, liga);
+    else if (x < px && x >= raio)
+      for (unsigned long yy = y0; yy <= y1; yy++)
+        marca_trecho(seq->faixa, yy, x - raio, x - raio, liga);
+    else if (y > py && y + raio < seq->altura)
+      marca_trecho(seq->faixa, y + raio, x0, x1, liga);
+    else if (y < py && y >= raio)
+      marca_trecho(seq->faixa, y - raio, x0, x1, liga);
+  }
+}
+
+/**
+ * Path Touches the Band Edge
+ *
+ * Um caminho encostado na borda da faixa provavelmente foi desviado
+ * por ela: a linha se deslocou mais que o raio.
+ */
+static int toca_borda(const Sequencia *seq, const Coordenada *caminho, int n)
+{
+  const ImagemBinaria *faixa = seq->faixa;
+
+  for (int c = 0; c < n; c++)
+  {
+    unsigned long x = (unsigned long)caminho[c].x, y = (unsigned long)caminho[c].y;
+    const uint64_t *linha = faixa->dados + y * faixa->palavras;
+
+    if ((x > 0 && !((linha[(x - 1) / 64] >> ((x - 1) % 64)) & 1)) ||
+        (x + 1 < faixa->largura && !((linha[(x + 1) / 64] >> ((x + 1) % 64)) & 1)) ||
+        (y > 0 && !((linha[x / 64 - faixa->palavras] >> (x % 64)) & 1)) ||
+        (y + 1 < faixa->altura && !((linha[x / 64 + faixa->palavras] >> (x % 64)) & 1)))
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Keep the Path for the Next Frame
+ *
+ * @return 1 se o caminho foi guardado, 0 se faltar memória
+ */
+static int guarda(Sequencia *seq, const Coordenada *caminho, int n, long custo)
+{
+  if (n > seq->capacidade)
+  {
+    Coordenada *novo = (Coordenada *)pather_realloc(seq->caminho, (size_t)n * sizeof(Coordenada));
+    if (!novo)
+      return 0;
+    seq->caminho = novo;
+    seq->capacidade = n;
+  }
+
+  memcpy(seq->caminho, caminho, (size_t)n * sizeof(Coordenada));
+  seq->n = n;
+  seq->custo = custo;
+  return 1;
+}
+
+/**
+ * Solve One Frame
+ *
+ * Busca o caminho na faixa em torno do caminho anterior. O resultado é
+ * aceito se o custo não passou do anterior mais `salto` e se o caminho
+ * não encosta na borda da faixa; do contrário, a faixa dobra de raio e
+ * a busca é refeita, até a faixa chegar à metade do frame, quando a
+ * busca passa a ser na imagem inteira. O primeiro frame (ou o seguinte
+ * a um `seq_reset`) é sempre resolvido na imagem inteira.
+ *
+ * @param  seq     estado da sequência
+ * @param  frame   frame atual, com as dimensões da sequência
+ * @param  caminho saída: caminho encontrado (liberar com free)
+ * @param  custo   saída opcional: custo do caminho
+ * @return         número de coordenadas, ou -1 em caso de erro
+ */
+int seq_frame(Sequencia *seq, Imagem1C *frame, Coordenada **caminho, long *custo)
+{
+  unsigned long raio = (unsigned long)seq->raio;
+  unsigned long limite = (seq->largura < seq->altura ? seq->largura : seq->altura) / 2;
+  long total = 0;
+  int n, aceito;
+
+  *caminho = NULL;
+  if (frame->largura != seq->largura || frame->altura != seq->altura)
+    return -1;
+
+  TRACE_CALL_BEGIN(frame->largura, frame->altura);
+  for (;;)
+  {
+    int inteira = seq->n == 0 || raio >= limite;
+
+    if (!inteira)
+      marca_faixa(seq, raio, 1);
+
+    TRACE_STAGE_BEGIN(inteira ? "solve" : "band");
+    n = dijkstra_path_ws(seq->trabalho, frame, inteira ? NULL : seq->faixa, caminho, &total);
+    TRACE_STAGE_END();
+
+    aceito = inteira || (n > 0 && total <= seq->custo + (long)(seq->salto * seq->custo) &&
+                         !toca_borda(seq, *caminho, n));
+    if (!inteira)
+      marca_faixa(seq, raio, 0);
+    if (aceito)
+      break;
+
+    free(*caminho);
+    *caminho = NULL;
+    raio *= 2;
+  }
+  TRACE_CALL_END();
+
+  /* Sem memória para guardar o caminho, o próximo frame parte do zero */
+  if (n > 0 && !guarda(seq, *caminho, n, total))
+    seq->n = 0;
+
+  if (custo)
+    *custo = total;
+  return n;
+}
@@ -0,0 +1,568 @@
+/**
+ * Incremental Path Sessions
+ *
+ * A sessão guarda a árvore de menores caminhos completa (todas as
+ * distâncias a partir da coluna da esquerda, sem parar no primeiro
+ * pixel da direita). Depois de um retoque:
+ *
+ * 1. Os pixels cujo custo subiu invalidam a sua subárvore: os filhos
+ *    de um nó são os vizinhos cujo predecessor aponta para ele.
+ * 2. Cada nó invalidado ou com custo novo recebe a melhor distância
+ *    vinda dos vizinhos que continuam válidos e entra na heap.
+ * 3. Um Dijkstra a partir dessa heap propaga as melhoras.
+ *
+ * Todas as distâncias fora da parte invalidada continuam sendo custos
+ * de caminhos reais, então a propagação converge para as distâncias
+ * exatas visitando só os nós afetados.
+ */
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <string.h>
+
+/* File Header */
+#include <pather/sessao.h>
+#include <pather/alloc.h>
+#include <pather/binaria.h>
+#include <pather/dijkstra.h>
+#include <pather/limiar.h>
+#include <pather/morfologia.h>
+#include <pather/suavizacao.h>
+#include <pather/trace.h>
+
+/* Retângulo com x1 e y1 exclusivos */
+typedef struct
+{
+  unsigned long x0, y0, x1, y1;
+} Retangulo;
+
+typedef int (*Etapa)(SessaoCaminho *sessao, Imagem1C *src, Imagem1C *dst);
+
+/*============================================================================*/
+
+static int etapa_mediana(SessaoCaminho *sessao, Imagem1C *src, Imagem1C *dst)
+{
+  return median_filter(src, dst, sessao->config.prefilter_radius, sessao->config.n_threads);
+}
+
+static int etapa_abertura(SessaoCaminho *sessao, Imagem1C *src, Imagem1C *dst)
+{
+  ElementoEstruturante se = { SE_LINHA_0, sessao->config.gap_length, 1 };
+  return morph_open(src, dst, &se);
+}
+
+/**
+ * Threshold Stage
+ *
+ * Como o `binariza` do pipeline, mas com a janela e o nível de Otsu da
+ * imagem inteira, para que um recorte dê o mesmo resultado.
+ */
+static int etapa_limiar(SessaoCaminho *sessao, Imagem1C *src, Imagem1C *dst)
+{
+  const PatherConfig *config = &sessao->config;
+  ImagemBinaria *bin;
+
+  switch (config->threshold)
+  {
+    case PATHER_THRESHOLD_BRADLEY:
+      bin = threshold_bradley(src, sessao->janela, config->threshold_k, config->n_threads);
+      break;
+    case PATHER_THRESHOLD_SAUVOLA:
+      bin = threshold_sauvola(src, sessao->janela, config->threshold_k, config->n_threads);
+      break;
+    default:
+      bin = bin_from_gray(src, sessao->nivel);
+      break;
+  }
+  if (!bin)
+    return 0;
+
+  if (config->close_radius > 0 &&
+      !bin_close(bin, bin, config->close_radius, config->close_radius))
+  {
+    bin_destroy(bin);
+    return 0;
+  }
+
+  bin_to_gray(bin, dst);
+  bin_destroy(bin);
+  return 1;
+}
+
+static int etapa_copia(SessaoCaminho *sessao, Imagem1C *src, Imagem1C *dst)
+{
+  (void)sessao;
+  for (unsigned long y = 0; y < src->altura; y++)
+    memcpy(dst->dados[y], src->dados[y], src->largura);
+  return 1;
+}
+
+/**
+ * Influence Margin of the Threshold Stage
+ */
+static unsigned long margem_limiar(const SessaoCaminho *sessao)
+{
+  unsigned long margem = 0;
+
+  if (sessao->config.threshold == PATHER_THRESHOLD_NONE)
+    return 0;
+  if (sessao->config.threshold != PATHER_THRESHOLD_OTSU)
+    margem += (unsigned long)sessao->janela / 2;
+  if (sessao->config.close_radius > 0)
+    margem += 2 * (unsigned long)sessao->config.close_radius;
+  return margem;
+}
+
+/*============================================================================*/
+
+static Retangulo expande(Retangulo r, unsigned long margem, const Imagem1C *img)
+{
+  r.x0 = r.x0 > margem ? r.x0 - margem : 0;
+  r.y0 = r.y0 > margem ? r.y0 - margem : 0;
+  r.x1 = r.x1 + margem < img->largura ? r.x1 + margem : img->largura;
+  r.y1 = r.y1 + margem < img->altura ? r.y1 + margem : img->altura;
+  return r;
+}
+
+/**
+ * Run a Stage on a Crop
+ *
+ * Recorta `src` em `r` e aplica a etapa no recorte. Os pixels a pelo
+ * menos `margem` da borda do recorte (ou na borda da imagem) saem
+ * iguais aos da etapa aplicada na imagem inteira.
+ *
+ * @return a saída da etapa, do tamanho do recorte, ou NULL se faltar memória
+ */
+static Imagem1C *aplica_recorte(SessaoCaminho *sessao, Etapa etapa, Imagem1C *src, Retangulo r)
+{
+  Imagem1C *recorte = criaImagem1C((int)(r.x1 - r.x0), (int)(r.y1 - r.y0));
+  Imagem1C *saida = criaImagem1C((int)(r.x1 - r.x0), (int)(r.y1 - r.y0));
+
+  if (recorte && saida)
+  {
+    for (unsigned long y = r.y0; y < r.y1; y++)
+      memcpy(recorte->dados[y - r.y0], src->dados[y] + r.x0, r.x1 - r.x0);
+    if (etapa(sessao, recorte, saida))
+    {
+      destroiImagem1C(recorte);
+      return saida;
+    }
+  }
+
+  if (recorte)
+    destroiImagem1C(recorte);
+  if (saida)
+    destroiImagem1C(saida);
+  return NULL;
+}
+
+/**
+ * Recompute a Stage in a Rectangle
+ *
+ * Atualiza `dst` em `r` a partir de `src` recortado em `r` mais a margem.
+ */
+static int atualiza(SessaoCaminho *sessao, Etapa etapa, Imagem1C *src, Imagem1C *dst,
+                    Retangulo r, unsigned long margem)
+{
+  Retangulo e = expande(r, margem, src);
+  Imagem1C *saida = aplica_recorte(sessao, etapa, src, e);
+
+  if (!saida)
+    return 0;
+
+  for (unsigned long y = r.y0; y < r.y1; y++)
+    memcpy(dst->dados[y] + r.x0, saida->dados[y - e.y0] + (r.x0 - e.x0), r.x1 - r.x0);
+  destroiImagem1C(saida);
+  return 1;
+}
+
+/*============================================================================*/
+
+static int empilha(SessaoCaminho *sessao, size_t *n, uint32_t no)
+{
+  if (*n == sessao->capacidade_pilha)
+  {
+    size_t capacidade = sessao->capacidade_pilha ? sessao->capacidade_pilha * 2 : 1024;
+    uint32_t *pilha = (uint32_t *)pather_realloc(sessao->pilha, capacidade * sizeof(uint32_t));
+    if (!pilha)
+      return 0;
+    sessao->pilha = pilha;
+    sessao->capacidade_pilha = capacidade;
+  }
+
+  sessao->pilha[(*n)++] = no;
+  return 1;
+}
+
+/**
+ * Neighbour in a Direction
+ *
+ * `direcao` é a direção gravada em `pred` por quem veio desse vizinho.
+ *
+ * @return o índice do vizinho, ou -1 fora da imagem
+ */
+static int64_t vizinho(const SessaoCaminho *sessao, uint32_t no, int direcao)
+{
+  uint32_t largura = (uint32_t)sessao->custo->largura, altura = (uint32_t)sessao->custo->altura;
+  uint32_t x = no % largura, y = no / largura;
+
+  switch (direcao)
+  {
+    case PRED_ESQUERDA: return x > 0 ? (int64_t)no - 1 : -1;
+    case PRED_DIREITA:  return x + 1 < largura ? (int64_t)no + 1 : -1;
+    case PRED_ACIMA:    return y > 0 ? (int64_t)no - largura : -1;
+    case PRED_ABAIXO:   return y + 1 < altura ? (int64_t)no + largura : -1;
+    default:            return -1;
+  }
+}
+
+/* Direção que um vizinho grava ao vir de `no`, indexada pela direção do vizinho */
+static const uint8_t VOLTA[5] = { PRED_NENHUM, PRED_DIREITA, PRED_ESQUERDA, PRED_ABAIXO, PRED_ACIMA };
+
+static uint32_t peso(const SessaoCaminho *sessao, uint32_t no)
+{
+  uint32_t largura = (uint32_t)sessao->custo->largura;
+  return (uint32_t)sessao->custo->dados[no / largura][no % largura] + 1;
+}
+
+/**
+ * Best Distance from Valid Neighbours
+ *
+ * Recalcula a distância de `no` a partir dos vizinhos com distância
+ * finita (e da origem, na coluna da esquerda); se melhorar, grava e
+ * empilha na heap.
+ */
+static int semeia(SessaoCaminho *sessao, uint32_t no)
+{
+  uint32_t largura = (uint32_t)sessao->custo->largura;
+  uint32_t w = peso(sessao, no);
+  uint32_t melhor = no % largura == 0 ? w : UINT32_MAX;
+  uint8_t direcao = PRED_NENHUM;
+
+  for (int d = PRED_ESQUERDA; d <= PRED_ABAIXO; d++)
+  {
+    int64_t v = vizinho(sessao, no, d);
+    if (v >= 0 && sessao->dist[v] != UINT32_MAX && sessao->dist[v] + w < melhor)
+    {
+      melhor = sessao->dist[v] + w;
+      direcao = (uint8_t)d;
+    }
+  }
+
+  if (melhor >= sessao->dist[no])
+    return 1;
+  sessao->dist[no] = melhor;
+  sessao->pred[no] = direcao;
+  return heap_push(&sessao->heap, melhor, no);
+}
+
+/**
+ * Propagate Improvements
+ *
+ * @return nós assentados, ou -1 se faltar memória
+ */
+static long propaga(SessaoCaminho *sessao)
+{
+  long assentados = 0;
+
+  while (sessao->heap.tamanho > 0)
+  {
+    uint64_t item = heap_pop(&sessao->heap);
+    uint32_t no = (uint32_t)item, d = (uint32_t)(item >> 32);
+
+    if (d > sessao->dist[no])
+      continue;
+    assentados++;
+
+    for (int direcao = PRED_ESQUERDA; direcao <= PRED_ABAIXO; direcao++)
+    {
+      int64_t u = vizinho(sessao, no, direcao);
+      uint32_t nd;
+      if (u < 0)
+        continue;
+      nd = d + peso(sessao, (uint32_t)u);
+      if (nd < sessao->dist[u])
+      {
+        sessao->dist[u] = nd;
+        sessao->pred[u] = VOLTA[direcao];
+        if (!heap_push(&sessao->heap, nd, (uint32_t)u))
+          return -1;
+      }
+    }
+  }
+
+  TRACE_ADD(TRACE_NODES_SETTLED, assentados);
+  return assentados;
+}
+
+/**
+ * Apply New Costs and Repair the Tree
+ *
+ * `novo` traz os custos recalculados de `e`; só `r` (dentro de `e`) é
+ * aplicado.
+ *
+ * @return nós assentados no reparo, ou -1 se faltar memória
+ */
+static long repara(SessaoCaminho *sessao, Imagem1C *novo, Retangulo e, Retangulo r)
+{
+  uint32_t largura = (uint32_t)sessao->custo->largura;
+  size_t n = 0, lidos = 0;
+
+  /* Invalida as subárvores dos pixels que ficaram mais caros */
+  for (unsigned long y = r.y0; y < r.y1; y++)
+    for (unsigned long x = r.x0; x < r.x1; x++)
+    {
+      unsigned char antigo = sessao->custo->dados[y][x];
+      unsigned char atual = novo->dados[y - e.y0][x - e.x0];
+      uint32_t no = (uint32_t)(y * largura + x);
+
+      sessao->custo->dados[y][x] = atual;
+      if (atual <= antigo || sessao->dist[no] == UINT32_MAX)
+        continue;
+
+      sessao->dist[no] = UINT32_MAX;
+      if (!empilha(sessao, &n, no))
+        return -1;
+    }
+
+  while (lidos < n)
+  {
+    uint32_t no = sessao->pilha[lidos++];
+    for (int direcao = PRED_ESQUERDA; direcao <= PRED_ABAIXO; direcao++)
+    {
+      int64_t filho = vizinho(sessao, no, direcao);
+      if (filho < 0 || sessao->dist[filho] == UINT32_MAX || sessao->pred[filho] != VOLTA[direcao])
+        continue;
+      sessao->dist[filho] = UINT32_MAX;
+      if (!empilha(sessao, &n, (uint32_t)filho))
+        return -1;
+    }
+  }
+
+  /* Semeia a heap com os nós invalidados e os do retângulo */
+  sessao->heap.tamanho = 0;
+  for (size_t i = 0; i < n; i++)
+    if (!semeia(sessao, sessao->pilha[i]))
+      return -1;
+  for (unsigned long y = r.y0; y < r.y1; y++)
+    for (unsigned long x = r.x0; x < r.x1; x++)
+      if (!semeia(sessao, (uint32_t)(y * largura + x)))
+        return -1;
+
+  return propaga(sessao);
+}
+
+/*============================================================================*/
+
+/**
+ * Create a Session
+ *
+ * Roda as etapas na imagem inteira e resolve a árvore de menores
+ * caminhos completa. `img` continua sendo do chamador e precisa viver
+ * enquanto a sessão existir.
+ *
+ * @return a sessão, ou NULL se faltar memória ou se a configuração usa
+ *         uma etapa que não é local
+ */
+SessaoCaminho *sessao_create(Imagem1C *img, const PatherConfig *config)
+{
+  SessaoCaminho *sessao;
+  uint32_t n_pixels = (uint32_t)(img->largura * img->altura);
+  Retangulo tudo = { 0, 0, img->largura, img->altura };
+
+  if (config->prefilter == PATHER_PREFILTER_GAUSSIAN || config->min_component > 0 ||
+      config->restrict_components || config->solver != PATHER_SOLVER_DIJKSTRA ||
+      config->threshold == PATHER_THRESHOLD_CANNY || n_pixels == 0)
+    return NULL;
+
+  sessao = (SessaoCaminho *)pather_malloc(sizeof(SessaoCaminho));
+  if (!sessao)
+    return NULL;
+
+  memset(sessao, 0, sizeof(SessaoCaminho));
+  sessao->img = sessao->suavizada = sessao->entrada = img;
+  sessao->config = *config;
+  sessao->janela = config->threshold_window > 0 ? config->threshold_window : (int)(img->largura / 8) | 1;
+
+  TRACE_CALL_BEGIN(img->largura, img->altura);
+  TRACE_STAGE_BEGIN("stages");
+  if (config->prefilter == PATHER_PREFILTER_MEDIAN &&
+      (!(sessao->suavizada = criaImagem1C(img->largura, img->altura)) ||
+       !atualiza(sessao, etapa_mediana, img, sessao->suavizada, tudo, 0)))
+    goto erro;
+  sessao->entrada = sessao->suavizada;
+
+  if (config->gap_length > 0 &&
+      (!(sessao->entrada = criaImagem1C(img->largura, img->altura)) ||
+       !atualiza(sessao, etapa_abertura, sessao->suavizada, sessao->entrada, tudo, 0)))
+    goto erro;
+
+  if (config->threshold == PATHER_THRESHOLD_OTSU)
+  {
+    uint32_t histograma[256];
+    generate_histogram(sessao->entrada, histograma);
+    sessao->nivel = otsu_threshold(sessao->entrada, histograma);
+  }
+
+  sessao->custo = criaImagem1C(img->largura, img->altura);
+  if (!sessao->custo ||
+      !atualiza(sessao, config->threshold != PATHER_THRESHOLD_NONE ? etapa_limiar : etapa_copia,
+                sessao->entrada, sessao->custo, tudo, 0))
+    goto erro;
+  TRACE_STAGE_END();
+
+  TRACE_STAGE_BEGIN("solve");
+  sessao->dist = (uint32_t *)pather_malloc(n_pixels * sizeof(uint32_t));
+  sessao->pred = (uint8_t *)pather_malloc(n_pixels * sizeof(uint8_t));
+  if (!sessao->dist || !sessao->pred)
+    goto erro;
+
+  for (uint32_t i = 0; i < n_pixels; i++)
+  {
+    sessao->dist[i] = UINT32_MAX;
+    sessao->pred[i] = PRED_NENHUM;
+  }
+  for (uint32_t y = 0; y < img->altura; y++)
+    if (!semeia(sessao, y * (uint32_t)img->largura))
+      goto erro;
+  if (propaga(sessao) < 0)
+    goto erro;
+  TRACE_STAGE_END();
+  TRACE_CALL_END();
+
+  return sessao;
+
+erro:
+  TRACE_STAGE_END();
+  TRACE_CALL_END();
+  sessao_destroy(sessao);
+  return NULL;
+}
+
+void sessao_destroy(SessaoCaminho *sessao)
+{
+  if (!sessao)
+    return;
+
+  if (sessao->custo)
+    destroiImagem1C(sessao->custo);
+  if (sessao->entrada && sessao->entrada != sessao->suavizada)
+    destroiImagem1C(sessao->entrada);
+  if (sessao->suavizada && sessao->suavizada != sessao->img)
+    destroiImagem1C(sessao->suavizada);
+  pather_free(sessao->heap.itens);
+  pather_free(sessao->pilha);
+  pather_free(sessao->pred);
+  pather_free(sessao->dist);
+  pather_free(sessao);
+}
+
+/**
+ * Apply a Local Edit
+ *
+ * Chame depois de editar os pixels de `img` dentro do retângulo. Cada
+ * etapa é recalculada no retângulo crescido pela sua margem de
+ * influência, e a árvore é reparada onde o custo mudou.
+ *
+ * @return nós reassentados, ou -1 se faltar memória (a sessão fica
+ *         inconsistente e deve ser recriada)
+ */
+long sessao_update(SessaoCaminho *sessao, unsigned long x0, unsigned long y0,
+                   unsigned long largura, unsigned long altura)
+{
+  Imagem1C *img = sessao->img;
+  const PatherConfig *config = &sessao->config;
+  Retangulo r, e;
+  Imagem1C *novo;
+  long assentados;
+
+  if (x0 >= img->largura || y0 >= img->altura || largura == 0 || altura == 0)
+    return 0;
+
+  r.x0 = x0;
+  r.y0 = y0;
+  r.x1 = largura < img->largura - x0 ? x0 + largura : img->largura;
+  r.y1 = altura < img->altura - y0 ? y0 + altura : img->altura;
+
+  TRACE_CALL_BEGIN(r.x1 - r.x0, r.y1 - r.y0);
+  TRACE_STAGE_BEGIN("stages");
+  if (sessao->suavizada != img)
+  {
+    r = expande(r, (unsigned long)config->prefilter_radius, img);
+    if (!atualiza(sessao, etapa_mediana, img, sessao->suavizada, r, (unsigned long)config->prefilter_radius))
+      goto erro;
+  }
+
+  if (sessao->entrada != sessao->suavizada)
+  {
+    r = expande(r, (unsigned long)config->gap_length, img);
+    if (!atualiza(sessao, etapa_abertura, sessao->suavizada, sessao->entrada, r, (unsigned long)config->gap_length))
+      goto erro;
+  }
+
+  r = expande(r, margem_limiar(sessao), img);
+  e = expande(r, margem_limiar(sessao), img);
+  novo = aplica_recorte(sessao, config->threshold != PATHER_THRESHOLD_NONE ? etapa_limiar : etapa_copia,
+                        sessao->entrada, e);
+  if (!novo)
+    goto erro;
+  TRACE_STAGE_END();
+
+  TRACE_STAGE_BEGIN("repair");
+  assentados = repara(sessao, novo, e, r);
+  TRACE_STAGE_END();
+  destroiImagem1C(novo);
+
+  TRACE_CALL_END();
+  return assentados;
+
+erro:
+  TRACE_STAGE_END();
+  TRACE_CALL_END();
+  return -1;
+}
+
+/**
+ * Current Path
+ *
+ * O caminho termina no pixel da coluna da direita de menor distância
+ * (o mais alto, em caso de empate), como no `dijkstra_path`. O caminho
+ * retornado deve ser liberado com free().
+ *
+ * @return número de coordenadas, ou -1 em caso de erro
+ */
+int sessao_path(SessaoCaminho *sessao, Coordenada **caminho, long *custo)
+{
+  uint32_t largura = (uint32_t)sessao->custo->largura, altura = (uint32_t)sessao->custo->altura;
+  int64_t alvo = -1;
+  int n = 0, c;
+
+  *caminho = NULL;
+  for (uint32_t y = 0; y < altura; y++)
+  {
+    uint32_t no = y * largura + largura - 1;
+    if (sessao->dist[no] != UINT32_MAX && (alvo < 0 || sessao->dist[no] < sessao->dist[alvo]))
+      alvo = no;
+  }
+  if (alvo < 0)
+    return -1;
+
+  for (int64_t no = alvo; no >= 0; no = vizinho(sessao, (uint32_t)no, sessao->pred[no]))
+    n++;
+
+  *caminho = (Coordenada *)malloc(n * sizeof(Coordenada));
+  if (!*caminho)
+    return -1;
+
+  c = n;
+  for (int64_t no = alvo; no >= 0; no = vizinho(sessao, (uint32_t)no, sessao->pred[no]))
+  {
+    c--;
+    (*caminho)[c].x = (int)(no % largura);
+    (*caminho)[c].y = (int)(no / largura);
+  }
+
+  if (custo)
+    *custo = sessao->dist[alvo];
+  return n;
+}
@@ -0,0 +1,399 @@
+/**
+ * Denoising Pre-filters
+ *
+ * A gaussiana trabalha em uma cópia em float da imagem: a recorrência
+ * horizontal roda em cada linha e a vertical desce as linhas mantendo
+ * o estado de todas as colunas da faixa, o que deixa o laço interno
+ * contíguo e vetorizável.
+ *
+ * Na mediana, os histogramas têm 256 posições de 16 bits e um nível
+ * grosso de 16 posições: somar ou subtrair um histograma de coluna é
+ * um laço SSE2 de 32 instruções, e achar a mediana percorre no máximo
+ * 16 + 16 posições.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* File Header */
+#include <pather/suavizacao.h>
+#include <pather/alloc.h>
+#include <pather/paralelo.h>
+
+/**
+ * Work Range
+ */
+typedef struct
+{
+  Imagem1C *src, *dst;
+  float *buffer;
+  void *rascunho;          /* Memória de trabalho da faixa, alocada pelo `paralelo` */
+  unsigned long inicio, fim;
+  double b, b1, b2, b3;
+  int raio;
+  int ok;
+} TarefaSuavizacao;
+
+/**
+ * Run over Bands
+ *
+ * Divide `total` linhas/colunas entre as threads; a thread atual fica
+ * com as faixas que não ganharam thread. Cada faixa recebe em
+ * `rascunho` `fixo + por_item * (fim - inicio)` bytes, alocados aqui
+ * antes de criar as threads (o alocador registra no trace).
+ */
+static void paralelo(TarefaSuavizacao *modelo, unsigned long total, int n_threads, void *(*funcao)(void *),
+                     size_t fixo, size_t por_item)
+{
+  TarefaSuavizacao tarefas[PATHER_MAX_THREADS];
+
+  n_threads = parallel_threads(n_threads, total);
+  modelo->ok = 1;
+  for (int t = 0; t < n_threads; t++)
+  {
+    tarefas[t] = *modelo;
+    tarefas[t].inicio = total * t / n_threads;
+    tarefas[t].fim = total * (t + 1) / n_threads;
+    tarefas[t].rascunho = NULL;
+    if (fixo + por_item * (tarefas[t].fim - tarefas[t].inicio) > 0)
+    {
+      tarefas[t].rascunho = pather_malloc(fixo + por_item * (tarefas[t].fim - tarefas[t].inicio));
+      modelo->ok &= tarefas[t].rascunho != NULL;
+    }
+  }
+
+  if (!modelo->ok)
+  {
+    for (int t = 0; t < n_threads; t++)
+      pather_free(tarefas[t].rascunho);
+    return;
+  }
+
+  parallel_run(funcao, tarefas, sizeof(TarefaSuavizacao), n_threads);
+
+  /* A operação só deu certo se todas as faixas deram */
+  for (int t = 0; t < n_threads; t++)
+  {
+    modelo->ok &= tarefas[t].ok;
+    pather_free(tarefas[t].rascunho);
+  }
+}
+
+/*============================================================================*/
+
+/**
+ * Gaussian: Horizontal Pass
+ *
+ * Converte a faixa de linhas para float e aplica a recorrência para
+ * frente e para trás. O estado inicial é o de um sinal constante igual
+ * ao pixel da borda, já que B + (b1 + b2 + b3) = 1.
+ */
+static void *gaussiana_linhas(void *arg)
+{
+  TarefaSuavizacao *t = (TarefaSuavizacao *)arg;
+  const unsigned long w = t->src->largura;
+  const float b = (float)t->b, b1 = (float)t->b1, b2 = (float)t->b2, b3 = (float)t->b3;
+
+  for (unsigned long y = t->inicio; y < t->fim; y++)
+  {
+    const unsigned char *in = t->src->dados[y];
+    float *linha = t->buffer + y * w;
+    float w1, w2, w3;
+
+    w1 = w2 = w3 = in[0];
+    for (unsigned long x = 0; x < w; x++)
+    {
+      float v = b * in[x] + b1 * w1 + b2 * w2 + b3 * w3;
+      linha[x] = v;
+      w3 = w2; w2 = w1; w1 = v;
+    }
+
+    w1 = w2 = w3 = linha[w - 1];
+    for (unsigned long x = w; x-- > 0;)
+    {
+      float v = b * linha[x] + b1 * w1 + b2 * w2 + b3 * w3;
+      linha[x] = v;
+      w3 = w2; w2 = w1; w1 = v;
+    }
+  }
+
+  t->ok = 1;
+  return NULL;
+}
+
+static unsigned char satura(float v)
+{
+  return v <= 0.0f ? 0 : v >= 255.0f ? 255 : (unsigned char)(v + 0.5f);
+}
+
+/**
+ * Gaussian: Vertical Pass
+ *
+ * Para a faixa de colunas [inicio, fim): desce as linhas guardando as
+ * três saídas anteriores de cada coluna, sobe do mesmo jeito e grava o
+ * resultado arredondado em `dst`.
+ */
+static void *gaussiana_colunas(void *arg)
+{
+  TarefaSuavizacao *t = (TarefaSuavizacao *)arg;
+  const unsigned long w = t->src->largura, h = t->src->altura, n = t->fim - t->inicio;
+  const float b = (float)t->b, b1 = (float)t->b1, b2 = (float)t->b2, b3 = (float)t->b3;
+  float *w1, *w2, *w3;
+
+  t->ok = 1;
+  if (n == 0)
+    return NULL;
+
+  w1 = (float *)t->rascunho;
+  w2 = w1 + n;
+  w3 = w2 + n;
+
+  memcpy(w1, t->buffer + t->inicio, n * sizeof(float));
+  memcpy(w2, w1, n * sizeof(float));
+  memcpy(w3, w1, n * sizeof(float));
+  for (unsigned long y = 0; y < h; y++)
+  {
+    float *linha = t->buffer + y * w + t->inicio;
+    for (unsigned long i = 0; i < n; i++)
+    {
+      float v = b * linha[i] + b1 * w1[i] + b2 * w2[i] + b3 * w3[i];
+      linha[i] = v;
+      w3[i] = w2[i]; w2[i] = w1[i]; w1[i] = v;
+    }
+  }
+
+  memcpy(w1, t->buffer + (h - 1) * w + t->inicio, n * sizeof(float));
+  memcpy(w2, w1, n * sizeof(float));
+  memcpy(w3, w1, n * sizeof(float));
+  for (unsigned long y = h; y-- > 0;)
+  {
+    float *linha = t->buffer + y * w + t->inicio;
+    unsigned char *out = t->dst->dados[y] + t->inicio;
+    for (unsigned long i = 0; i < n; i++)
+    {
+      float v = b * linha[i] + b1 * w1[i] + b2 * w2[i] + b3 * w3[i];
+      out[i] = satura(v);
+      w3[i] = w2[i]; w2[i] = w1[i]; w1[i] = v;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Recursive Gaussian Blur
+ *
+ * Coeficientes de Young e van Vliet (1995), normalizados por b0.
+ *
+ * @param  src       imagem de entrada
+ * @param  dst       saída, com as mesmas dimensões (pode ser `src`)
+ * @param  sigma     desvio padrão em pixels (>= 0.5)
+ * @param  n_threads threads a usar; 0 usa um por processador
+ * @return           1 em caso de sucesso, 0 se faltar memória
+ */
+int gaussian_iir(Imagem1C *src, Imagem1C *dst, double sigma, int n_threads)
+{
+  TarefaSuavizacao modelo;
+  double q, b0;
+
+  if (dst->largura != src->largura || dst->altura != src->altura || src->largura == 0 || src->altura == 0)
+    return 0;
+
+  if (sigma < 0.5)
+    sigma = 0.5;
+  q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+  b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+
+  memset(&modelo, 0, sizeof(modelo));
+  modelo.src = src;
+  modelo.dst = dst;
+  modelo.b1 = (2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q) / b0;
+  modelo.b2 = -(1.4281 * q * q + 1.26661 * q * q * q) / b0;
+  modelo.b3 = 0.422205 * q * q * q / b0;
+  modelo.b = 1.0 - (modelo.b1 + modelo.b2 + modelo.b3);
+
+  modelo.buffer = (float *)pather_malloc(src->largura * src->altura * sizeof(float));
+  if (!modelo.buffer)
+    return 0;
+
+  /* A passada vertical guarda 3 saídas anteriores por coluna */
+  paralelo(&modelo, src->altura, n_threads, gaussiana_linhas, 0, 0);
+  if (modelo.ok)
+    paralelo(&modelo, src->largura, n_threads, gaussiana_colunas, 0, 3 * sizeof(float));
+
+  pather_free(modelo.buffer);
+  return modelo.ok;
+}
+
+/*============================================================================*/
+
+/**
+ * Two-level Histogram
+ */
+typedef struct
+{
+  uint16_t fino[256];
+  uint16_t grosso[16];
+} Histograma;
+
+/**
+ * Add or Subtract a Column Histogram
+ */
+static void acumula(Histograma *kernel, const Histograma *coluna, int soma)
+{
+  int i = 0;
+
+#ifdef __SSE2__
+  for (; i < 256; i += 8)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i *)(kernel->fino + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(coluna->fino + i));
+    _mm_storeu_si128((__m128i *)(kernel->fino + i), soma ? _mm_add_epi16(a, b) : _mm_sub_epi16(a, b));
+  }
+  for (int j = 0; j < 16; j += 8)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i *)(kernel->grosso + j));
+    __m128i b = _mm_loadu_si128((const __m128i *)(coluna->grosso + j));
+    _mm_storeu_si128((__m128i *)(kernel->grosso + j), soma ? _mm_add_epi16(a, b) : _mm_sub_epi16(a, b));
+  }
+#endif
+
+  for (; i < 256; i++)
+    kernel->fino[i] = soma ? kernel->fino[i] + coluna->fino[i] : kernel->fino[i] - coluna->fino[i];
+#ifndef __SSE2__
+  for (int j = 0; j < 16; j++)
+    kernel->grosso[j] = soma ? kernel->grosso[j] + coluna->grosso[j] : kernel->grosso[j] - coluna->grosso[j];
+#endif
+}
+
+/**
+ * Find the Median
+ *
+ * @param rank posição (a partir de 0) do valor procurado
+ */
+static unsigned char mediana(const Histograma *kernel, unsigned rank)
+{
+  unsigned acc = 0;
+  int g = 0, v;
+
+  while (acc + kernel->grosso[g] <= rank)
+    acc += kernel->grosso[g++];
+
+  v = g * 16;
+  while (acc + kernel->fino[v] <= rank)
+    acc += kernel->fino[v++];
+
+  return (unsigned char)v;
+}
+
+static void coloca(Histograma *h, unsigned char v)
+{
+  h->fino[v]++;
+  h->grosso[v >> 4]++;
+}
+
+static void tira(Histograma *h, unsigned char v)
+{
+  h->fino[v]--;
+  h->grosso[v >> 4]--;
+}
+
+static long limita(long v, long n)
+{
+  return v < 0 ? 0 : v >= n ? n - 1 : v;
+}
+
+/**
+ * Median: One Band of Rows
+ *
+ * Os histogramas de coluna começam na janela da primeira linha da
+ * faixa e, a cada linha, perdem o pixel que sai por cima e ganham o
+ * que entra por baixo.
+ */
+static void *mediana_linhas(void *arg)
+{
+  TarefaSuavizacao *t = (TarefaSuavizacao *)arg;
+  const long w = (long)t->src->largura, h = (long)t->src->altura, r = t->raio;
+  const unsigned rank = (unsigned)((2 * r + 1) * (2 * r + 1) / 2);
+  Histograma *colunas = (Histograma *)t->rascunho, kernel;
+
+  t->ok = 1;
+  if (t->inicio >= t->fim)
+    return NULL;
+  memset(colunas, 0, w * sizeof(Histograma));
+
+  for (long dy = -r; dy <= r; dy++)
+  {
+    const unsigned char *linha = t->src->dados[limita((long)t->inicio + dy, h)];
+    for (long x = 0; x < w; x++)
+      coloca(&colunas[x], linha[x]);
+  }
+
+  for (long y = (long)t->inicio; y < (long)t->fim; y++)
+  {
+    unsigned char *out = t->dst->dados[y];
+
+    if (y > (long)t->inicio)
+    {
+      const unsigned char *sai = t->src->dados[limita(y - r - 1, h)];
+      const unsigned char *entra = t->src->dados[limita(y + r, h)];
+      for (long x = 0; x < w; x++)
+      {
+        tira(&colunas[x], sai[x]);
+        coloca(&colunas[x], entra[x]);
+      }
+    }
+
+    memset(&kernel, 0, sizeof(kernel));
+    for (long dx = -r; dx <= r; dx++)
+      acumula(&kernel, &colunas[limita(dx, w)], 1);
+
+    for (long x = 0; x < w; x++)
+    {
+      if (x > 0)
+      {
+        acumula(&kernel, &colunas[limita(x + r, w)], 1);
+        acumula(&kernel, &colunas[limita(x - r - 1, w)], 0);
+      }
+      out[x] = mediana(&kernel, rank);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Sliding-histogram Median
+ *
+ * `dst` não pode ser `src`: as faixas leem linhas vizinhas às suas.
+ *
+ * @param  raio      raio da janela quadrada (até MEDIANA_RAIO_MAX)
+ * @param  n_threads threads a usar; 0 usa um por processador
+ * @return           1 em caso de sucesso, 0 em caso de erro ou falta de memória
+ */
+int median_filter(Imagem1C *src, Imagem1C *dst, int raio, int n_threads)
+{
+  TarefaSuavizacao modelo;
+
+  if (dst == src || dst->largura != src->largura || dst->altura != src->altura ||
+      raio < 0 || raio > MEDIANA_RAIO_MAX)
+    return 0;
+
+  memset(&modelo, 0, sizeof(modelo));
+  modelo.src = src;
+  modelo.dst = dst;
+  modelo.raio = raio;
+
+  /* Um histograma por coluna em cada faixa */
+  paralelo(&modelo, src->altura, n_threads, mediana_linhas, src->largura * sizeof(Histograma), 0);
+  return modelo.ok;
+}
@@ -0,0 +1,281 @@
+/**
+ * Hot-path Instrumentation
+ *
+ * Implementação da camada de instrumentação. Só é compilada quando a
+ * opção `PATHER_TRACE` do CMake está ligada.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+/* Standard Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* File Header */
+#include <pather/trace.h>
+
+/* Limite de etapas registradas por chamada */
+#define TRACE_MAX_STAGES 32
+
+/* Profundidade máxima de etapas aninhadas */
+#define TRACE_MAX_DEPTH 8
+
+/**
+ * Stage Record
+ *
+ * Medidas de uma etapa. Os campos `*_inicio` guardam o estado no
+ * `trace_stage_begin` e são convertidos em deltas no `trace_stage_end`.
+ */
+typedef struct
+{
+  const char *nome;
+  uint64_t inicio_ns, wall_ns;
+  uint64_t inicio_ciclos, ciclos;
+  uint64_t bytes;
+  uint64_t inicio_allocs, allocs;
+  uint64_t inicio_alloc_bytes, alloc_bytes;
+} TraceStage;
+
+/* Estado global da instrumentação */
+static struct
+{
+  FILE *saida;
+  int chrome;
+  int eventos;
+  uint64_t origem_ns;
+
+  uint64_t chamada;
+  unsigned long largura, altura;
+  uint64_t inicio_ns, inicio_ciclos;
+
+  TraceStage etapas[TRACE_MAX_STAGES];
+  int n_etapas;
+  int pilha[TRACE_MAX_DEPTH];
+  int profundidade;
+
+  uint64_t allocs, alloc_bytes;
+  uint64_t contadores[TRACE_N_COUNTERS];
+} trace;
+
+static const char *nomes_contadores[TRACE_N_COUNTERS] = {
+  "nodes_pushed",
+  "nodes_settled",
+  "queue_peak"
+};
+
+/**
+ * Monotonic Clock
+ *
+ * Tempo de parede em nanossegundos.
+ */
+static uint64_t agora_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Cycle Counter
+ *
+ * Lê o TSC quando disponível; nas outras arquiteturas retorna 0.
+ */
+static uint64_t agora_ciclos(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return (uint64_t)__rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Close the Output
+ *
+ * Registrado com `atexit`, fecha o array do Chrome trace.
+ */
+static void trace_fecha(void)
+{
+  if (!trace.saida)
+    return;
+  if (trace.chrome)
+    fprintf(trace.saida, "\n]\n");
+  fclose(trace.saida);
+  trace.saida = NULL;
+}
+
+/**
+ * Open the Output
+ *
+ * Abre o arquivo de saída na primeira chamada instrumentada.
+ */
+static void trace_abre(void)
+{
+  const char *arquivo = getenv("PATHER_TRACE_FILE");
+  const char *formato = getenv("PATHER_TRACE_FORMAT");
+
+  trace.chrome = formato && strcmp(formato, "chrome") == 0;
+  if (!arquivo)
+    arquivo = trace.chrome ? "pather-trace.json" : "pather-trace.jsonl";
+
+  trace.saida = fopen(arquivo, "w");
+  if (!trace.saida)
+  {
+    fprintf(stderr, "Error opening trace file %s.\n", arquivo);
+    return;
+  }
+
+  trace.origem_ns = agora_ns();
+  if (trace.chrome)
+    fprintf(trace.saida, "[");
+  atexit(trace_fecha);
+}
+
+/**
+ * Chrome Complete Event
+ *
+ * Escreve um evento "X" (início + duração, em microssegundos).
+ */
+static void trace_evento_chrome(const char *nome, uint64_t inicio_ns, uint64_t wall_ns)
+{
+  fprintf(trace.saida, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%ld,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+          trace.eventos++ ? "," : "", nome, (long)getpid(),
+          (inicio_ns - trace.origem_ns) / 1000.0, wall_ns / 1000.0);
+}
+
+void trace_call_begin(unsigned long largura, unsigned long altura)
+{
+  if (!trace.saida && trace.chamada == 0)
+    trace_abre();
+
+  trace.chamada++;
+  trace.largura = largura;
+  trace.altura = altura;
+  trace.n_etapas = 0;
+  trace.profundidade = 0;
+  memset(trace.contadores, 0, sizeof(trace.contadores));
+  trace.inicio_ns = agora_ns();
+  trace.inicio_ciclos = agora_ciclos();
+}
+
+void trace_call_end(void)
+{
+  uint64_t wall_ns = agora_ns() - trace.inicio_ns;
+  uint64_t ciclos = agora_ciclos() - trace.inicio_ciclos;
+  int i;
+
+  if (!trace.saida)
+    return;
+
+  if (trace.chrome)
+  {
+    for (i = 0; i < trace.n_etapas; i++)
+    {
+      TraceStage *e = &trace.etapas[i];
+      trace_evento_chrome(e->nome, e->inicio_ns, e->wall_ns);
+      fprintf(trace.saida, "\"cycles\":%llu,\"bytes\":%llu,\"allocs\":%llu,\"alloc_bytes\":%llu}}",
+              (unsigned long long)e->ciclos, (unsigned long long)e->bytes,
+              (unsigned long long)e->allocs, (unsigned long long)e->alloc_bytes);
+    }
+
+    trace_evento_chrome("encontraCaminho", trace.inicio_ns, wall_ns);
+    fprintf(trace.saida, "\"call\":%llu,\"width\":%lu,\"height\":%lu,\"cycles\":%llu",
+            (unsigned long long)trace.chamada, trace.largura, trace.altura,
+            (unsigned long long)ciclos);
+    for (i = 0; i < TRACE_N_COUNTERS; i++)
+      fprintf(trace.saida, ",\"%s\":%llu", nomes_contadores[i],
+              (unsigned long long)trace.contadores[i]);
+    fprintf(trace.saida, "}}");
+  }
+  else
+  {
+    fprintf(trace.saida, "{\"call\":%llu,\"width\":%lu,\"height\":%lu,\"wall_ns\":%llu,\"cycles\":%llu,\"stages\":[",
+            (unsigned long long)trace.chamada, trace.largura, trace.altura,
+            (unsigned long long)wall_ns, (unsigned long long)ciclos);
+    for (i = 0; i < trace.n_etapas; i++)
+    {
+      TraceStage *e = &trace.etapas[i];
+      fprintf(trace.saida, "%s{\"name\":\"%s\",\"wall_ns\":%llu,\"cycles\":%llu,\"bytes\":%llu,\"allocs\":%llu,\"alloc_bytes\":%llu}",
+              i ? "," : "", e->nome,
+              (unsigned long long)e->wall_ns, (unsigned long long)e->ciclos,
+              (unsigned long long)e->bytes, (unsigned long long)e->allocs,
+              (unsigned long long)e->alloc_bytes);
+    }
+    fprintf(trace.saida, "]");
+    for (i = 0; i < TRACE_N_COUNTERS; i++)
+      fprintf(trace.saida, ",\"%s\":%llu", nomes_contadores[i],
+              (unsigned long long)trace.contadores[i]);
+    fprintf(trace.saida, "}\n");
+  }
+
+  fflush(trace.saida);
+}
+
+void trace_stage_begin(const char *nome)
+{
+  TraceStage *e;
+
+  if (trace.n_etapas == TRACE_MAX_STAGES || trace.profundidade == TRACE_MAX_DEPTH)
+    return;
+
+  e = &trace.etapas[trace.n_etapas];
+  memset(e, 0, sizeof(TraceStage));
+  e->nome = nome;
+  e->inicio_allocs = trace.allocs;
+  e->inicio_alloc_bytes = trace.alloc_bytes;
+  e->inicio_ns = agora_ns();
+  e->inicio_ciclos = agora_ciclos();
+
+  trace.pilha[trace.profundidade++] = trace.n_etapas++;
+}
+
+void trace_stage_end(void)
+{
+  TraceStage *e;
+
+  if (trace.profundidade == 0)
+    return;
+
+  e = &trace.etapas[trace.pilha[--trace.profundidade]];
+  e->ciclos = agora_ciclos() - e->inicio_ciclos;
+  e->wall_ns = agora_ns() - e->inicio_ns;
+  e->allocs = trace.allocs - e->inicio_allocs;
+  e->alloc_bytes = trace.alloc_bytes - e->inicio_alloc_bytes;
+}
+
+/* Os registros abaixo podem vir das threads de trabalho de uma etapa,
+   então são atômicos. A pilha de etapas só muda na thread que chamou,
+   antes de criar e depois de juntar as threads, então lê-la é seguro */
+void trace_bytes(uint64_t bytes)
+{
+  if (trace.profundidade > 0)
+    __sync_fetch_and_add(&trace.etapas[trace.pilha[trace.profundidade - 1]].bytes, bytes);
+}
+
+void trace_alloc(uint64_t bytes)
+{
+  __sync_fetch_and_add(&trace.allocs, 1);
+  __sync_fetch_and_add(&trace.alloc_bytes, bytes);
+}
+
+void trace_add(TraceCounter counter, uint64_t value)
+{
+  __sync_fetch_and_add(&trace.contadores[counter], value);
+}
+
+void trace_max(TraceCounter counter, uint64_t value)
+{
+  uint64_t anterior;
+
+  while ((anterior = __atomic_load_n(&trace.contadores[counter], __ATOMIC_RELAXED)) < value)
+    if (__sync_bool_compare_and_swap(&trace.contadores[counter], anterior, value))
+      break;
+}